@@ -24,26 +24,55 @@
 
 #include "Patch.h"
 
+#include <math.h>
 #include "fastmath.h"
+#include "delayline.h"
 
 #define TIME_THRESHOLD 0.006
 #define FADE_RATE 0.04
 
+// delay buffer storage format and length in seconds, for example
+// -DDIGIDELAY_STORAGE=DELAY_STORAGE_INT16 -DDIGIDELAY_SECONDS=4 doubles
+// the delay time in the memory of 2 seconds of floats
+#ifndef DIGIDELAY_STORAGE
+#define DIGIDELAY_STORAGE DELAY_STORAGE_FLOAT32
+#endif
+#ifndef DIGIDELAY_SECONDS
+#define DIGIDELAY_SECONDS 2
+#endif
+
+// fractional delay interpolation of the taps
+#ifndef DIGIDELAY_INTERPOLATION
+#define DIGIDELAY_INTERPOLATION DELAY_INTERPOLATION_HERMITE
+#endif
+
 class DigiDelayPatch : public Patch {
 public:
-  float *ringBuffer;
+  DelayLine *delayLine;
   int bufferLength;
-  int writePointer;
     
   int sampleRate;
 
   float time2;
 
+  // crossfade between the two taps. a settled crossfade reads only the
+  // tap it rests on, both taps are read and blended only while it runs
+  enum FadeMode {
+    FADE_TAP0,
+    FADE_TAP1,
+    FADE_BLEND
+  };
+
   int fade_state;
+  int fade_mode;
   float fade_value;
   float fade0_time, fade1_time;
 
   float hp;
+
+  // block buffers of the crossfaded taps and the write head
+  float *tap0, *tap1, *head;
+  int blockSize;
   
   DigiDelayPatch(){
     registerParameter(PARAMETER_A, "Time");    
@@ -52,71 +81,48 @@ public:
     registerParameter(PARAMETER_D, "Dry/Wet");
 
     sampleRate = getSampleRate();
-    writePointer = 0;
 
-    // 2 seconds of delay time
-    bufferLength = 2*sampleRate;
-    ringBuffer = new float[bufferLength];
-    
-    for(int i=0; i<2*bufferLength; i++){
-      ringBuffer[i] = 0.f;
-    }
+    // DIGIDELAY_SECONDS of delay time
+    bufferLength = DIGIDELAY_SECONDS*sampleRate;
+    delayLine = new DelayLine(bufferLength, DIGIDELAY_STORAGE);
+    delayLine->SetDelayInterpolation(DIGIDELAY_INTERPOLATION);
 
+    blockSize = getBlockSize();
+    tap0 = new float[blockSize];
+    tap1 = new float[blockSize];
+    head = new float[blockSize];
+
+    // start on the knob value, so that the delay sounds from the first block
     time2 = getParameterValue(PARAMETER_A);
 
     fade_state = 0;
-    fade0_time = fade1_time = 0.f;
+    fade_mode = FADE_TAP0;
+    fade_value = 0.f;
+    fade0_time = fade1_time = time2*time2*time2*time2;
 
     hp = 0.f;
   }
 
-  float readDelay(float time){
-    int readPointer, readPointer2;
-    float frac;
-    
-    readPointer = writePointer - (int)(time*bufferLength);
-    if(readPointer < 0){
-      readPointer += bufferLength;
-    }
-
-    readPointer2 = readPointer - 1;
-    if(readPointer2 < 0){
-      readPointer2 += bufferLength;
-    }
-
-    // simple fractional linear interpolation
-    frac = (float)(time*bufferLength) - (float)((int)(time*bufferLength));
-    return (1.f - frac)*ringBuffer[readPointer] + (frac)*ringBuffer[readPointer2];
+  ~DigiDelayPatch(){
+    delete delayLine;
+    delete[] tap0;
+    delete[] tap1;
+    delete[] head;
   }
 
-  void writeDelay(float input){
-      writePointer += 1;
-      if(writePointer > bufferLength - 1){
-	writePointer -= bufferLength;
-      }
-
-      // dc blocking filter for write head
-      float hp_input = input;
-      hp += 0.00005f*(hp_input - hp);
-      input = hp - hp_input;
-      
-      ringBuffer[writePointer] = input;
-  }
-  
   void processAudio(AudioBuffer &buffer){
     float time = getParameterValue(PARAMETER_A);
     float feedback = getParameterValue(PARAMETER_B);
     float gain = getParameterValue(PARAMETER_C);
     float drywet = getParameterValue(PARAMETER_D);
 
-    int fade_trigger = 0;
-
     // lich cv has noisy inputs
     // add hysteresis threshold to time parameter value
-    if(abs(time-time2) > TIME_THRESHOLD){
+    if(fabsf(time-time2) > TIME_THRESHOLD){
       time2 = time;
 
       // trigger crossfade
+      fade_mode = FADE_BLEND;
       if(fade_state){
 	fade_state = 0;
 	fade0_time = time2*time2*time2*time2;
@@ -130,34 +136,104 @@ public:
     int size = buffer.getSize();
     
     float* io_buf = buffer.getSamples(0);
-    float delay;
-      
-    for(int i=0; i<size; ++i){
-      // update crossfade
-      if(fade_state){
-	fade_value += FADE_RATE;
-	if(fade_value > 1.f){
-	  fade_value = 1.f;
+
+    // tap delays in samples, fixed over the block
+    float delay0 = fade0_time*bufferLength;
+    float delay1 = fade1_time*bufferLength;
+
+    // delays shorter than the block feed back within it, so the block is
+    // processed in spans that only read samples written before them
+    int span = blockSize;
+    if(fade_mode != FADE_TAP1 && delayLine->GetDelaySpan(delay0) < span){
+      span = delayLine->GetDelaySpan(delay0);
+    }
+    if(fade_mode != FADE_TAP0 && delayLine->GetDelaySpan(delay1) < span){
+      span = delayLine->GetDelaySpan(delay1);
+    }
+
+    // interpolation of the taps is set up once for all spans
+    DelayTap read0, read1;
+    delayLine->SetDelayTap(delay0, &read0);
+    delayLine->SetDelayTap(delay1, &read1);
+
+    // crossfade and filter state in registers over the block
+    float fade_value = this->fade_value;
+    float hp = this->hp;
+
+    // delays of a few samples feed back within a few samples, the block
+    // is processed a sample at a time without the span setup
+    if(span < DELAYLINE_MIN_SPAN){
+      for(int i=0; i<size; ++i){
+	float delay;
+	if(fade_mode == FADE_BLEND){
+	  fade_value = AdvanceFade(fade_value, fade_state, FADE_RATE);
+	  delay = (1.f - fade_value)*delayLine->ReadDelaySample(read0) + fade_value*delayLine->ReadDelaySample(read1);
 	}
-      }
-      else{
-	fade_value -= FADE_RATE;
-	if(fade_value < 0.f){
-	  fade_value = 0.f;
+	else{
+	  delay = delayLine->ReadDelaySample(fade_mode == FADE_TAP0 ? read0 : read1);
 	}
+
+	// dc blocking filter for write head
+	float hp_input = gain*io_buf[i] + feedback*delay;
+	hp += 0.00005f*(hp_input - hp);
+	float write = hp - hp_input;
+
+	// output
+	io_buf[i] = (1.f - drywet)*gain*io_buf[i] + drywet*delay;
+
+	// update buffer
+	delayLine->WriteDelay(&write, 1);
       }
-      
-      // read delayed signal
-      delay = (1.f - fade_value)*readDelay(fade0_time) + fade_value*readDelay(fade1_time);
+    }
+    else{
+      for(int start=0; start<size; start+=span){
+	int n = size - start < span ? size - start : span;
+	float* io = io_buf + start;
+
+	// read delayed signal into tap0
+	if(fade_mode == FADE_BLEND){
+	  delayLine->ReadDelay(read0, tap0, n);
+	  delayLine->ReadDelay(read1, tap1, n);
+
+	  for(int i=0; i<n; ++i){
+	    fade_value = AdvanceFade(fade_value, fade_state, FADE_RATE);
+	    tap0[i] = (1.f - fade_value)*tap0[i] + fade_value*tap1[i];
+	  }
+	}
+	else{
+	  delayLine->ReadDelay(fade_mode == FADE_TAP0 ? read0 : read1, tap0, n);
+	}
 
-      // update buffer
-      writeDelay(gain*io_buf[i] + feedback*delay);
+	for(int i=0; i<n; ++i){
+	  float delay = tap0[i];
 
-      // output
-      io_buf[i] = (1.f - drywet)*gain*io_buf[i] + drywet*delay;
+	  // dc blocking filter for write head
+	  float hp_input = gain*io[i] + feedback*delay;
+	  hp += 0.00005f*(hp_input - hp);
+	  head[i] = hp - hp_input;
+
+	  // output
+	  io[i] = (1.f - drywet)*gain*io[i] + drywet*delay;
+	}
+
+	// update buffer
+	delayLine->WriteDelay(head, n);
+      }
+    }
+
+    // settle on the faded in tap
+    if(fade_mode == FADE_BLEND){
+      if(fade_state && fade_value >= 1.f){
+	fade_mode = FADE_TAP1;
+      }
+      if(!fade_state && fade_value <= 0.f){
+	fade_mode = FADE_TAP0;
+      }
     }
+
+    this->fade_value = fade_value;
+    this->hp = hp;
   }
 };
 
 #endif // __DigiDelayPatch_h__
-
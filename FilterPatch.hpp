@@ -0,0 +1,365 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FilterPatch_h__
+#define __FilterPatch_h__
+
+#include <math.h>
+#include "StompBox.h"
+
+#include "fastmath.h"
+#include "newton.h"
+
+// smallest knob movement that ramps over the block. noisy cv moves the
+// knobs a little every block, such moves step at block rate instead.
+// cutoff moves are relative to the cutoff the filter holds
+#ifndef FILTER_RAMP_THRESHOLD
+#define FILTER_RAMP_THRESHOLD 0.005f
+#endif
+
+// one scalar filter per channel behind the voice bank interface that the
+// patches use, for targets where the bank lanes would be emulated. the
+// Cortex-M of the OWL has no float vector unit and builds with
+// SIMD_SCALAR, so there every channel costs a full filter and stereo
+// twice as much as mono
+template <class Filter>
+class FilterChannels {
+public:
+  FilterChannels(int newChannels){
+    channels = newChannels;
+    filters = new Filter[channels];
+    newtonStats = NULL;
+  }
+
+  ~FilterChannels(){
+    delete[] filters;
+    delete newtonStats;
+  }
+
+  // set per channel filter parameters
+  void SetFilterCutoff(int channel, float newCutoff){
+    filters[channel].SetFilterCutoff(newCutoff);
+  }
+
+  void SetFilterResonance(int channel, float newResonance){
+    filters[channel].SetFilterResonance(newResonance);
+  }
+
+  // set filter parameters shared by all channels
+  void SetFilterOversamplingFactor(int newOversamplingFactor){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].SetFilterOversamplingFactor(newOversamplingFactor);
+    }
+  }
+
+  template <class Mode> void SetFilterMode(Mode newFilterMode){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].SetFilterMode(newFilterMode);
+    }
+  }
+
+  void SetFilterSampleRate(float newSampleRate){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].SetFilterSampleRate(newSampleRate);
+    }
+  }
+
+  template <class Method> void SetFilterIntegrationMethod(Method method){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].SetFilterIntegrationMethod(method);
+    }
+  }
+
+  void SetFilterApproximation(FastmathApproximation newApproximation){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].SetFilterApproximation(newApproximation);
+    }
+  }
+
+  void SetFilterNewtonStep(NewtonStep newStep){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].SetFilterNewtonStep(newStep);
+    }
+  }
+
+  void SetFilterAntialiasing(bool enable){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].SetFilterAntialiasing(enable);
+    }
+  }
+
+  void SetFilterNewtonStatistics(bool enable){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].SetFilterNewtonStatistics(enable);
+    }
+
+    if(enable && newtonStats == NULL){
+      newtonStats = new NewtonStatistics();
+    }
+    else if(!enable){
+      delete newtonStats;
+      newtonStats = NULL;
+    }
+  }
+
+  // get filter parameters
+  float GetFilterCutoff(int channel){
+    return filters[channel].GetFilterCutoff();
+  }
+
+  float GetFilterResonance(int channel){
+    return filters[channel].GetFilterResonance();
+  }
+
+  // get newton solver statistics of all channels, NULL unless enabled
+  NewtonStatistics* GetFilterNewtonStatistics(){
+    return newtonStats;
+  }
+
+  // filter a block of samples for every channel
+  void ProcessBlock(const float* const* in, float* const* out, int n){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].ProcessBlock(in[ch], out[ch], n);
+    }
+
+    CollectNewtonStatistics();
+  }
+
+  // filter a block with per sample cutoff and resonance, either holds a
+  // buffer for every channel or is NULL to keep the set values
+  void ProcessBlock(const float* const* in, float* const* out, int n,
+		    const float* const* cutoff, const float* const* resonance){
+    for(int ch=0; ch<channels; ch++){
+      filters[ch].ProcessBlock(in[ch], out[ch], n, cutoff ? cutoff[ch] : NULL, resonance ? resonance[ch] : NULL);
+    }
+
+    CollectNewtonStatistics();
+  }
+
+private:
+  // move the solves of the channels into the shared statistics
+  void CollectNewtonStatistics(){
+    if(newtonStats == NULL){
+      return;
+    }
+
+    for(int ch=0; ch<channels; ch++){
+      NewtonStatistics* stats = filters[ch].GetFilterNewtonStatistics();
+
+      for(int ii=0; ii <= NEWTON_MAX_ITERATIONS; ii++){
+	newtonStats->histogram[ii] += stats->histogram[ii];
+      }
+      newtonStats->solves += stats->solves;
+      newtonStats->failures += stats->failures;
+      if(stats->maxResidual > newtonStats->maxResidual){
+	newtonStats->maxResidual = stats->maxResidual;
+      }
+
+      stats->ResetNewtonStatistics();
+    }
+  }
+
+  int channels;
+  Filter* filters;
+  NewtonStatistics* newtonStats;
+};
+
+// knob handling shared by the filter patches: input gain, cutoff spread
+// across the channels, ramps of moved knobs over the block and output
+// level. the filter runs one voice per channel, either a voice bank or
+// FilterChannels of a scalar filter
+template <class Filter>
+class FilterPatch : public Patch {
+public:
+  Filter* filter;
+
+  // the integration method is set before the knob values, as setting it
+  // resets the parameters of some filters
+  template <class Method>
+  FilterPatch(Method method){
+    registerParameter(PARAMETER_A, "Cutoff");
+    registerParameter(PARAMETER_B, "Resonance");
+    registerParameter(PARAMETER_C, "Gain");
+    registerParameter(PARAMETER_D, "Mode");
+    registerParameter(PARAMETER_E, "Spread");
+
+    channels = getNumberOfChannels();
+
+    filter = new Filter(channels);
+    filter->SetFilterSampleRate(getSampleRate());
+    filter->SetFilterOversamplingFactor(4);
+    filter->SetFilterIntegrationMethod(method);
+
+    // start on the knob values, so the first block does not ramp to them
+    float cutoff = ShapeCutoff(getParameterValue(PARAMETER_A));
+    float spread = getParameterValue(PARAMETER_E);
+    for(int ch=0; ch<channels; ++ch){
+      filter->SetFilterCutoff(ch, ChannelCutoff(cutoff, spread, ch));
+      filter->SetFilterResonance(ch, getParameterValue(PARAMETER_B));
+    }
+
+    // per sample cutoff of every channel and the linked resonance for
+    // knob movements
+    rampSize = getBlockSize();
+    cutoffRamp = new float[channels*rampSize];
+    resoRamp = new float[rampSize];
+    cutoffRamps = new const float*[channels];
+    resoRamps = new const float*[channels];
+    samples = new float*[channels];
+  }
+
+  virtual ~FilterPatch(){
+    delete filter;
+    delete[] cutoffRamp;
+    delete[] resoRamp;
+    delete[] cutoffRamps;
+    delete[] resoRamps;
+    delete[] samples;
+  }
+
+  // nonlinearity approximants of the filter
+  void setApproximation(FastmathApproximation approximation){
+    filter->SetFilterApproximation(approximation);
+  }
+
+  // newton update rule of the implicit integrators
+  void setNewtonStep(NewtonStep step){
+    filter->SetFilterNewtonStep(step);
+  }
+
+  // newton solver statistics of the filter, NULL unless enabled
+  void setNewtonStatistics(bool enable){
+    filter->SetFilterNewtonStatistics(enable);
+  }
+
+  NewtonStatistics* getNewtonStatistics(){
+    return filter->GetFilterNewtonStatistics();
+  }
+
+protected:
+  // filter the buffer with the cutoff, resonance, gain and spread knobs,
+  // the patch sets the mode
+  void processFilter(AudioBuffer &buffer){
+    float cutoff = ShapeCutoff(getParameterValue(PARAMETER_A));
+    float reso = getParameterValue(PARAMETER_B);
+    float gain = 1.f + 7.f*getParameterValue(PARAMETER_C);
+    float spread = getParameterValue(PARAMETER_E);
+
+    int size = buffer.getSize();
+
+    // input gain
+    for(int ch=0; ch<channels; ++ch){
+      samples[ch] = buffer.getSamples(ch);
+
+      for(int i=0; i<size; ++i){
+	samples[ch][i] *= gain;
+      }
+    }
+
+    // ramp moved knobs over the block from the values the filter holds,
+    // so cutoff and resonance do not zipper. still knobs and moves under
+    // the threshold take the block rate path
+    float resoStart = filter->GetFilterResonance(0);
+    bool moved = fabsf(reso - resoStart) > FILTER_RAMP_THRESHOLD;
+    for(int ch=0; ch<channels; ++ch){
+      float cutoffStart = filter->GetFilterCutoff(ch);
+      moved = moved || fabsf(ChannelCutoff(cutoff, spread, ch) - cutoffStart) > FILTER_RAMP_THRESHOLD*cutoffStart;
+    }
+
+    if(moved && size <= rampSize){
+      float step = 1.f/(float)(size);
+
+      for(int ch=0; ch<channels; ++ch){
+	float target = ChannelCutoff(cutoff, spread, ch);
+	float cutoffStart = filter->GetFilterCutoff(ch);
+
+	// linked channels share the ramp of the first channel
+	if(ch > 0 && target == ChannelCutoff(cutoff, spread, 0) && cutoffStart == filter->GetFilterCutoff(0)){
+	  cutoffRamps[ch] = cutoffRamps[0];
+	  resoRamps[ch] = resoRamp;
+	  continue;
+	}
+
+	// ramps end exactly on the knob values
+	float* ramp = cutoffRamp + ch*rampSize;
+	for(int i=0; i<size; ++i){
+	  float remaining = (float)(size - 1 - i)*step;
+
+	  ramp[i] = target - remaining*(target - cutoffStart);
+	  if(ch == 0){
+	    resoRamp[i] = reso - remaining*(reso - resoStart);
+	  }
+	}
+
+	cutoffRamps[ch] = ramp;
+	resoRamps[ch] = resoRamp;
+      }
+
+      filter->ProcessBlock(samples, samples, size, cutoffRamps, resoRamps);
+    }
+    else{
+      for(int ch=0; ch<channels; ++ch){
+	filter->SetFilterCutoff(ch, ChannelCutoff(cutoff, spread, ch));
+	filter->SetFilterResonance(ch, reso);
+      }
+      filter->ProcessBlock(samples, samples, size);
+    }
+
+    // output level
+    float level = 0.4f/gain;
+    for(int ch=0; ch<channels; ++ch){
+      for(int i=0; i<size; ++i){
+	samples[ch][i] *= level;
+      }
+    }
+  }
+
+private:
+  // cutoff knob response
+  float ShapeCutoff(float cutoff){
+    return cutoff*(2.5f*cutoff*cutoff);
+  }
+
+  // cutoff of a channel, spread moves the channels apart around the
+  // knob value by up to 41 percent each way and links them at zero
+  float ChannelCutoff(float cutoff, float spread, int ch){
+    if(channels < 2){
+      return cutoff;
+    }
+
+    float offset = 2.f*(float)(ch)/(float)(channels - 1) - 1.f;
+
+    return cutoff*(1.f + 0.41f*spread*offset);
+  }
+
+  // processed channels
+  int channels;
+  float** samples;
+
+  // cutoff ramps of the channels and the resonance ramp over a block
+  float* cutoffRamp;
+  float* resoRamp;
+  const float** cutoffRamps;
+  const float** resoRamps;
+  int rampSize;
+};
+
+#endif // __FilterPatch_h__
@@ -0,0 +1,384 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of MultiTap DigiDelay OWL Patch.
+ *
+ *  MultiTap DigiDelay OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MultiTap DigiDelay OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with MultiTap DigiDelay OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MultiTapDelayPatch_h__
+#define __MultiTapDelayPatch_h__
+
+#include "Patch.h"
+
+#include <math.h>
+#include "fastmath.h"
+#include "delayline.h"
+
+#define TIME_THRESHOLD 0.006
+#define FADE_RATE 0.04
+
+// delay buffer storage format, length in seconds and interpolation,
+// shared with the DigiDelay patches
+#ifndef DIGIDELAY_STORAGE
+#define DIGIDELAY_STORAGE DELAY_STORAGE_FLOAT32
+#endif
+#ifndef DIGIDELAY_SECONDS
+#define DIGIDELAY_SECONDS 2
+#endif
+#ifndef DIGIDELAY_INTERPOLATION
+#define DIGIDELAY_INTERPOLATION DELAY_INTERPOLATION_HERMITE
+#endif
+
+// read taps of the shared buffer
+#ifndef MULTITAP_TAPS
+#define MULTITAP_TAPS 4
+#endif
+
+// level of each tap relative to the one before it
+#define MULTITAP_DECAY 0.8f
+
+class MultiTapDelayPatch : public Patch {
+public:
+  // every tap reads the one ring buffer behind a single write head
+  DelayLine *delayLine;
+  int bufferLength;
+
+  int sampleRate;
+  int channels;
+
+  float time2;
+  int taps2;
+
+  // crossfade between the tap sets of the old and the new time, see
+  // DigiDelayPatch
+  enum FadeMode {
+    FADE_TAP0,
+    FADE_TAP1,
+    FADE_BLEND
+  };
+
+  int fade_state;
+  int fade_mode;
+  float fade_value;
+  float fade0_time, fade1_time;
+  int fade0_taps, fade1_taps;
+
+  float hp;
+
+  // tap delays and gains of both crossfaded sets
+  float delay0[MULTITAP_TAPS], delay1[MULTITAP_TAPS];
+  float leftGain0[MULTITAP_TAPS], rightGain0[MULTITAP_TAPS];
+  float leftGain1[MULTITAP_TAPS], rightGain1[MULTITAP_TAPS];
+
+  // block buffers of the stereo tap mixes and the write head
+  float *left0, *right0, *left1, *right1, *head;
+  int blockSize;
+
+  MultiTapDelayPatch(){
+    registerParameter(PARAMETER_A, "Time");
+    registerParameter(PARAMETER_B, "Feedback");
+    registerParameter(PARAMETER_C, "Spread");
+    registerParameter(PARAMETER_D, "Dry/Wet");
+    registerParameter(PARAMETER_E, "Taps");
+
+    sampleRate = getSampleRate();
+    channels = getNumberOfChannels();
+
+    // DIGIDELAY_SECONDS of delay time for the longest tap
+    bufferLength = DIGIDELAY_SECONDS*sampleRate;
+    delayLine = new DelayLine(bufferLength, DIGIDELAY_STORAGE);
+    delayLine->SetDelayInterpolation(DIGIDELAY_INTERPOLATION);
+
+    blockSize = getBlockSize();
+    left0 = new float[blockSize];
+    right0 = new float[blockSize];
+    left1 = new float[blockSize];
+    right1 = new float[blockSize];
+    head = new float[blockSize];
+
+    // start on the knob values, so that the taps sound from the first block
+    time2 = getParameterValue(PARAMETER_A);
+    taps2 = TapCount(getParameterValue(PARAMETER_E));
+
+    fade_state = 0;
+    fade_mode = FADE_TAP0;
+    fade_value = 0.f;
+    fade0_time = fade1_time = time2*time2*time2*time2;
+    fade0_taps = fade1_taps = taps2;
+
+    hp = 0.f;
+  }
+
+  ~MultiTapDelayPatch(){
+    delete delayLine;
+    delete[] left0;
+    delete[] right0;
+    delete[] left1;
+    delete[] right1;
+    delete[] head;
+  }
+
+  // number of sounding taps for the Taps knob
+  int TapCount(float value){
+    return 1 + (int)((MULTITAP_TAPS - 1)*value + 0.5f);
+  }
+
+  // taps evenly spaced up to the longest delay, kept short of the buffer
+  // length so that the longest tap never wraps around onto the write head
+  void TapDelays(float time, float* delays){
+    float longest = (float)(bufferLength - 2);
+
+    for(int j=0; j<MULTITAP_TAPS; j++){
+      delays[j] = time*bufferLength*(float)(j + 1)/(float)(MULTITAP_TAPS);
+      if(delays[j] > longest){
+	delays[j] = longest;
+      }
+    }
+  }
+
+  // tap levels decay along the taps, normalized so that the mono
+  // feedback of all active taps stays below unity. taps alternate
+  // sides, spread further out the later they come
+  void TapGains(int taps, float spread, float* leftGain, float* rightGain){
+    float norm = 0.f;
+    float level = 1.f;
+    for(int j=0; j<taps; j++){
+      norm += level;
+      level *= MULTITAP_DECAY;
+    }
+
+    level = 1.f/norm;
+    for(int j=0; j<taps; j++){
+      float pan = spread*(float)(j + 1)/(float)(MULTITAP_TAPS);
+      if(j & 1){
+	pan = -pan;
+      }
+      leftGain[j] = level*sqrtf(1.f - pan);
+      rightGain[j] = level*sqrtf(1.f + pan);
+      level *= MULTITAP_DECAY;
+    }
+  }
+
+  // shortest span that any of the active taps of a set allows
+  int TapSpan(const float* delays, int taps, int span){
+    for(int j=0; j<taps; j++){
+      int tapSpan = delayLine->GetDelaySpan(delays[j]);
+      if(tapSpan < span){
+	span = tapSpan;
+      }
+    }
+
+    return span;
+  }
+
+  // one sample of the stereo mix of the active taps of a set
+  void MixTapSample(const DelayTap* reads, int taps, const float* leftGain, const float* rightGain,
+		    float* left, float* right){
+    *left = 0.f;
+    *right = 0.f;
+    for(int j=0; j<taps; j++){
+      float sample = delayLine->ReadDelaySample(reads[j]);
+      *left += leftGain[j]*sample;
+      *right += rightGain[j]*sample;
+    }
+  }
+
+  void processAudio(AudioBuffer &buffer){
+    float time = getParameterValue(PARAMETER_A);
+    float feedback = getParameterValue(PARAMETER_B);
+    float spread = getParameterValue(PARAMETER_C);
+    float drywet = getParameterValue(PARAMETER_D);
+    int taps = TapCount(getParameterValue(PARAMETER_E));
+
+    // lich cv has noisy inputs
+    // add hysteresis threshold to time parameter value
+    bool moved = fabsf(time-time2) > TIME_THRESHOLD;
+
+    // a new time or tap count fades over to a new tap set
+    if(moved || taps != taps2){
+      if(moved){
+	time2 = time;
+      }
+      taps2 = taps;
+
+      // trigger crossfade
+      fade_mode = FADE_BLEND;
+      if(fade_state){
+	fade_state = 0;
+	fade0_time = time2*time2*time2*time2;
+	fade0_taps = taps2;
+      }
+      else{
+	fade_state = 1;
+	fade1_time = time2*time2*time2*time2;
+	fade1_taps = taps2;
+      }
+    }
+
+    int size = buffer.getSize();
+
+    float* io_left = buffer.getSamples(0);
+    float* io_right = channels > 1 ? buffer.getSamples(1) : NULL;
+
+    // tap delays in samples, fixed over the block
+    TapDelays(fade0_time, delay0);
+    TapDelays(fade1_time, delay1);
+
+    // tap gains of both sets
+    TapGains(fade0_taps, spread, leftGain0, rightGain0);
+    TapGains(fade1_taps, spread, leftGain1, rightGain1);
+
+    // delays shorter than the block feed back within it, so the block is
+    // processed in spans that only read samples written before them
+    int span = blockSize;
+    if(fade_mode != FADE_TAP1){
+      span = TapSpan(delay0, fade0_taps, span);
+    }
+    if(fade_mode != FADE_TAP0){
+      span = TapSpan(delay1, fade1_taps, span);
+    }
+
+    // crossfade and filter state in registers over the block
+    float fade_value = this->fade_value;
+    float hp = this->hp;
+
+    // delays of a few samples feed back within a few samples, the block
+    // is processed a sample at a time without the span setup
+    if(span < DELAYLINE_MIN_SPAN){
+      // interpolation of the taps is set up once for the block
+      DelayTap read0[MULTITAP_TAPS], read1[MULTITAP_TAPS];
+      for(int j=0; j<fade0_taps; j++){
+	delayLine->SetDelayTap(delay0[j], &read0[j]);
+      }
+      for(int j=0; j<fade1_taps; j++){
+	delayLine->SetDelayTap(delay1[j], &read1[j]);
+      }
+
+      for(int i=0; i<size; ++i){
+	float left, right;
+	if(fade_mode == FADE_BLEND){
+	  float fadeLeft, fadeRight;
+	  MixTapSample(read0, fade0_taps, leftGain0, rightGain0, &left, &right);
+	  MixTapSample(read1, fade1_taps, leftGain1, rightGain1, &fadeLeft, &fadeRight);
+
+	  fade_value = AdvanceFade(fade_value, fade_state, FADE_RATE);
+	  left = (1.f - fade_value)*left + fade_value*fadeLeft;
+	  right = (1.f - fade_value)*right + fade_value*fadeRight;
+	}
+	else if(fade_mode == FADE_TAP0){
+	  MixTapSample(read0, fade0_taps, leftGain0, rightGain0, &left, &right);
+	}
+	else{
+	  MixTapSample(read1, fade1_taps, leftGain1, rightGain1, &left, &right);
+	}
+
+	// mono sum of the taps feeds back, mono sum of the inputs is written
+	float delay = 0.5f*(left + right);
+	float input = io_right ? 0.5f*(io_left[i] + io_right[i]) : io_left[i];
+
+	// dc blocking filter for write head
+	float hp_input = input + feedback*delay;
+	hp += 0.00005f*(hp_input - hp);
+	float write = hp - hp_input;
+
+	// output, mono patches get the sum of both sides
+	if(io_right){
+	  io_left[i] = (1.f - drywet)*io_left[i] + drywet*left;
+	  io_right[i] = (1.f - drywet)*io_right[i] + drywet*right;
+	}
+	else{
+	  io_left[i] = (1.f - drywet)*io_left[i] + drywet*0.5f*(left + right);
+	}
+
+	// update buffer
+	delayLine->WriteDelay(&write, 1);
+      }
+    }
+    else{
+      for(int start=0; start<size; start+=span){
+	int n = size - start < span ? size - start : span;
+	float* io = io_left + start;
+	float* io_r = io_right ? io_right + start : NULL;
+
+	// mix of the delayed taps into left0 and right0
+	if(fade_mode == FADE_BLEND){
+	  delayLine->MixDelayTaps(fade0_taps, delay0, leftGain0, rightGain0, left0, right0, n);
+	  delayLine->MixDelayTaps(fade1_taps, delay1, leftGain1, rightGain1, left1, right1, n);
+
+	  for(int i=0; i<n; ++i){
+	    fade_value = AdvanceFade(fade_value, fade_state, FADE_RATE);
+	    left0[i] = (1.f - fade_value)*left0[i] + fade_value*left1[i];
+	    right0[i] = (1.f - fade_value)*right0[i] + fade_value*right1[i];
+	  }
+	}
+	else{
+	  if(fade_mode == FADE_TAP0){
+	    delayLine->MixDelayTaps(fade0_taps, delay0, leftGain0, rightGain0, left0, right0, n);
+	  }
+	  else{
+	    delayLine->MixDelayTaps(fade1_taps, delay1, leftGain1, rightGain1, left0, right0, n);
+	  }
+	}
+
+	for(int i=0; i<n; ++i){
+	  // mono sum of the taps feeds back
+	  float delay = 0.5f*(left0[i] + right0[i]);
+
+	  // mono sum of the inputs is written
+	  float input = io_r ? 0.5f*(io[i] + io_r[i]) : io[i];
+
+	  // dc blocking filter for write head
+	  float hp_input = input + feedback*delay;
+	  hp += 0.00005f*(hp_input - hp);
+	  head[i] = hp - hp_input;
+	}
+
+	// output, mono patches get the sum of both sides
+	if(io_r){
+	  for(int i=0; i<n; ++i){
+	    io[i] = (1.f - drywet)*io[i] + drywet*left0[i];
+	    io_r[i] = (1.f - drywet)*io_r[i] + drywet*right0[i];
+	  }
+	}
+	else{
+	  for(int i=0; i<n; ++i){
+	    io[i] = (1.f - drywet)*io[i] + drywet*0.5f*(left0[i] + right0[i]);
+	  }
+	}
+
+	// update buffer
+	delayLine->WriteDelay(head, n);
+      }
+
+    }
+
+    // settle on the faded in tap set
+    if(fade_mode == FADE_BLEND){
+      if(fade_state && fade_value >= 1.f){
+	fade_mode = FADE_TAP1;
+      }
+      if(!fade_state && fade_value <= 0.f){
+	fade_mode = FADE_TAP0;
+      }
+    }
+
+    this->fade_value = fade_value;
+    this->hp = hp;
+  }
+};
+
+#endif // __MultiTapDelayPatch_h__
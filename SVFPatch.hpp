@@ -22,58 +22,45 @@
 #ifndef __SVFPatch_h__
 #define __SVFPatch_h__
 
-#include "StompBox.h"
-
+#include "FilterPatch.hpp"
 #include "svfilter.h"
-#include "iir.h"
+#include "svfilterbank.h"
+
+// one filter voice per channel. vector builds run the channels in
+// adjacent lanes of a bank, SIMD_SCALAR builds such as the OWL hardware
+// run a scalar filter per channel, see FilterChannels
+#ifdef SIMD_SCALAR
+typedef FilterChannels<SVFilter> SVFPatchFilter;
+#else
+typedef SVFilterBank SVFPatchFilter;
+#endif
 
-class SVFPatch : public Patch {
+class SVFPatch : public FilterPatch<SVFPatchFilter> {
 public:
-  SVFilter svf;
-  
-  SVFPatch(){
-    registerParameter(PARAMETER_A, "Cutoff");    
-    registerParameter(PARAMETER_B, "Resonance");    
-    registerParameter(PARAMETER_C, "Gain");    
-    registerParameter(PARAMETER_D, "Mode");
+  SVFPatch() : FilterPatch<SVFPatchFilter>(SVF_TRAPEZOIDAL){
+    filter->SetFilterMode(SVF_LOWPASS_MODE);
+  }
 
-    svf.SetFilterSampleRate(getSampleRate());
-    svf.SetFilterOversamplingFactor(4);
-    svf.SetFilterIntegrationMethod(SVF_TRAPEZOIDAL);
-    svf.SetFilterMode(SVF_LOWPASS_MODE);
+  // antiderivative antialiasing of the filter nonlinearities
+  void setAntialiasing(bool enable){
+    filter->SetFilterAntialiasing(enable);
   }
 
   void processAudio(AudioBuffer &buffer){
-    float cutoff = getParameterValue(PARAMETER_A);
-    float reso = getParameterValue(PARAMETER_B);
-    float gain = 1.f + 7.f*getParameterValue(PARAMETER_C);
     float mode = getParameterValue(PARAMETER_D);
-    
-    // shape parameters
-    cutoff *= 2.5f*cutoff*cutoff;
-
-    svf.SetFilterCutoff(cutoff);
-    svf.SetFilterResonance(reso);
 
     if(mode >= 0.f && mode < 0.33f){
-      svf.SetFilterMode(SVF_LOWPASS_MODE);
+      filter->SetFilterMode(SVF_LOWPASS_MODE);
     }
     else if(mode >= 0.33f && mode < 0.66f){
-      svf.SetFilterMode(SVF_BANDPASS_MODE);
+      filter->SetFilterMode(SVF_BANDPASS_MODE);
     }
     else if(mode >= 0.66f && mode < 1.f){
-      svf.SetFilterMode(SVF_HIGHPASS_MODE);
-    }
-    
-    int size = buffer.getSize();
-    
-    float* buf = buffer.getSamples(0);
-    for(int i=0; i<size; ++i){
-      svf.filter(gain*buf[i]);
-      buf[i] = 0.4f*svf.GetFilterOutput()/gain;
+      filter->SetFilterMode(SVF_HIGHPASS_MODE);
     }
+
+    processFilter(buffer);
   }
 };
 
 #endif // __SVFPatch_h__
-
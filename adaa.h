@@ -0,0 +1,265 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __kocmocadaah__
+#define __kocmocadaah__
+
+#include <cmath>
+#include "fastmath.h"
+
+// first order antiderivative antialiasing of the static filter
+// nonlinearities. instead of f(x[n]) the nonlinearity returns the mean of
+// f over the segment between the previous and the current argument,
+//
+//   y[n] = (F(x[n]) - F(x[n-1]))/(x[n] - x[n-1]),
+//
+// with F the antiderivative of f. this cancels most of the aliases f
+// creates at the cost of a half sample delay. the difference of two nearby
+// antiderivative values cancels most of their digits, so each mean is
+// evaluated in single precision from a divided difference form of F that
+// keeps them: polynomial parts through their divided difference, the
+// logarithms through log1p(z)/z of the argument ratio and the arctangent
+// through atan(r)/r of the angle difference. the forms tend to f itself as
+// the segment shrinks and need no midpoint fallback
+
+// log1p(z)/z for z > -1, one at the origin. 1 + z is reduced by powers of
+// two to sqrt(1/2)..sqrt(2) and the logarithm of the rest is taken from
+// the atanh series of s = (w - 1)/(w + 1), |s| < 0.172
+inline float Log1pRatio(float z) {
+  int e;
+  float w = 2.f*frexpf(1.f + z, &e);
+
+  e -= 1;
+  if(w > 1.41421356f) {
+    w *= 0.5f;
+    e += 1;
+  }
+
+  // unreduced arguments take s from z to keep the digits near the origin
+  if(e == 0) {
+    float s = z/(2.f + z);
+    float t = s*s;
+
+    return 2.f/(2.f + z)*(1.f + t*(1.f/3.f + t*(1.f/5.f + t*(1.f/7.f + t*(1.f/9.f)))));
+  }
+
+  float s = (w - 1.f)/(w + 1.f);
+  float t = s*s;
+
+  return ((float)e*0.693147181f + 2.f*s*(1.f + t*(1.f/3.f + t*(1.f/5.f + t*(1.f/7.f + t*(1.f/9.f))))))/z;
+}
+
+// atan(r)/r, one at the origin. arguments above tan(pi/8) are reduced by
+// the pi/4 and pi/2 reflections, the rest takes the cephes atanf polynomial
+inline float AtanRatio(float r) {
+  float a = fabsf(r);
+
+  if(a <= 0.414213562f) {
+    float z = a*a;
+
+    return 1.f + z*(((8.05374449538e-2f*z - 1.38776856032e-1f)*z + 1.99777106478e-1f)*z - 3.33329491539e-1f);
+  }
+
+  float t = a > 2.41421356f ? -1.f/a : (a - 1.f)/(a + 1.f);
+  float offset = a > 2.41421356f ? 1.57079633f : 0.785398163f;
+  float z = t*t;
+
+  return (offset + t + t*z*(((8.05374449538e-2f*z - 1.38776856032e-1f)*z + 1.99777106478e-1f)*z - 3.33329491539e-1f))/a;
+}
+
+// mean over y..x of an odd approximant held at its edge value outside
+// -edge..edge and continued from there with value slope + curvature*d at
+// d = |x| - edge. inner is the mean of the approximant over a segment
+// inside the edges
+template <float (*inner)(float, float)>
+inline float ClampedMean(float x, float y, float edge, float slope, float curvature) {
+  float cx = x > edge ? edge : (x < -edge ? -edge : x);
+  float cy = y > edge ? edge : (y < -edge ? -edge : y);
+  float dx = fabsf(x - cx);
+  float dy = fabsf(y - cy);
+  float m = inner(cx, cy);
+
+  // segment inside the edges
+  if(dx == 0.f && dy == 0.f) {
+    return m;
+  }
+
+  // mean of the continuation between its two distances to the edge
+  float c = slope + 0.5f*curvature*(dx + dy);
+
+  // segment beyond one edge
+  if(dx > 0.f && dy > 0.f && x*y > 0.f) {
+    return x > 0.f ? c : -c;
+  }
+
+  // segment crossing an edge, x and y differ here
+  return ((cx - cy)*m + (dx - dy)*c)/(x - y);
+}
+
+// mean of TanhPade32 inside -3..3. the approximant is x/6 + 12.5x/(15 + 6x^2)
+// with antiderivative x^2/12 + 25/24 log(1 + 0.4x^2)
+inline float TanhPade32InnerMean(float x, float y) {
+  float r = 1.f/(2.5f + y*y);
+  float z = (x - y)*(x + y)*r;
+
+  return (x + y)*(1.f/12.f + 25.f/24.f*r*Log1pRatio(z));
+}
+
+inline float TanhPade32Mean(float x, float y) {
+  return ClampedMean<TanhPade32InnerMean>(x, y, 3.f, TanhPade32(3.f), 0.f);
+}
+
+// mean of SinhPade54. with s = x^2 its antiderivative is
+//
+//   3.6733 s + 207.91 log(1 + (5s - 364)s/11088) + 271.06 atan((s - 36.4)/29.877)
+//
+// where the logarithm argument stays above 0.4. the arctangent difference
+// is atan((p - q)/(1 + pq)) while 1 + pq is clearly positive, which holds
+// near the diagonal, and is taken from atan2 of the same pair otherwise
+inline float SinhPade54Mean(float x, float y) {
+  const float c = 29.877081517444104f;
+  float sum = x + y;
+  float u = x*x;
+  float v = y*y;
+  float du = (x - y)*sum;
+
+  // logarithm part, the quotient of the arguments is 1 + du*n/d
+  float n = 5.f*(u + v) - 364.f;
+  float d = (5.f*v - 364.f)*v + 11088.f;
+  float lg = 207.90933333333333f*n/d*Log1pRatio(du*n/d);
+
+  // arctangent part
+  float p = (u - 36.4f)*(1.f/c);
+  float q = (v - 36.4f)*(1.f/c);
+  float dp = du*(1.f/c);
+  float D = 1.f + p*q;
+  float at;
+
+  if(D >= 0.5f) {
+    at = sum/(c*D)*AtanRatio(dp/D);
+  }
+  else {
+    float w = D/fabsf(dp);
+    float angle = 1.57079633f - w*AtanRatio(w);
+
+    at = (dp > 0.f ? angle : -angle)/(x - y);
+  }
+
+  return sum*(3.6733333333333333f + lg) + 271.06447669388960f*at;
+}
+
+// mean of TanhMinimax inside -3..3. with t = x^2 the antiderivative is the
+// polynomial P(t) below, the mean is (x + y) times its divided difference
+// between t = x^2 and t = y^2, whose coefficients are the partial Horner
+// sums of P at y^2
+inline float TanhMinimaxInnerMean(float x, float y) {
+  float u = x*x;
+  float v = y*y;
+  float c5 = -4.53793306e-5f/12.f;
+  float c4 = 1.29517081e-3f/10.f + v*c5;
+  float c3 = -1.46265975e-2f/8.f + v*c4;
+  float c2 = 8.60343469e-2f/6.f + v*c3;
+  float c1 = -3.10410823e-1f/4.f + v*c2;
+  float c0 = 0.5f + v*c1;
+
+  return (x + y)*(c0 + u*(c1 + u*(c2 + u*(c3 + u*(c4 + u*c5)))));
+}
+
+inline float TanhMinimaxMean(float x, float y) {
+  return ClampedMean<TanhMinimaxInnerMean>(x, y, 3.f, TanhMinimax(3.f), 0.f);
+}
+
+// mean of SinhMinimax inside -MINIMAX_RANGE..MINIMAX_RANGE, the same
+// divided difference of its polynomial antiderivative in x^2
+inline float SinhMinimaxInnerMean(float x, float y) {
+  float u = x*x;
+  float v = y*y;
+  float c4 = 3.976639164e-6f/10.f;
+  float c3 = 1.808139205e-4f/8.f + v*c4;
+  float c2 = 8.425804786e-3f/6.f + v*c3;
+  float c1 = 1.665289551e-1f/4.f + v*c2;
+  float c0 = 0.5f + v*c1;
+
+  return (x + y)*(c0 + u*(c1 + u*(c2 + u*(c3 + u*c4))));
+}
+
+inline float SinhMinimaxMean(float x, float y) {
+  return ClampedMean<SinhMinimaxInnerMean>(x, y, MINIMAX_RANGE, SinhMinimax(MINIMAX_RANGE), MINIMAX_SINH_SLOPE);
+}
+
+// mean of the library sinh of the inverse trapezoidal SVF state mapping,
+// (cosh x - cosh y)/(x - y) = sinh((x + y)/2) sinh(h)/h with h = (x - y)/2
+inline float SinhLibraryMean(float x, float y) {
+  float h = 0.5f*(x - y);
+  float shc = fabsf(h) < 1.0e-3f ? 1.f + h*h/6.f : sinhf(h)/h;
+
+  return sinhf(0.5f*(x + y))*shc;
+}
+
+// previous argument of one antialiased nonlinearity
+struct ADAAState {
+  float x1;
+};
+
+inline void ResetADAAState(ADAAState& state) {
+  state.x1 = 0.f;
+}
+
+// antialiased nonlinearity with the segment mean m
+template <float (*m)(float, float)>
+inline float ADAAEvaluate(ADAAState& state, float x) {
+  float y = m(x, state.x1);
+
+  state.x1 = x;
+
+  return y;
+}
+
+// antialiased nonlinearities of an approximant set, resolved at compile time
+template <FastmathApproximation approximation>
+struct FastmathADAA {
+  static inline float Tanh(ADAAState& state, float x) {
+    return approximation == FASTMATH_MINIMAX ? ADAAEvaluate<TanhMinimaxMean>(state, x) :
+      ADAAEvaluate<TanhPade32Mean>(state, x);
+  }
+
+  static inline float Sinh(ADAAState& state, float x) {
+    return approximation == FASTMATH_MINIMAX ? ADAAEvaluate<SinhMinimaxMean>(state, x) :
+      ADAAEvaluate<SinhPade54Mean>(state, x);
+  }
+};
+
+// antialiased nonlinearities of an approximant set selected at run time
+struct FastmathADAARuntime {
+  FastmathApproximation approximation;
+
+  inline float Tanh(ADAAState& state, float x) const {
+    return approximation == FASTMATH_MINIMAX ? FastmathADAA<FASTMATH_MINIMAX>::Tanh(state, x) :
+      FastmathADAA<FASTMATH_PADE>::Tanh(state, x);
+  }
+
+  inline float Sinh(ADAAState& state, float x) const {
+    return approximation == FASTMATH_MINIMAX ? FastmathADAA<FASTMATH_MINIMAX>::Sinh(state, x) :
+      FastmathADAA<FASTMATH_PADE>::Sinh(state, x);
+  }
+};
+
+#endif
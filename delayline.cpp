@@ -0,0 +1,494 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of DigiDelay OWL Patch.
+ *
+ *  DigiDelay OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  DigiDelay OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with DigiDelay OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "delayline.h"
+#include "simd.h"
+
+// stored samples as float, the fixed point scale is folded into the
+// interpolation weights
+static inline SIMDFloat LoadSamples(const float* x){
+  return SIMDLoad(x);
+}
+
+static inline SIMDFloat LoadSamples(const int16_t* x){
+  return SIMDLoadInt16(x);
+}
+
+static inline SIMDFloat LoadSamples(const uint16_t* x){
+  return SIMDLoadHalf(x);
+}
+
+static inline float SampleValue(const float* x){
+  return *x;
+}
+
+static inline float SampleValue(const int16_t* x){
+  return (float)(*x);
+}
+
+static inline float SampleValue(const uint16_t* x){
+  return HalfToFloat(*x);
+}
+
+// interpolate one contiguous span, out[k] = w0*x[k + 1] + w1*x[k]
+template <typename T>
+static void InterpolateSpan(const T* x, float* out, int n, float w0, float w1){
+  SIMDFloat w0v = w0;
+  SIMDFloat w1v = w1;
+  int k = 0;
+
+  for(; k + SIMD_WIDTH <= n; k += SIMD_WIDTH){
+    SIMDStore(out + k, w0v*LoadSamples(x + k + 1) + w1v*LoadSamples(x + k));
+  }
+  for(; k < n; k++){
+    out[k] = w0*SampleValue(x + k + 1) + w1*SampleValue(x + k);
+  }
+}
+
+// interpolate one contiguous span with four points,
+// out[k] = w[0]*x[k] + w[1]*x[k + 1] + w[2]*x[k + 2] + w[3]*x[k + 3]
+template <typename T>
+static void InterpolateSpan4(const T* x, float* out, int n, const float* w){
+  SIMDFloat w0v = w[0];
+  SIMDFloat w1v = w[1];
+  SIMDFloat w2v = w[2];
+  SIMDFloat w3v = w[3];
+  int k = 0;
+
+  for(; k + SIMD_WIDTH <= n; k += SIMD_WIDTH){
+    SIMDFloat a = w0v*LoadSamples(x + k) + w1v*LoadSamples(x + k + 1);
+    SIMDFloat b = w2v*LoadSamples(x + k + 2) + w3v*LoadSamples(x + k + 3);
+    SIMDStore(out + k, a + b);
+  }
+  for(; k < n; k++){
+    out[k] = (w[0]*SampleValue(x + k) + w[1]*SampleValue(x + k + 1))
+      + (w[2]*SampleValue(x + k + 2) + w[3]*SampleValue(x + k + 3));
+  }
+}
+
+// interpolate n samples from readPointer on. the span up to the wrap
+// point reads into the guard, the rest restarts at the head of the
+// buffer
+template <typename T>
+static void InterpolateSpans(const T* buffer, int length, int readPointer, float* out, int n,
+			     const float* w, int taps){
+  int first = length - readPointer;
+  if(first > n){
+    first = n;
+  }
+
+  if(taps == 2){
+    InterpolateSpan(buffer + readPointer, out, first, w[1], w[0]);
+    InterpolateSpan(buffer, out + first, n - first, w[1], w[0]);
+  }
+  else{
+    InterpolateSpan4(buffer + readPointer, out, first, w);
+    InterpolateSpan4(buffer, out + first, n - first, w);
+  }
+}
+
+// interpolate one sample from the points at x on
+template <typename T>
+static inline float InterpolateSample(const T* x, const float* w, int taps){
+  float y = w[0]*SampleValue(x) + w[1]*SampleValue(x + 1);
+  if(taps == 4){
+    y += w[2]*SampleValue(x + 2) + w[3]*SampleValue(x + 3);
+  }
+  return y;
+}
+
+// add one interpolated tap of a contiguous span to a stereo mix, with
+// the tap gains folded into separate left and right weights
+template <typename T, int points>
+static void MixSpan(const T* x, float* left, float* right, int n, const float* wl, const float* wr){
+  int k = 0;
+
+  for(; k + SIMD_WIDTH <= n; k += SIMD_WIDTH){
+    SIMDFloat l = SIMDLoad(left + k);
+    SIMDFloat r = SIMDLoad(right + k);
+    for(int p=0; p<points; p++){
+      SIMDFloat v = LoadSamples(x + k + p);
+      l += SIMDFloat(wl[p])*v;
+      r += SIMDFloat(wr[p])*v;
+    }
+    SIMDStore(left + k, l);
+    SIMDStore(right + k, r);
+  }
+  for(; k < n; k++){
+    for(int p=0; p<points; p++){
+      float v = SampleValue(x + k + p);
+      left[k] += wl[p]*v;
+      right[k] += wr[p]*v;
+    }
+  }
+}
+
+// mix n samples of a tap from readPointer on, split at the wrap point
+template <typename T>
+static void MixSpans(const T* buffer, int length, int readPointer, float* left, float* right, int n,
+		     const float* wl, const float* wr, int taps){
+  int first = length - readPointer;
+  if(first > n){
+    first = n;
+  }
+
+  if(taps == 2){
+    MixSpan<T, 2>(buffer + readPointer, left, right, first, wl, wr);
+    MixSpan<T, 2>(buffer, left + first, right + first, n - first, wl, wr);
+  }
+  else{
+    MixSpan<T, 4>(buffer + readPointer, left, right, first, wl, wr);
+    MixSpan<T, 4>(buffer, left + first, right + first, n - first, wl, wr);
+  }
+}
+
+// float to 16 bit fixed point with triangular dither of one lsb peak
+static inline int16_t FloatToFixed(float x, float dither){
+  float y = x*(32767.f/DELAYLINE_FIXED_RANGE) + dither;
+  if(y > 32767.f){
+    y = 32767.f;
+  }
+  if(y < -32767.f){
+    y = -32767.f;
+  }
+
+  // round to nearest on a positive offset so truncation floors
+  return (int16_t)((int)(y + 32768.5f) - 32768);
+}
+
+// float to half precision, the reverse of HalfToFloat(). adding random
+// bits below the kept mantissa before truncating rounds stochastically,
+// which decorrelates the rounding error from the signal like dither
+static inline uint16_t FloatToHalf(float x, uint32_t random){
+  float a = fabsf(x);
+  if(!(a < 65504.f)){
+    a = 65504.f;
+  }
+  a *= 1.925929944387236e-34f;
+
+  uint32_t bits, sign;
+  memcpy(&bits, &a, 4);
+  memcpy(&sign, &x, 4);
+
+  return (uint16_t)(((sign >> 16) & 0x8000) | ((bits + (random & 0x1fff)) >> 13));
+}
+
+// constructor
+DelayLine::DelayLine(int newLength){
+  Init(newLength, DELAY_STORAGE_FLOAT32);
+}
+
+DelayLine::DelayLine(int newLength, DelayStorageFormat newFormat){
+  Init(newLength, newFormat);
+}
+
+// destructor
+DelayLine::~DelayLine(){
+  delete[] ringBuffer;
+  delete[] fixedBuffer;
+  delete[] halfBuffer;
+}
+
+void DelayLine::Init(int newLength, DelayStorageFormat newFormat){
+  bufferLength = newLength;
+  format = newFormat;
+  interpolation = DELAY_INTERPOLATION_LINEAR;
+
+  ringBuffer = 0;
+  fixedBuffer = 0;
+  halfBuffer = 0;
+
+  switch(format){
+  case DELAY_STORAGE_FLOAT32:
+    ringBuffer = new float[bufferLength + DELAYLINE_GUARD];
+    break;
+  case DELAY_STORAGE_INT16:
+    fixedBuffer = new int16_t[bufferLength + DELAYLINE_GUARD];
+    break;
+  case DELAY_STORAGE_FLOAT16:
+    halfBuffer = new uint16_t[bufferLength + DELAYLINE_GUARD];
+    break;
+  }
+
+  ClearDelay();
+}
+
+void DelayLine::ClearDelay(){
+  int size = bufferLength + DELAYLINE_GUARD;
+
+  switch(format){
+  case DELAY_STORAGE_FLOAT32:
+    for(int i=0; i<size; i++){
+      ringBuffer[i] = 0.f;
+    }
+    break;
+  case DELAY_STORAGE_INT16:
+    for(int i=0; i<size; i++){
+      fixedBuffer[i] = 0;
+    }
+    break;
+  case DELAY_STORAGE_FLOAT16:
+    for(int i=0; i<size; i++){
+      halfBuffer[i] = 0;
+    }
+    break;
+  }
+
+  writePointer = 0;
+  ditherNoise.SetNoiseSeed(NOISE_DEFAULT_SEED);
+}
+
+int DelayLine::GetDelayLength(){
+  return bufferLength;
+}
+
+int DelayLine::WrapDelay(float delay){
+  // a full buffer of delay reads the write head
+  int d = (int)(delay);
+  return d < bufferLength ? d : d - bufferLength;
+}
+
+int DelayLine::GetDelaySpan(float delay){
+  int d = WrapDelay(delay);
+
+  // the four point kernels read one sample newer than the delay, below
+  // one sample of delay they fall back to linear interpolation
+  if(interpolation != DELAY_INTERPOLATION_LINEAR && d >= 1){
+    return d;
+  }
+  return d + 1;
+}
+
+void DelayLine::SetDelayInterpolation(DelayInterpolation newInterpolation){
+  interpolation = newInterpolation;
+}
+
+int DelayLine::DelayWeights(float delay, float* weights, int* offset){
+  int d = WrapDelay(delay);
+
+  // fractional position, the interpolation weights are constant over
+  // the block
+  float frac = delay - (float)((int)(delay));
+  int taps = 4;
+  float t = 1.f - frac;
+
+  if(interpolation == DELAY_INTERPOLATION_LINEAR || d < 1){
+    taps = 2;
+    weights[0] = frac;
+    weights[1] = 1.f - frac;
+  }
+  else if(interpolation == DELAY_INTERPOLATION_HERMITE){
+    // catmull-rom spline between the middle two points at t
+    weights[0] = 0.5f*t*((2.f - t)*t - 1.f);
+    weights[1] = 0.5f*((3.f*t - 5.f)*t*t + 2.f);
+    weights[2] = 0.5f*t*((4.f - 3.f*t)*t + 1.f);
+    weights[3] = 0.5f*(t - 1.f)*t*t;
+  }
+  else{
+    // third order lagrange polynomial through the points at -1, 0, 1, 2
+    weights[0] = -(1.f/6.f)*t*(t - 1.f)*(t - 2.f);
+    weights[1] = 0.5f*(t + 1.f)*(t - 1.f)*(t - 2.f);
+    weights[2] = -0.5f*(t + 1.f)*t*(t - 2.f);
+    weights[3] = (1.f/6.f)*(t + 1.f)*t*(t - 1.f);
+  }
+
+  // fixed point samples are scaled with the weights
+  if(format == DELAY_STORAGE_INT16){
+    for(int k=0; k<taps; k++){
+      weights[k] *= DELAYLINE_FIXED_RANGE/32767.f;
+    }
+  }
+
+  // oldest interpolation point of the first output sample
+  *offset = d + taps/2;
+
+  return taps;
+}
+
+int DelayLine::ReadPointer(int offset){
+  int r = writePointer - offset;
+  while(r < 0){
+    r += bufferLength;
+  }
+  return r;
+}
+
+void DelayLine::SetDelayTap(float delay, DelayTap* tap){
+  tap->points = DelayWeights(delay, tap->weights, &tap->offset);
+}
+
+void DelayLine::ReadDelay(float delay, float* out, int n){
+  DelayTap tap;
+  SetDelayTap(delay, &tap);
+  ReadDelay(tap, out, n);
+}
+
+void DelayLine::ReadDelay(const DelayTap& tap, float* out, int n){
+  int readPointer = ReadPointer(tap.offset);
+
+  switch(format){
+  case DELAY_STORAGE_FLOAT32:
+    InterpolateSpans(ringBuffer, bufferLength, readPointer, out, n, tap.weights, tap.points);
+    break;
+  case DELAY_STORAGE_INT16:
+    InterpolateSpans(fixedBuffer, bufferLength, readPointer, out, n, tap.weights, tap.points);
+    break;
+  case DELAY_STORAGE_FLOAT16:
+    InterpolateSpans(halfBuffer, bufferLength, readPointer, out, n, tap.weights, tap.points);
+    break;
+  }
+}
+
+float DelayLine::ReadDelaySample(const DelayTap& tap){
+  int readPointer = ReadPointer(tap.offset);
+
+  switch(format){
+  case DELAY_STORAGE_INT16:
+    return InterpolateSample(fixedBuffer + readPointer, tap.weights, tap.points);
+  case DELAY_STORAGE_FLOAT16:
+    return InterpolateSample(halfBuffer + readPointer, tap.weights, tap.points);
+  default:
+    return InterpolateSample(ringBuffer + readPointer, tap.weights, tap.points);
+  }
+}
+
+void DelayLine::MixDelayTaps(int count, const float* delays, const float* leftGains, const float* rightGains,
+			     float* left, float* right, int n){
+  for(int k=0; k<n; k++){
+    left[k] = 0.f;
+    right[k] = 0.f;
+  }
+
+  for(int j=0; j<count; j++){
+    float weights[4];
+    int offset;
+    int taps = DelayWeights(delays[j], weights, &offset);
+    int readPointer = ReadPointer(offset);
+
+    // tap gains folded into the interpolation weights
+    float leftWeights[4], rightWeights[4];
+    for(int k=0; k<taps; k++){
+      leftWeights[k] = leftGains[j]*weights[k];
+      rightWeights[k] = rightGains[j]*weights[k];
+    }
+
+    switch(format){
+    case DELAY_STORAGE_FLOAT32:
+      MixSpans(ringBuffer, bufferLength, readPointer, left, right, n, leftWeights, rightWeights, taps);
+      break;
+    case DELAY_STORAGE_INT16:
+      MixSpans(fixedBuffer, bufferLength, readPointer, left, right, n, leftWeights, rightWeights, taps);
+      break;
+    case DELAY_STORAGE_FLOAT16:
+      MixSpans(halfBuffer, bufferLength, readPointer, left, right, n, leftWeights, rightWeights, taps);
+      break;
+    }
+  }
+}
+
+void DelayLine::DitherBits(uint16_t* out, int n){
+  // 16 random bits per sample, one generator step serves two samples
+  uint32_t r[DELAYLINE_DITHER_CHUNK/2];
+  ditherNoise.NoiseBitsBlock(r, (n + 1)/2);
+
+  for(int j=0; j<n/2; j++){
+    out[2*j] = (uint16_t)(r[j] & 0xffff);
+    out[2*j + 1] = (uint16_t)(r[j] >> 16);
+  }
+  if(n & 1){
+    out[n - 1] = (uint16_t)(r[n/2] & 0xffff);
+  }
+}
+
+void DelayLine::WriteSpan(int start, const float* in, int n){
+  switch(format){
+  case DELAY_STORAGE_FLOAT32:
+    for(int k=0; k<n; k++){
+      ringBuffer[start + k] = in[k];
+    }
+    break;
+  case DELAY_STORAGE_INT16:
+    for(int k=0; k<n; k += DELAYLINE_DITHER_CHUNK){
+      uint16_t r[DELAYLINE_DITHER_CHUNK];
+      int m = n - k < DELAYLINE_DITHER_CHUNK ? n - k : DELAYLINE_DITHER_CHUNK;
+      DitherBits(r, m);
+
+      // triangular dither from the sum of the two 8 bit halves
+      for(int j=0; j<m; j++){
+	float dither = (float)((r[j] & 0xff) + (r[j] >> 8))*(1.f/256.f) - 1.f;
+	fixedBuffer[start + k + j] = FloatToFixed(in[k + j], dither);
+      }
+    }
+    break;
+  case DELAY_STORAGE_FLOAT16:
+    for(int k=0; k<n; k += DELAYLINE_DITHER_CHUNK){
+      uint16_t r[DELAYLINE_DITHER_CHUNK];
+      int m = n - k < DELAYLINE_DITHER_CHUNK ? n - k : DELAYLINE_DITHER_CHUNK;
+      DitherBits(r, m);
+
+      for(int j=0; j<m; j++){
+	halfBuffer[start + k + j] = FloatToHalf(in[k + j], r[j]);
+      }
+    }
+    break;
+  }
+}
+
+void DelayLine::MirrorGuard(){
+  for(int k=0; k<DELAYLINE_GUARD; k++){
+    switch(format){
+    case DELAY_STORAGE_FLOAT32:
+      ringBuffer[bufferLength + k] = ringBuffer[k];
+      break;
+    case DELAY_STORAGE_INT16:
+      fixedBuffer[bufferLength + k] = fixedBuffer[k];
+      break;
+    case DELAY_STORAGE_FLOAT16:
+      halfBuffer[bufferLength + k] = halfBuffer[k];
+      break;
+    }
+  }
+}
+
+void DelayLine::WriteDelay(const float* in, int n){
+  int start = writePointer + 1;
+  if(start > bufferLength - 1){
+    start -= bufferLength;
+  }
+
+  // span up to the end of the buffer and the wrapped rest
+  int first = bufferLength - start;
+  if(first > n){
+    first = n;
+  }
+
+  WriteSpan(start, in, first);
+  WriteSpan(0, in + first, n - first);
+
+  // mirror the head of the buffer into the guard after writing to it
+  if(first < n || start < DELAYLINE_GUARD){
+    MirrorGuard();
+  }
+
+  writePointer = first < n ? n - first - 1 : start + n - 1;
+}
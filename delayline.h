@@ -0,0 +1,175 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of DigiDelay OWL Patch.
+ *
+ *  DigiDelay OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  DigiDelay OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with DigiDelay OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __dspdelaylineh__
+#define __dspdelaylineh__
+
+#include <stdint.h>
+#include "noise.h"
+
+// samples mirrored past the end of the ring buffer so that interpolated
+// reads across the wrap point stay contiguous
+#define DELAYLINE_GUARD 4
+
+// full scale of the 16 bit fixed point storage, 6 dB above the
+// nominal signal level for the feedback path
+#define DELAYLINE_FIXED_RANGE 2.f
+
+// samples converted per generated block of dither
+#define DELAYLINE_DITHER_CHUNK 64
+
+// sample storage formats. the 16 bit formats halve the memory and its
+// bandwidth, fixed point with triangular dither at a constant noise
+// floor, half precision with stochastic rounding at a level dependent
+// one that follows the signal down
+enum DelayStorageFormat {
+  DELAY_STORAGE_FLOAT32,
+  DELAY_STORAGE_INT16,
+  DELAY_STORAGE_FLOAT16
+};
+
+// spans shorter than this many samples are better processed a sample at
+// a time with ReadDelaySample(), delays shorter than a few samples feed
+// back within the block and leave spans of only a few samples
+#define DELAYLINE_MIN_SPAN 4
+
+// fractional delay interpolation. the four point kernels read the two
+// samples on either side of the delay with weights computed once per
+// block, which costs about the same as linear interpolation and keeps
+// the high end of repeats that feed back many times
+enum DelayInterpolation {
+  DELAY_INTERPOLATION_LINEAR,
+  DELAY_INTERPOLATION_HERMITE,
+  DELAY_INTERPOLATION_LAGRANGE
+};
+
+// interpolation of one delay, set up once and read over the spans of a
+// block while the delay holds
+struct DelayTap {
+  // weights of the interpolation points from the oldest sample on
+  float weights[4];
+  int points;
+
+  // distance of the oldest point behind the write head
+  int offset;
+};
+
+// one sample step of the crossfade between the two taps of the DigiDelay
+// patches, towards the second tap while fadeIn is set and back towards
+// the first otherwise
+inline float AdvanceFade(float value, int fadeIn, float rate){
+  if(fadeIn){
+    value += rate;
+    return value > 1.f ? 1.f : value;
+  }
+  value -= rate;
+  return value < 0.f ? 0.f : value;
+}
+
+// ring buffer delay processed a block at a time. blocks are split into
+// at most two contiguous spans at the wrap point and the read offset is
+// computed once per block, so the inner loops run without branches
+class DelayLine{
+public:
+  // constructor/destructor
+  DelayLine(int newLength);
+  DelayLine(int newLength, DelayStorageFormat newFormat);
+  ~DelayLine();
+
+  // read n samples delayed by a fractional number of samples from the
+  // current write head. n may not exceed the span of the delay, the
+  // samples it reads have to be written already
+  void ReadDelay(float delay, float* out, int n);
+
+  // set up the interpolation of a delay for ReadDelay()
+  void SetDelayTap(float delay, DelayTap* tap);
+
+  // read n samples of a tap set up with SetDelayTap(), with the limits of
+  // ReadDelay()
+  void ReadDelay(const DelayTap& tap, float* out, int n);
+
+  // read the next sample of a tap, for delays that feed back within a
+  // few samples
+  float ReadDelaySample(const DelayTap& tap);
+
+  // mix count taps of the buffer into a stereo pair. each tap reads its
+  // delay with its own left and right gain, n may not exceed the
+  // shortest span of the tap delays
+  void MixDelayTaps(int count, const float* delays, const float* leftGains, const float* rightGains,
+		    float* left, float* right, int n);
+
+  // write n samples at the write head and advance it
+  void WriteDelay(const float* in, int n);
+
+  // longest block that can be read before it has to be written, reads
+  // of shorter delays depend on samples of the same block
+  int GetDelaySpan(float delay);
+
+  // set fractional delay interpolation, linear by default
+  void SetDelayInterpolation(DelayInterpolation newInterpolation);
+
+  // get buffer length in samples
+  int GetDelayLength();
+
+  // clear buffer
+  void ClearDelay();
+
+private:
+  // allocate and clear the buffer of the storage format
+  void Init(int newLength, DelayStorageFormat newFormat);
+
+  // integer delay wrapped to the buffer length
+  int WrapDelay(float delay);
+
+  // interpolation weights of a delay from the oldest point on and the
+  // distance of that point behind the write head, returns the number of
+  // points
+  int DelayWeights(float delay, float* weights, int* offset);
+
+  // buffer index of the point offset samples behind the write head
+  int ReadPointer(int offset);
+
+  // random bits for the dither of up to DELAYLINE_DITHER_CHUNK samples
+  void DitherBits(uint16_t* out, int n);
+
+  // convert and store n samples from index start on
+  void WriteSpan(int start, const float* in, int n);
+
+  // copy the head of the buffer into the guard
+  void MirrorGuard();
+
+  // ring buffer with the guard samples at its end, only the one of the
+  // storage format is allocated
+  float *ringBuffer;
+  int16_t *fixedBuffer;
+  uint16_t *halfBuffer;
+  int bufferLength;
+  DelayStorageFormat format;
+  DelayInterpolation interpolation;
+
+  // dither and rounding noise of the 16 bit formats
+  NoiseGenerator ditherNoise;
+
+  // position of the last written sample
+  int writePointer;
+};
+
+#endif
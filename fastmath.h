@@ -22,36 +22,50 @@
 #ifndef __kocmocfastmathh__
 #define __kocmocfastmathh__
 
+// approximants are evaluated in single precision only, with float
+// constants and horner form polynomials in x^2, so that no call is
+// promoted to double on a single precision FPU. simdmath.h has the
+// vector versions
+
 // pade 9/8 approximant for sinh
 inline float SinhPade98(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return (x*(4585922449.0*x*x*x*x*x*x*x*x + 1066023933480.0*x*x*x*x*x*x + 83284044283440.0*x*x*x*x + 2303682236856000.0*x*x + 15605159573203200.0))/
-            (45.0*(1029037.0*x*x*x*x*x*x*x*x - 345207016.0*x*x*x*x*x*x + 61570292784.0*x*x*x*x - 6603948711360.0*x*x + 346781323848960.0));
+  return x*((((4585922449.f*x2 + 1066023933480.f)*x2 + 83284044283440.f)*x2 + 2303682236856000.f)*x2 + 15605159573203200.f)/
+            (45.f*((((1029037.f*x2 - 345207016.f)*x2 + 61570292784.f)*x2 - 6603948711360.f)*x2 + 346781323848960.f));
 }
 
 // pade 9/8 approximant for asinh
 inline float ASinhPade98(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return (x*(4474275508260072601.0*x*x*x*x*x*x*x*x + 152904157921385089560.0*x*x*x*x*x*x + 876802506140506785840.0*x*x*x*x + 1599149222427667310400.0*x*x + 900717260398840684800.0))/
-    (315.0*(42981288509837475.0*x*x*x*x*x*x*x*x + 779000561224162200.0*x*x*x*x*x*x + 3494582558460865872.0*x*x*x*x + 5553234177230076480.0*x*x + 2859419874282033920.0));
+  return x*((((4474275508260072601.f*x2 + 152904157921385089560.f)*x2 + 876802506140506785840.f)*x2 + 1599149222427667310400.f)*x2 + 900717260398840684800.f)/
+    (315.f*((((42981288509837475.f*x2 + 779000561224162200.f)*x2 + 3494582558460865872.f)*x2 + 5553234177230076480.f)*x2 + 2859419874282033920.f));
 }
 
 // pade 5/4 approximant for sinh
 inline float SinhPade54(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return (x*(551.0*x*x*x*x + 22260*x*x + 166320.0))/(15.0*(5.0*x*x*x*x - 364.0*x*x + 11088.0));
+  return x*((551.f*x2 + 22260.f)*x2 + 166320.f)/(15.f*((5.f*x2 - 364.f)*x2 + 11088.f));
 }
 
 // pade 5/4 approximant for asinh
 inline float ASinhPade54(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return (x*(69049.0*x*x*x*x + 717780.0*x*x + 922320.0))/(15.0*(9675.0*x*x*x*x + 58100.0*x*x + 61488.0));
+  return x*((69049.f*x2 + 717780.f)*x2 + 922320.f)/(15.f*((9675.f*x2 + 58100.f)*x2 + 61488.f));
 }
 
 // pade 5/4 approximant for derivative of asinh
 inline float dASinhPade54(float x) {
-  float n = 44536605.0*x*x*x*x*x*x*x*x + 339381280.0*x*x*x*x*x*x + 2410740304.0*x*x*x*x + 5254518528.0*x*x + 3780774144.0;
-  float d = 9675.0*x*x*x*x + 58100.0*x*x + 61488.0;
+  float x2 = x*x;
+  float n = (((44536605.f*x2 + 339381280.f)*x2 + 2410740304.f)*x2 + 5254518528.f)*x2 + 3780774144.f;
+  float d = (9675.f*x2 + 58100.f)*x2 + 61488.f;
 
   // return approximant
   return n/(d*d);
@@ -59,62 +73,156 @@ inline float dASinhPade54(float x) {
 
 // pade 3/2 approximant for sinh
 inline float SinhPade32(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return -(x*(7.0*x*x + 60.0))/(3.0*(x*x - 20.0));
+  return -(x*(7.f*x2 + 60.f))/(3.f*(x2 - 20.f));
 }
 
 // pade 3/4 approximant for sinh
 inline float SinhPade34(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return (20.0*x*(31.0*x*x*x*x + 294.0))/(11.0*x*x*x*x - 360.0*x*x + 5880.0);
+  return (20.f*x*(31.f*x2*x2 + 294.f))/((11.f*x2 - 360.f)*x2 + 5880.f);
 }
 
 // pade 3/2 approximant for cosh
 inline float CoshPade32(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return -(5.0*x*x + 12.0)/(x*x - 12.0);
+  return -(5.f*x2 + 12.f)/(x2 - 12.f);
 }
 
 // pade 3/4 approximant for cosh
 inline float CoshPade34(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return (4.0*(61.0*x*x + 150.0))/(3.0*x*x*x*x - 56.0*x*x + 600.0);
+  return (4.f*(61.f*x2 + 150.f))/((3.f*x2 - 56.f)*x2 + 600.f);
 }
 
 // pade 5/4 approximant for cosh
 inline float CoshPade54(float x) {
+  float x2 = x*x;
+
   // return approximant
-  return (313.0*x*x*x*x + 6900.0*x*x + 15120.0)/(13.0*x*x*x*x - 660.0*x*x + 15120.0);
+  return ((313.f*x2 + 6900.f)*x2 + 15120.f)/((13.f*x2 - 660.f)*x2 + 15120.f);
 }
 
 // pade 3/2 approximant for tanh
 inline float TanhPade32(float x) {
   // clamp x to -3..3
-  if(x > 3.0) {
-    x = 3.0;
+  if(x > 3.f) {
+    x = 3.f;
   }
-  else if(x < -3.0) {
-    x = -3.0;
+  else if(x < -3.f) {
+    x = -3.f;
   }
+
+  float x2 = x*x;
+
   // return approximant
-  return x*(15.0 + x*x)/(15.0 + 6.0*x*x);
+  return x*(15.f + x2)/(15.f + 6.f*x2);
 }
 
 // pade 5/4 approximant for tanh
 inline float TanhPade54(float x) {
   // clamp x to -4..4
-  if(x > 4.0) {
-    x = 4.0;
+  if(x > 4.f) {
+    x = 4.f;
   }
-  else if(x < -4.0) {
-    x = -4.0;
+  else if(x < -4.f) {
+    x = -4.f;
   }
+
+  float x2 = x*x;
+
+  // return approximant
+  return x*((x2 + 105.f)*x2 + 945.f)/((15.f*x2 + 420.f)*x2 + 945.f);
+}
+
+// minimax polynomial approximants, free of divisions. the polynomials
+// are fitted for least maximum relative error over the ranges the filters
+// use, with the slope at zero kept exact, and evaluated in estrin form
+// to keep the dependency chain short. cosh and dasinh are the derivatives
+// of the sinh and asinh polynomials, so the newton solvers see the slope
+// of the function they solve. asinh is fitted against its derivative as
+// well, which keeps it monotonic, and both fits end on the slope of the
+// exact function at the range edge. outside the range tanh saturates,
+// sinh and asinh continue along their edge tangent and cosh and dasinh
+// hold their edge value
+
+// range of the sinh, cosh, asinh and dasinh polynomials
+#define MINIMAX_RANGE 4.f
+
+// slope of the sinh and asinh polynomials at the range edge, within
+// 4e-5 of cosh(4) and 1/sqrt(17)
+#define MINIMAX_SINH_SLOPE 27.3082352f
+#define MINIMAX_ASINH_SLOPE 0.242526054f
+
+// minimax tanh, max relative error 4.2e-3 on -3..3
+inline float TanhMinimax(float x) {
+  // clamp x to -3..3
+  if(x > 3.f) {
+    x = 3.f;
+  }
+  else if(x < -3.f) {
+    x = -3.f;
+  }
+
+  float x2 = x*x;
+  float x4 = x2*x2;
+
+  // return approximant
+  return x*((1.f - 3.10410823e-1f*x2) + x4*((8.60343469e-2f - 1.46265975e-2f*x2) + x4*(1.29517081e-3f - 4.53793306e-5f*x2)));
+}
+
+// minimax sinh, max relative error 5.3e-5 on -4..4
+inline float SinhMinimax(float x) {
+  float xc = x > MINIMAX_RANGE ? MINIMAX_RANGE : (x < -MINIMAX_RANGE ? -MINIMAX_RANGE : x);
+  float x2 = xc*xc;
+  float x4 = x2*x2;
+
   // return approximant
-  return x*(945.0 + 105.0*x*x+x*x*x*x)/(945.0 + 420.0*x*x + 15.0*x*x*x*x);
+  return xc*((1.f + 1.665289551e-1f*x2) + x4*((8.425804786e-3f + 1.808139205e-4f*x2) + x4*3.976639164e-6f)) +
+    MINIMAX_SINH_SLOPE*(x - xc);
+}
+
+// derivative of the minimax sinh, max relative error 1.8e-4 on -4..4
+inline float CoshMinimax(float x) {
+  float xc = x > MINIMAX_RANGE ? MINIMAX_RANGE : (x < -MINIMAX_RANGE ? -MINIMAX_RANGE : x);
+  float x2 = xc*xc;
+  float x4 = x2*x2;
+
+  // return approximant
+  return (1.f + 3.f*1.665289551e-1f*x2) + x4*((5.f*8.425804786e-3f + 7.f*1.808139205e-4f*x2) + x4*(9.f*3.976639164e-6f));
+}
+
+// minimax asinh, max relative error 6.8e-3 on -4..4
+inline float ASinhMinimax(float x) {
+  float xc = x > MINIMAX_RANGE ? MINIMAX_RANGE : (x < -MINIMAX_RANGE ? -MINIMAX_RANGE : x);
+  float x2 = xc*xc;
+  float x4 = x2*x2;
+
+  // return approximant
+  return xc*((1.f - 1.380802244e-1f*x2) + x4*((2.757754736e-2f - 3.567796666e-3f*x2) + x4*((2.640786988e-4f - 1.019273441e-5f*x2) + x4*1.589768743e-7f))) +
+    MINIMAX_ASINH_SLOPE*(x - xc);
+}
+
+// derivative of the minimax asinh, max relative error 3.4e-2 on -4..4
+inline float dASinhMinimax(float x) {
+  float xc = x > MINIMAX_RANGE ? MINIMAX_RANGE : (x < -MINIMAX_RANGE ? -MINIMAX_RANGE : x);
+  float x2 = xc*xc;
+  float x4 = x2*x2;
+
+  // return approximant
+  return (1.f - 3.f*1.380802244e-1f*x2) + x4*((5.f*2.757754736e-2f - 7.f*3.567796666e-3f*x2) + x4*((9.f*2.640786988e-4f - 11.f*1.019273441e-5f*x2) + x4*(13.f*1.589768743e-7f)));
 }
 
 inline float SinhExpTaylor(float x, int N) {
-  float n=1.0, d=1.0, s=-1.0, t=1.0, exp_plus=1.0, exp_minus=1.0;
+  float n=1.f, d=1.f, s=-1.f, t=1.f, exp_plus=1.f, exp_minus=1.f;
   
   // compute power series approximation
   for(int ii=2; ii < N; ii++){
@@ -123,14 +231,14 @@ inline float SinhExpTaylor(float x, int N) {
     exp_plus += t;
     exp_minus += s*t;
     d *= ii;
-    s *= -1.0;
+    s *= -1.f;
   }
 
-  return (exp_plus - exp_minus)/2.0;
+  return (exp_plus - exp_minus)/2.f;
 }
 
 inline float ExpTaylor(float x, int N) {
-  float n=1.0, d=1.0, t=1.0, exp=1.0;
+  float n=1.f, d=1.f, t=1.f, exp=1.f;
   
   // compute power series approximation
   for(int ii=2; ii < N; ii++){
@@ -147,7 +255,7 @@ inline float BramSaturator(float x, float a) {
   float absX;
   float out;
 
-  if(x < 0.0) {
+  if(x < 0.f) {
     absX = -x;
   }
   else {
@@ -157,16 +265,16 @@ inline float BramSaturator(float x, float a) {
   if(absX < a) {
     out = absX;
   }
-  else if(absX > 1.0) {
-    out = (a+1.0)/2.0;
+  else if(absX > 1.f) {
+    out = (a+1.f)/2.f;
   }
   else {
-    out = (absX - a)/(1.0 - a);
-    out = a + (absX - a)/(1.0 + out*out);
+    out = (absX - a)/(1.f - a);
+    out = a + (absX - a)/(1.f + out*out);
   }
 
-  if(x < 0.0) {
-    out *= -1.0;
+  if(x < 0.f) {
+    out *= -1.f;
   }
 
   return out;
@@ -176,16 +284,60 @@ inline float TanhExpTaylor(float x, int N) {
   float e;
 
   // clamp x to -3..3
-  if(x > 3.0) {
-    x = 3.0;
+  if(x > 3.f) {
+    x = 3.f;
   }
-  else if(x < -3.0) {
-    x = -3.0;
+  else if(x < -3.f) {
+    x = -3.f;
   }
   
-  e = ExpTaylor(2.0*x, N);
+  e = ExpTaylor(2.f*x, N);
   
-  return (e - 1.0)/(e + 1.0);
+  return (e - 1.f)/(e + 1.f);
 }
 
+// nonlinearity approximants selectable per filter instance
+enum FastmathApproximation {
+  FASTMATH_PADE,
+  FASTMATH_MINIMAX
+};
+
+// approximant set of the filter kernels, resolved at compile time
+template <FastmathApproximation approximation>
+struct Fastmath {
+  static inline float Tanh(float x) {
+    return approximation == FASTMATH_MINIMAX ? TanhMinimax(x) : TanhPade32(x);
+  }
+
+  static inline float Sinh(float x) {
+    return approximation == FASTMATH_MINIMAX ? SinhMinimax(x) : SinhPade54(x);
+  }
+
+  static inline float Cosh(float x) {
+    return approximation == FASTMATH_MINIMAX ? CoshMinimax(x) : CoshPade54(x);
+  }
+
+  static inline float ASinh(float x) {
+    return approximation == FASTMATH_MINIMAX ? ASinhMinimax(x) : ASinhPade54(x);
+  }
+
+  static inline float dASinh(float x) {
+    return approximation == FASTMATH_MINIMAX ? dASinhMinimax(x) : dASinhPade54(x);
+  }
+};
+
+// approximant set selected at run time. kernels hold one over the block,
+// so every call takes the same branch
+struct FastmathRuntime {
+  FastmathApproximation approximation;
+
+  inline float Tanh(float x) const {
+    return approximation == FASTMATH_MINIMAX ? TanhMinimax(x) : TanhPade32(x);
+  }
+
+  inline float Sinh(float x) const {
+    return approximation == FASTMATH_MINIMAX ? SinhMinimax(x) : SinhPade54(x);
+  }
+};
+
 #endif
@@ -0,0 +1,201 @@
+/*
+ *  (C) 2021 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Half-band Resampler OWL Patch.
+ *
+ *  Half-band Resampler OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Half-band Resampler OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Half-band Resampler OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include "halfband.h"
+
+// passband edge of the chain relative to the base rate nyquist frequency
+#define HALFBAND_BANDWIDTH 0.9
+
+// constructor
+HalfbandResampler::HalfbandResampler(int newFactor){
+  SetResamplerFactor(newFactor);
+}
+
+// default constructor
+HalfbandResampler::HalfbandResampler(){
+  SetResamplerFactor(2);
+}
+
+// destructor
+HalfbandResampler::~HalfbandResampler(){
+}
+
+void HalfbandResampler::SetResamplerFactor(int newFactor){
+  factor = newFactor;
+
+  // count 2x stages, factors the chain can not handle pass through
+  stages = 0;
+  if(IsResamplerFactor(factor)){
+    while((1 << stages) < factor){
+      stages++;
+    }
+  }
+
+  ComputeCoefficients();
+  InitializeResampler();
+}
+
+int HalfbandResampler::GetResamplerFactor(){
+  return factor;
+}
+
+bool HalfbandResampler::IsResamplerFactor(int factor){
+  // powers of two up to the largest chain
+  return factor >= 1 && factor <= HALFBAND_MAX_FACTOR && (factor & (factor - 1)) == 0;
+}
+
+void HalfbandResampler::InitializeResampler(){
+  for(int s=0; s<HALFBAND_MAX_STAGES; s++){
+    for(int ii=0; ii<HALFBAND_MAX_COEFFICIENTS; ii++){
+      upX[s][ii] = upY[s][ii] = 0.0;
+      downX[s][ii] = downY[s][ii] = 0.0;
+    }
+  }
+}
+
+void HalfbandResampler::Upsample(float input, float *output){
+  float buffer[HALFBAND_MAX_FACTOR];
+
+  // stage 0 runs at the base rate, every later stage doubles the rate
+  output[0] = input;
+
+  for(int s=0; s<stages; s++){
+    const float *c = coef[s];
+    float *x = upX[s];
+    float *y = upY[s];
+
+    for(int m=0; m<(1 << s); m++){
+      buffer[m] = output[m];
+    }
+
+    for(int m=0; m<(1 << s); m++){
+      float even = buffer[m];
+      float odd = buffer[m];
+
+      // even and odd allpass branches
+      for(int ii=0; ii<coefficients[s]; ii+=2){
+	float t = (even - y[ii])*c[ii] + x[ii];
+	x[ii] = even;
+	y[ii] = t;
+	even = t;
+
+	t = (odd - y[ii+1])*c[ii+1] + x[ii+1];
+	x[ii+1] = odd;
+	y[ii+1] = t;
+	odd = t;
+      }
+
+      output[2*m] = even;
+      output[2*m+1] = odd;
+    }
+  }
+}
+
+float HalfbandResampler::Downsample(const float *input){
+  float buffer[HALFBAND_MAX_FACTOR];
+
+  if(stages == 0){
+    return input[0];
+  }
+
+  for(int m=0; m<factor; m++){
+    buffer[m] = input[m];
+  }
+
+  // outermost stage runs at the highest rate
+  for(int s=stages-1; s>=0; s--){
+    const float *c = coef[s];
+    float *x = downX[s];
+    float *y = downY[s];
+
+    for(int m=0; m<(1 << s); m++){
+      // newer sample feeds the even branch
+      float even = buffer[2*m+1];
+      float odd = buffer[2*m];
+
+      // even and odd allpass branches
+      for(int ii=0; ii<coefficients[s]; ii+=2){
+	float t = (even - y[ii])*c[ii] + x[ii];
+	x[ii] = even;
+	y[ii] = t;
+	even = t;
+
+	t = (odd - y[ii+1])*c[ii+1] + x[ii+1];
+	x[ii+1] = odd;
+	y[ii+1] = t;
+	odd = t;
+      }
+
+      buffer[m] = 0.5*(even + odd);
+    }
+  }
+
+  return buffer[0];
+}
+
+void HalfbandResampler::ComputeCoefficients(){
+  for(int s=0; s<stages; s++){
+    // the stage next to the base rate needs the steepest transition,
+    // later stages only have to keep the base band clear of images
+    float transition = 0.25 - HALFBAND_BANDWIDTH/(float)(4 << s);
+    coefficients[s] = s == 0 ? HALFBAND_MAX_COEFFICIENTS : 4;
+
+    // elliptic half-band design through the jacobi nome
+    double k = tan((1.0 - 2.0*transition)*M_PI/4.0);
+    k *= k;
+    double kksqrt = pow(1.0 - k*k, 0.25);
+    double e = 0.5*(1.0 - kksqrt)/(1.0 + kksqrt);
+    double e2 = e*e;
+    double e4 = e2*e2;
+    double q = e*(1.0 + e4*(2.0 + e4*(15.0 + 150.0*e4)));
+
+    int order = coefficients[s]*2 + 1;
+
+    for(int ii=0; ii<coefficients[s]; ii++){
+      int cc = ii + 1;
+
+      // numerator series
+      double num = 0.0;
+      double sign = 1.0;
+      for(int jj=0; jj<16; jj++){
+	num += sign*pow(q, (double)(jj*(jj + 1)))*sin((2*jj + 1)*cc*M_PI/order);
+	sign = -sign;
+      }
+      num *= pow(q, 0.25);
+
+      // denominator series
+      double den = 0.0;
+      sign = -1.0;
+      for(int jj=1; jj<16; jj++){
+	den += sign*pow(q, (double)(jj*jj))*cos(2*jj*cc*M_PI/order);
+	sign = -sign;
+      }
+      den += 0.5;
+
+      double ww = num/den;
+      double wwsq = ww*ww;
+      double x = sqrt((1.0 - wwsq*k)*(1.0 - wwsq/k))/(1.0 + wwsq);
+
+      coef[s][ii] = (1.0 - x)/(1.0 + x);
+    }
+  }
+}
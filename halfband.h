@@ -0,0 +1,86 @@
+/*
+ *  (C) 2021 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Half-band Resampler OWL Patch.
+ *
+ *  Half-band Resampler OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Half-band Resampler OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Half-band Resampler OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __dsphalfbandh__
+#define __dsphalfbandh__
+
+// largest power of two oversampling factor handled by the resampler chain
+#define HALFBAND_MAX_FACTOR 16
+#define HALFBAND_MAX_STAGES 4
+
+// largest number of allpass coefficients in a stage
+#define HALFBAND_MAX_COEFFICIENTS 8
+
+// oversampling resampler used by the filters
+enum ResamplerType {
+  RESAMPLER_IIR,
+  RESAMPLER_HALFBAND
+};
+
+// chain of polyphase allpass half-band stages that interpolates a base rate
+// signal by a power of two and decimates it back. each stage splits its
+// filter into two allpass branches running at the lower rate, so only
+// the samples that are kept get computed
+class HalfbandResampler{
+public:
+  // constructor/destructor
+  HalfbandResampler(int newFactor);
+  HalfbandResampler();
+  ~HalfbandResampler();
+
+  // set resampling factor
+  void SetResamplerFactor(int newFactor);
+
+  // get resampling factor
+  int GetResamplerFactor();
+
+  // check that a factor can be handled by the chain
+  static bool IsResamplerFactor(int factor);
+
+  // clear stage delaylines
+  void InitializeResampler();
+
+  // interpolate one base rate sample into factor oversampled samples
+  void Upsample(float input, float *output);
+
+  // decimate factor oversampled samples into one base rate sample
+  float Downsample(const float *input);
+
+private:
+  // compute allpass coefficients of every stage
+  void ComputeCoefficients();
+
+  // resampling factor and number of 2x stages
+  int factor;
+  int stages;
+
+  // allpass coefficients per stage, even and odd branches interleaved
+  int coefficients[HALFBAND_MAX_STAGES];
+  float coef[HALFBAND_MAX_STAGES][HALFBAND_MAX_COEFFICIENTS];
+
+  // allpass delaylines per stage
+  float upX[HALFBAND_MAX_STAGES][HALFBAND_MAX_COEFFICIENTS];
+  float upY[HALFBAND_MAX_STAGES][HALFBAND_MAX_COEFFICIENTS];
+  float downX[HALFBAND_MAX_STAGES][HALFBAND_MAX_COEFFICIENTS];
+  float downY[HALFBAND_MAX_STAGES][HALFBAND_MAX_COEFFICIENTS];
+};
+
+#endif
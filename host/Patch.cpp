@@ -0,0 +1,28 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Patch.h"
+
+// host defaults, override before constructing a patch
+float Patch::hostSampleRate = 48000.f;
+int Patch::hostBlockSize = 64;
+int Patch::hostChannels = 2;
+float Patch::hostParameterValues[HOST_PARAMETERS] = {0.f};
@@ -0,0 +1,172 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// minimal stand-in for the OWL SDK patch interface so that
+// the patches can be compiled and run offline on a host machine
+
+#ifndef __hostpatchh__
+#define __hostpatchh__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+// number of host parameters
+#define HOST_PARAMETERS 8
+
+// maximum number of host audio channels
+#define HOST_MAX_CHANNELS 8
+
+enum PatchParameterId {
+  PARAMETER_A,
+  PARAMETER_B,
+  PARAMETER_C,
+  PARAMETER_D,
+  PARAMETER_E,
+  PARAMETER_F,
+  PARAMETER_G,
+  PARAMETER_H
+};
+
+enum PatchButtonId {
+  BYPASS_BUTTON,
+  PUSHBUTTON,
+  GREEN_BUTTON,
+  RED_BUTTON,
+  BUTTON_A,
+  BUTTON_B,
+  BUTTON_C,
+  BUTTON_D
+};
+
+class AudioBuffer {
+public:
+  AudioBuffer(int newChannels, int newSize){
+    channels = newChannels;
+    size = newSize;
+
+    // allocate non-interleaved channel buffers
+    samples = new float[channels*size];
+    clear();
+  }
+
+  ~AudioBuffer(){
+    delete[] samples;
+  }
+
+  float* getSamples(int channel){
+    return samples + channel*size;
+  }
+
+  int getChannels(){
+    return channels;
+  }
+
+  int getSize(){
+    return size;
+  }
+
+  void clear(){
+    for(int i=0; i<channels*size; i++){
+      samples[i] = 0.f;
+    }
+  }
+
+private:
+  int channels;
+  int size;
+  float *samples;
+};
+
+class Patch {
+public:
+  Patch(){
+    for(int i=0; i<HOST_PARAMETERS; i++){
+      parameterNames[i] = NULL;
+      parameterValues[i] = hostParameterValues[i];
+    }
+  }
+
+  virtual ~Patch(){}
+
+  // patch side interface
+  void registerParameter(PatchParameterId pid, const char* name){
+    parameterNames[pid] = name;
+  }
+
+  float getParameterValue(PatchParameterId pid){
+    return parameterValues[pid];
+  }
+
+  float getSampleRate(){
+    return hostSampleRate;
+  }
+
+  int getBlockSize(){
+    return hostBlockSize;
+  }
+
+  int getNumberOfChannels(){
+    return hostChannels;
+  }
+
+  virtual void buttonChanged(PatchButtonId bid, uint16_t value, uint16_t samples){}
+
+  virtual void processAudio(AudioBuffer &buffer) = 0;
+
+  // host side interface
+  void setParameterValue(PatchParameterId pid, float value){
+    parameterValues[pid] = value;
+  }
+
+  const char* getParameterName(PatchParameterId pid){
+    return parameterNames[pid];
+  }
+
+  // host settings have to be in place before a patch is constructed
+  static void setHostSampleRate(float newSampleRate){
+    hostSampleRate = newSampleRate;
+  }
+
+  static void setHostBlockSize(int newBlockSize){
+    hostBlockSize = newBlockSize;
+  }
+
+  static void setHostChannels(int newChannels){
+    hostChannels = newChannels;
+  }
+
+  // knob positions the patch constructor reads, like on the device
+  static void setHostParameterValue(PatchParameterId pid, float value){
+    hostParameterValues[pid] = value;
+  }
+
+private:
+  const char* parameterNames[HOST_PARAMETERS];
+  float parameterValues[HOST_PARAMETERS];
+
+  static float hostSampleRate;
+  static int hostBlockSize;
+  static int hostChannels;
+  static float hostParameterValues[HOST_PARAMETERS];
+};
+
+#endif
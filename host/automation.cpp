@@ -0,0 +1,175 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "automation.h"
+
+ParameterAutomation::ParameterAutomation(){
+}
+
+bool ParameterAutomation::Load(const char* path){
+  FILE* f = fopen(path, "r");
+  if(!f){
+    return false;
+  }
+
+  char line[256];
+  int lineNumber = 0;
+  bool ok = true;
+
+  while(fgets(line, sizeof(line), f)){
+    lineNumber++;
+
+    // strip comments
+    char* comment = strchr(line, '#');
+    if(comment){
+      *comment = 0;
+    }
+
+    double time;
+    char target[16], arg[16], mode[16];
+    float value;
+    int fields = sscanf(line, "%lf %15s %15s %15s", &time, target, arg, mode);
+
+    if(fields <= 0){
+      continue;
+    }
+
+    if(fields >= 3 && !strcmp(target, "button")){
+      int state;
+      if(fields != 4 || sscanf(mode, "%d", &state) != 1){
+	ok = false;
+      }
+      else if(!strcmp(arg, "PUSH")){
+	AddButtonEvent(PUSHBUTTON, time, state);
+      }
+      else if(strlen(arg) == 1 && arg[0] >= 'A' && arg[0] <= 'D'){
+	AddButtonEvent((PatchButtonId)(BUTTON_A + arg[0] - 'A'), time, state);
+      }
+      else{
+	ok = false;
+      }
+    }
+    else if(fields >= 3 && strlen(target) == 1 && target[0] >= 'A' && target[0] < 'A' + HOST_PARAMETERS &&
+	    sscanf(arg, "%f", &value) == 1){
+      bool ramp = fields == 4 && !strcmp(mode, "ramp");
+      if(fields == 4 && !ramp){
+	ok = false;
+      }
+      else{
+	AddParameterPoint((PatchParameterId)(target[0] - 'A'), time, value, ramp);
+      }
+    }
+    else{
+      ok = false;
+    }
+
+    if(!ok){
+      fprintf(stderr, "%s:%d: cannot parse automation event\n", path, lineNumber);
+      break;
+    }
+  }
+
+  fclose(f);
+
+  return ok;
+}
+
+void ParameterAutomation::AddParameterPoint(PatchParameterId pid, double time, float value, bool ramp){
+  AutomationPoint p = {time, value, ramp};
+
+  // keep points sorted by time
+  std::vector<AutomationPoint>::iterator it = points[pid].begin();
+  while(it != points[pid].end() && it->time <= time){
+    ++it;
+  }
+  points[pid].insert(it, p);
+}
+
+void ParameterAutomation::AddButtonEvent(PatchButtonId bid, double time, int value){
+  ButtonEvent e = {time, bid, value};
+
+  std::vector<ButtonEvent>::iterator it = buttons.begin();
+  while(it != buttons.end() && it->time <= time){
+    ++it;
+  }
+  buttons.insert(it, e);
+}
+
+bool ParameterAutomation::GetParameterValue(int pid, double time, float &value){
+  const std::vector<AutomationPoint> &p = points[pid];
+
+  if(p.empty()){
+    return false;
+  }
+
+  // hold first value until the first point
+  if(time <= p[0].time){
+    value = p[0].value;
+    return true;
+  }
+
+  for(size_t ii=1; ii<p.size(); ii++){
+    if(time < p[ii].time){
+      if(p[ii].ramp){
+	double x = (time - p[ii-1].time)/(p[ii].time - p[ii-1].time);
+	value = (float)(p[ii-1].value + x*(p[ii].value - p[ii-1].value));
+      }
+      else{
+	value = p[ii-1].value;
+      }
+      return true;
+    }
+  }
+
+  value = p.back().value;
+  return true;
+}
+
+void ParameterAutomation::ApplyInitialValues(){
+  for(int ii=0; ii<HOST_PARAMETERS; ii++){
+    float value;
+    if(GetParameterValue(ii, 0.0, value)){
+      Patch::setHostParameterValue((PatchParameterId)ii, value);
+    }
+  }
+}
+
+void ParameterAutomation::ApplyBlock(Patch* patch, long blockStart, int blockSize, float sampleRate){
+  double time = blockStart/(double)sampleRate;
+
+  // parameters update at block rate like on the device
+  for(int ii=0; ii<HOST_PARAMETERS; ii++){
+    float value;
+    if(GetParameterValue(ii, time, value)){
+      patch->setParameterValue((PatchParameterId)ii, value);
+    }
+  }
+
+  // button events carry their sample offset within the block
+  for(size_t ii=0; ii<buttons.size(); ii++){
+    long sample = (long)(buttons[ii].time*sampleRate + 0.5);
+    if(sample >= blockStart && sample < blockStart + blockSize){
+      patch->buttonChanged(buttons[ii].button, buttons[ii].value ? 4095 : 0, (uint16_t)(sample - blockStart));
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __hostautomationh__
+#define __hostautomationh__
+
+#include <vector>
+#include "Patch.h"
+
+// scripted parameter automation and button events for the offline host
+//
+// one event per line, '#' starts a comment, times are in seconds:
+//   <time> <A..H> <value> [ramp]     set parameter, or ramp linearly to
+//                                    value from the previous point
+//   <time> button <A..D|PUSH> <0|1>  button state change
+class ParameterAutomation{
+public:
+  ParameterAutomation();
+
+  // load automation script, returns false on parse error
+  bool Load(const char* path);
+
+  // add parameter point from the command line
+  void AddParameterPoint(PatchParameterId pid, double time, float value, bool ramp);
+
+  // add button event
+  void AddButtonEvent(PatchButtonId bid, double time, int value);
+
+  // set the parameter values at time zero as the knob positions that the
+  // next constructed patch starts from
+  void ApplyInitialValues();
+
+  // apply parameter values and button events for the block
+  // starting at sample index blockStart
+  void ApplyBlock(Patch* patch, long blockStart, int blockSize, float sampleRate);
+
+private:
+  struct AutomationPoint {
+    double time;
+    float value;
+    bool ramp;
+  };
+
+  struct ButtonEvent {
+    double time;
+    PatchButtonId button;
+    int value;
+  };
+
+  // evaluate parameter curve at time
+  bool GetParameterValue(int pid, double time, float &value);
+
+  std::vector<AutomationPoint> points[HOST_PARAMETERS];
+  std::vector<ButtonEvent> buttons;
+};
+
+#endif
@@ -0,0 +1,917 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// filter benchmark
+//
+// measures SVFilter, Ladder, SKFilter and IIRLowpass throughput over every
+// integration method, oversampling factor and a set of representative
+// cutoff/resonance settings. results are reported as ns/sample,
+// cycles/sample and as percentage of the real-time budget at 48 kHz for
+// the OWL block sizes, including the once per block parameter updates
+// the patches do. voice banks are reported per voice
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCHMARK_HAVE_TSC 1
+#else
+#define BENCHMARK_HAVE_TSC 0
+#endif
+
+#include "signals.h"
+
+#include "svfilter.h"
+#include "svfilterbank.h"
+#include "ladderbank.h"
+#include "skfilterbank.h"
+#include "ladder.h"
+#include "sallenkey.h"
+#include "iir.h"
+#include "delayline.h"
+#include "fastmath.h"
+#include "simdmath.h"
+
+// real-time budget reference
+#define BENCHMARK_SAMPLERATE 48000.f
+
+// number of block sizes measured
+#define BENCHMARK_BLOCK_SIZES 4
+
+static const int blockSizes[BENCHMARK_BLOCK_SIZES] = {32, 64, 128, 256};
+static const int oversamplingFactors[] = {1, 2, 4, 8};
+static const float cutoffs[] = {0.05f, 0.3f, 1.0f};
+static const float resonances[] = {0.2f, 0.9f};
+
+// oversampling resampler of the scalar filters
+static ResamplerType benchmarkResampler = RESAMPLER_IIR;
+
+// nonlinearity approximants of the filters
+static FastmathApproximation benchmarkApproximation = FASTMATH_PADE;
+
+// newton update rule of the implicit integrators
+static NewtonStep benchmarkNewtonStep = NEWTON_PLAIN;
+
+// antiderivative antialiasing of the ladder and SVF nonlinearities
+static bool benchmarkAntialiasing = false;
+
+// audio rate cutoff modulation of the filters
+static bool benchmarkModulation = false;
+
+// lowpass, bandpass and highpass taps of the SVF and ladder in one pass
+static bool benchmarkTaps = false;
+
+// voices of the filter banks, 2 is a stereo patch
+static int benchmarkVoices = 2*SIMD_WIDTH;
+
+// sample storage of the delay line
+static DelayStorageFormat benchmarkStorage = DELAY_STORAGE_FLOAT32;
+
+// fractional delay interpolation of the delay line
+static DelayInterpolation benchmarkInterpolation = DELAY_INTERPOLATION_LINEAR;
+
+// cutoff modulation shape, a 750 Hz sine swinging the cutoff by half
+// around the set value. periodic over the largest block
+#define BENCHMARK_MODULATION_FREQUENCY 750.f
+
+static float modulationShape[256];
+
+static void InitializeModulation(){
+  for(int i=0; i<256; i++){
+    modulationShape[i] = 1.f + 0.5f*sinf(2.f*M_PI*BENCHMARK_MODULATION_FREQUENCY/BENCHMARK_SAMPLERATE*i);
+  }
+}
+
+// per sample cutoff of one block
+static void ModulateCutoff(float* buffer, float cutoff, int n){
+  for(int i=0; i<n; i++){
+    buffer[i] = cutoff*modulationShape[i];
+  }
+}
+
+static const char* svfMethodNames[] = {
+  "SVF_SEMI_IMPLICIT_EULER",
+  "SVF_PREDICTOR_CORRECTOR",
+  "SVF_TRAPEZOIDAL",
+  "SVF_INV_TRAPEZOIDAL"
+};
+
+static const char* ladderMethodNames[] = {
+  "LADDER_EULER_FULL_TANH",
+  "LADDER_PREDICTOR_CORRECTOR_FULL_TANH",
+  "LADDER_PREDICTOR_CORRECTOR_FEEDBACK_TANH",
+  "LADDER_TRAPEZOIDAL_FEEDBACK_TANH"
+};
+
+static const char* skMethodNames[] = {
+  "SK_SEMI_IMPLICIT_EULER",
+  "SK_PREDICTOR_CORRECTOR",
+  "SK_TRAPEZOIDAL"
+};
+
+struct BenchmarkResult {
+  double nsPerSample[BENCHMARK_BLOCK_SIZES];
+  double cyclesPerSample[BENCHMARK_BLOCK_SIZES];
+};
+
+static inline unsigned long long ReadCycleCounter(){
+#if BENCHMARK_HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// filter drivers, one block with per block parameter update
+struct SVFDriver {
+  static const int voices = 1;
+  SVFilter f;
+  void Setup(int method, int oversampling){
+    f.SetFilterSampleRate(BENCHMARK_SAMPLERATE);
+    f.SetFilterOversamplingFactor(oversampling);
+    f.SetFilterIntegrationMethod((SVFIntegrationMethod)method);
+    f.SetFilterResampler(benchmarkResampler);
+    f.SetFilterApproximation(benchmarkApproximation);
+    f.SetFilterNewtonStep(benchmarkNewtonStep);
+    f.SetFilterAntialiasing(benchmarkAntialiasing);
+    f.SetFilterMode(SVF_LOWPASS_MODE);
+    f.SetFilterTaps(benchmarkTaps ? FILTER_TAP_BIT(FILTER_TAP_LOWPASS) | FILTER_TAP_BIT(FILTER_TAP_BANDPASS) |
+		    FILTER_TAP_BIT(FILTER_TAP_HIGHPASS) : 0);
+  }
+  float modulation[256];
+  float buffer[2][256];
+  void Process(const float* in, float* out, int n, float cutoff, float resonance){
+    float* taps[FILTER_TAPS] = {out, buffer[0], buffer[1], NULL};
+    f.SetFilterResonance(resonance);
+    if(benchmarkModulation){
+      ModulateCutoff(modulation, cutoff, n);
+    }
+    else{
+      f.SetFilterCutoff(cutoff);
+    }
+    if(benchmarkTaps){
+      f.ProcessBlockTaps(in, taps, n, benchmarkModulation ? modulation : NULL, NULL);
+    }
+    else{
+      f.ProcessBlock(in, out, n, benchmarkModulation ? modulation : NULL, NULL);
+    }
+  }
+};
+
+struct LadderDriver {
+  static const int voices = 1;
+  Ladder f;
+  void Setup(int method, int oversampling){
+    f.SetFilterSampleRate(BENCHMARK_SAMPLERATE);
+    f.SetFilterOversamplingFactor(oversampling);
+    f.SetFilterIntegrationMethod((LadderIntegrationMethod)method);
+    f.SetFilterResampler(benchmarkResampler);
+    f.SetFilterApproximation(benchmarkApproximation);
+    f.SetFilterNewtonStep(benchmarkNewtonStep);
+    f.SetFilterAntialiasing(benchmarkAntialiasing);
+    f.SetFilterMode(LADDER_LOWPASS_MODE);
+    f.SetFilterTaps(benchmarkTaps ? FILTER_TAP_BIT(FILTER_TAP_LOWPASS) | FILTER_TAP_BIT(FILTER_TAP_BANDPASS) |
+		    FILTER_TAP_BIT(FILTER_TAP_HIGHPASS) : 0);
+  }
+  float modulation[256];
+  float buffer[2][256];
+  void Process(const float* in, float* out, int n, float cutoff, float resonance){
+    float* taps[FILTER_TAPS] = {out, buffer[0], buffer[1], NULL};
+    f.SetFilterResonance(resonance);
+    if(benchmarkModulation){
+      ModulateCutoff(modulation, cutoff, n);
+    }
+    else{
+      f.SetFilterCutoff(cutoff);
+    }
+    if(benchmarkTaps){
+      f.ProcessBlockTaps(in, taps, n, benchmarkModulation ? modulation : NULL, NULL);
+    }
+    else{
+      f.ProcessBlock(in, out, n, benchmarkModulation ? modulation : NULL, NULL);
+    }
+  }
+};
+
+struct SKDriver {
+  static const int voices = 1;
+  SKFilter f;
+  void Setup(int method, int oversampling){
+    f.SetFilterSampleRate(BENCHMARK_SAMPLERATE);
+    f.SetFilterOversamplingFactor(oversampling);
+    f.SetFilterIntegrationMethod((SKIntegrationMethod)method);
+    f.SetFilterResampler(benchmarkResampler);
+    f.SetFilterApproximation(benchmarkApproximation);
+    f.SetFilterNewtonStep(benchmarkNewtonStep);
+    f.SetFilterMode(SK_LOWPASS_MODE);
+  }
+  float modulation[256];
+  void Process(const float* in, float* out, int n, float cutoff, float resonance){
+    f.SetFilterResonance(resonance);
+    if(benchmarkModulation){
+      ModulateCutoff(modulation, cutoff, n);
+      f.ProcessBlock(in, out, n, modulation, NULL);
+    }
+    else{
+      f.SetFilterCutoff(cutoff);
+      f.ProcessBlock(in, out, n);
+    }
+  }
+};
+
+// voice banks, timings are reported per voice. the voices share one
+// input and, with --modulation, one linked cutoff buffer
+#define BENCHMARK_MAX_VOICES 64
+
+struct SVFBankDriver {
+  int voices;
+  SVFilterBank f;
+  float modulation[256];
+  float buffer[BENCHMARK_MAX_VOICES][256];
+  SVFBankDriver() : voices(benchmarkVoices), f(benchmarkVoices) {}
+  void Setup(int method, int oversampling){
+    f.SetFilterSampleRate(BENCHMARK_SAMPLERATE);
+    f.SetFilterOversamplingFactor(oversampling);
+    f.SetFilterIntegrationMethod((SVFIntegrationMethod)method);
+    f.SetFilterApproximation(benchmarkApproximation);
+    f.SetFilterNewtonStep(benchmarkNewtonStep);
+    f.SetFilterAntialiasing(benchmarkAntialiasing);
+    f.SetFilterMode(SVF_LOWPASS_MODE);
+  }
+  void Process(const float* in, float* out, int n, float cutoff, float resonance){
+    const float* inputs[BENCHMARK_MAX_VOICES];
+    const float* cutoffs[BENCHMARK_MAX_VOICES];
+    float* outputs[BENCHMARK_MAX_VOICES];
+    if(benchmarkModulation){
+      ModulateCutoff(modulation, cutoff, n);
+    }
+    for(int v=0; v<voices; v++){
+      f.SetFilterCutoff(v, cutoff);
+      f.SetFilterResonance(v, resonance);
+      inputs[v] = in;
+      cutoffs[v] = modulation;
+      outputs[v] = v ? buffer[v] : out;
+    }
+    f.ProcessBlock(inputs, outputs, n, benchmarkModulation ? cutoffs : NULL, NULL);
+  }
+};
+
+struct LadderBankDriver {
+  int voices;
+  LadderBank f;
+  float modulation[256];
+  float buffer[BENCHMARK_MAX_VOICES][256];
+  LadderBankDriver() : voices(benchmarkVoices), f(benchmarkVoices) {}
+  void Setup(int method, int oversampling){
+    f.SetFilterSampleRate(BENCHMARK_SAMPLERATE);
+    f.SetFilterOversamplingFactor(oversampling);
+    f.SetFilterIntegrationMethod((LadderIntegrationMethod)method);
+    f.SetFilterApproximation(benchmarkApproximation);
+    f.SetFilterNewtonStep(benchmarkNewtonStep);
+    f.SetFilterAntialiasing(benchmarkAntialiasing);
+    f.SetFilterMode(LADDER_LOWPASS_MODE);
+  }
+  void Process(const float* in, float* out, int n, float cutoff, float resonance){
+    const float* inputs[BENCHMARK_MAX_VOICES];
+    const float* cutoffs[BENCHMARK_MAX_VOICES];
+    float* outputs[BENCHMARK_MAX_VOICES];
+    if(benchmarkModulation){
+      ModulateCutoff(modulation, cutoff, n);
+    }
+    for(int v=0; v<voices; v++){
+      f.SetFilterCutoff(v, cutoff);
+      f.SetFilterResonance(v, resonance);
+      inputs[v] = in;
+      cutoffs[v] = modulation;
+      outputs[v] = v ? buffer[v] : out;
+    }
+    f.ProcessBlock(inputs, outputs, n, benchmarkModulation ? cutoffs : NULL, NULL);
+  }
+};
+
+struct SKBankDriver {
+  int voices;
+  SKFilterBank f;
+  float modulation[256];
+  float buffer[BENCHMARK_MAX_VOICES][256];
+  SKBankDriver() : voices(benchmarkVoices), f(benchmarkVoices) {}
+  void Setup(int method, int oversampling){
+    f.SetFilterSampleRate(BENCHMARK_SAMPLERATE);
+    f.SetFilterOversamplingFactor(oversampling);
+    f.SetFilterIntegrationMethod((SKIntegrationMethod)method);
+    f.SetFilterApproximation(benchmarkApproximation);
+    f.SetFilterNewtonStep(benchmarkNewtonStep);
+    f.SetFilterMode(SK_LOWPASS_MODE);
+  }
+  void Process(const float* in, float* out, int n, float cutoff, float resonance){
+    const float* inputs[BENCHMARK_MAX_VOICES];
+    const float* cutoffs[BENCHMARK_MAX_VOICES];
+    float* outputs[BENCHMARK_MAX_VOICES];
+    if(benchmarkModulation){
+      ModulateCutoff(modulation, cutoff, n);
+    }
+    for(int v=0; v<voices; v++){
+      f.SetFilterCutoff(v, cutoff);
+      f.SetFilterResonance(v, resonance);
+      inputs[v] = in;
+      cutoffs[v] = modulation;
+      outputs[v] = v ? buffer[v] : out;
+    }
+    f.ProcessBlock(inputs, outputs, n, benchmarkModulation ? cutoffs : NULL, NULL);
+  }
+};
+
+struct IIRDriver {
+  static const int voices = 1;
+  IIRLowpass f;
+  void Setup(int order, int oversampling){
+    f.SetFilterOrder(order);
+    f.SetFilterSamplerate(BENCHMARK_SAMPLERATE*oversampling);
+    f.SetFilterCutoff(0.9f*BENCHMARK_SAMPLERATE/2.f);
+  }
+  void Process(const float* in, float* out, int n, float, float){
+    for(int i=0; i<n; i++){
+      out[i] = f.IIRfilter(in[i]);
+    }
+  }
+};
+
+struct IIRBlockDriver {
+  static const int voices = 1;
+  IIRLowpass f;
+  void Setup(int order, int oversampling){
+    f.SetFilterOrder(order);
+    f.SetFilterSamplerate(BENCHMARK_SAMPLERATE*oversampling);
+    f.SetFilterCutoff(0.9f*BENCHMARK_SAMPLERATE/2.f);
+  }
+  void Process(const float* in, float* out, int n, float, float){
+    for(int i=0; i<n; i++){
+      out[i] = in[i];
+    }
+    f.IIRfilterBlock(out, n);
+  }
+};
+
+// delay line with feedback over 2 seconds of buffer, the way the
+// DigiDelay patches run it
+struct DelayDriver {
+  static const int voices = 1;
+  DelayLine f;
+  float delay;
+  float head[256];
+  DelayDriver() : f(2*(int)(BENCHMARK_SAMPLERATE), benchmarkStorage) {}
+  void Setup(int delaySamples, int){
+    delay = (float)(delaySamples) + 0.25f;
+    f.SetDelayInterpolation(benchmarkInterpolation);
+  }
+  void Process(const float* in, float* out, int n, float, float){
+    int span = f.GetDelaySpan(delay);
+    for(int start=0; start<n; start+=span){
+      int m = n - start < span ? n - start : span;
+      f.ReadDelay(delay, out + start, m);
+      for(int i=0; i<m; i++){
+	head[i] = in[start + i] + 0.5f*out[start + i];
+      }
+      f.WriteDelay(head, m);
+    }
+  }
+};
+
+// four taps at a quarter of the delay apart mixed into a stereo pair,
+// the way the MultiTapDelay patch reads the buffer
+struct MultiTapDriver {
+  static const int voices = 1;
+  DelayLine f;
+  float delays[4];
+  float leftGains[4];
+  float rightGains[4];
+  float right[256];
+  float head[256];
+  MultiTapDriver() : f(2*(int)(BENCHMARK_SAMPLERATE), benchmarkStorage) {}
+  void Setup(int delaySamples, int){
+    for(int j=0; j<4; j++){
+      delays[j] = 0.25f*(float)(j + 1)*(float)(delaySamples) + 0.25f;
+      leftGains[j] = 0.1f*(float)(j + 1);
+      rightGains[j] = 0.1f*(float)(4 - j);
+    }
+    f.SetDelayInterpolation(benchmarkInterpolation);
+  }
+  void Process(const float* in, float* out, int n, float, float){
+    int span = f.GetDelaySpan(delays[0]);
+    for(int start=0; start<n; start+=span){
+      int m = n - start < span ? n - start : span;
+      f.MixDelayTaps(4, delays, leftGains, rightGains, out + start, right, m);
+      for(int i=0; i<m; i++){
+	head[i] = in[start + i] + 0.25f*(out[start + i] + right[i]);
+      }
+      f.WriteDelay(head, m);
+    }
+  }
+};
+
+// keeps the optimizer from discarding filter output
+static volatile float benchmarkSink;
+
+// approximant table, evaluation points per function and timed passes
+#define FASTMATH_POINTS 4096
+#define FASTMATH_PASSES 256
+
+template <float (*f)(float)> static void ScalarApply(const float* in, float* out, int n){
+  for(int i=0; i<n; i++){
+    out[i] = f(in[i]);
+  }
+}
+
+// derivative of asinh has no library function
+static float dASinhStd(float x){
+  return 1.f/sqrtf(1.f + x*x);
+}
+
+static double TanhReference(double x){ return tanh(x); }
+static double SinhReference(double x){ return sinh(x); }
+static double CoshReference(double x){ return cosh(x); }
+static double ASinhReference(double x){ return asinh(x); }
+static double dASinhReference(double x){ return 1.0/sqrt(1.0 + x*x); }
+
+struct FastmathEntry {
+  const char* name;
+  void (*scalar)(const float* in, float* out, int n);
+  void (*simd)(const float* in, float* out, int n);
+  void (*library)(const float* in, float* out, int n);
+  double (*reference)(double x);
+  float lo, hi;
+};
+
+#define FASTMATH_ENTRY(f, library, reference, lo, hi) \
+  {#f, ScalarApply<f>, SIMDApplyBlock<f>, ScalarApply<library>, reference, lo, hi}
+
+// approximants over the input ranges the filters use
+static const FastmathEntry fastmathTable[] = {
+  FASTMATH_ENTRY(TanhPade32, tanhf, TanhReference, -3.f, 3.f),
+  FASTMATH_ENTRY(TanhPade54, tanhf, TanhReference, -4.f, 4.f),
+  FASTMATH_ENTRY(SinhPade32, sinhf, SinhReference, -3.f, 3.f),
+  FASTMATH_ENTRY(SinhPade34, sinhf, SinhReference, -3.f, 3.f),
+  FASTMATH_ENTRY(SinhPade54, sinhf, SinhReference, -3.f, 3.f),
+  FASTMATH_ENTRY(SinhPade98, sinhf, SinhReference, -3.f, 3.f),
+  FASTMATH_ENTRY(CoshPade32, coshf, CoshReference, -3.f, 3.f),
+  FASTMATH_ENTRY(CoshPade34, coshf, CoshReference, -3.f, 3.f),
+  FASTMATH_ENTRY(CoshPade54, coshf, CoshReference, -3.f, 3.f),
+  FASTMATH_ENTRY(ASinhPade54, asinhf, ASinhReference, -4.f, 4.f),
+  FASTMATH_ENTRY(ASinhPade98, asinhf, ASinhReference, -4.f, 4.f),
+  FASTMATH_ENTRY(dASinhPade54, dASinhStd, dASinhReference, -4.f, 4.f),
+  FASTMATH_ENTRY(TanhMinimax, tanhf, TanhReference, -3.f, 3.f),
+  FASTMATH_ENTRY(SinhMinimax, sinhf, SinhReference, -4.f, 4.f),
+  FASTMATH_ENTRY(CoshMinimax, coshf, CoshReference, -4.f, 4.f),
+  FASTMATH_ENTRY(ASinhMinimax, asinhf, ASinhReference, -4.f, 4.f),
+  FASTMATH_ENTRY(dASinhMinimax, dASinhStd, dASinhReference, -4.f, 4.f)
+};
+
+// ns per value of a batch function over the evaluation points
+static double TimeApproximant(void (*f)(const float* in, float* out, int n), const float* in, float* out){
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+  for(int ii=0; ii<FASTMATH_PASSES; ii++){
+    f(in, out, FASTMATH_POINTS);
+    benchmarkSink = out[ii % FASTMATH_POINTS];
+  }
+
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(t1 - t0).count()/((double)FASTMATH_PASSES*FASTMATH_POINTS);
+}
+
+// accuracy against double precision and throughput against the float
+// library function, scalar and SIMD_WIDTH lanes at a time
+static void RunFastmath(bool csv){
+  std::vector<float> in(FASTMATH_POINTS);
+  std::vector<float> out(FASTMATH_POINTS);
+
+  if(csv){
+    printf("function,lo,hi,max_abs_error,max_rel_error,library_ns,scalar_ns,simd_ns\n");
+  }
+  else{
+    printf("# max error against double precision, ns per value of float library, scalar and %d lane SIMD evaluation\n", SIMD_WIDTH);
+    printf("%-14s %12s %10s %10s %10s %10s %10s\n", "function", "range", "abs err", "rel err", "lib ns", "scalar ns", "simd ns");
+  }
+
+  for(unsigned int e=0; e<sizeof(fastmathTable)/sizeof(fastmathTable[0]); e++){
+    const FastmathEntry &f = fastmathTable[e];
+
+    for(int i=0; i<FASTMATH_POINTS; i++){
+      in[i] = f.lo + (f.hi - f.lo)*i/(float)(FASTMATH_POINTS - 1);
+    }
+
+    // worst case error over the range
+    double absError = 0.0;
+    double relError = 0.0;
+
+    f.simd(in.data(), out.data(), FASTMATH_POINTS);
+    for(int i=0; i<FASTMATH_POINTS; i++){
+      double r = f.reference(in[i]);
+      double error = fabs(out[i] - r);
+
+      absError = error > absError ? error : absError;
+      if(r != 0.0 && error/fabs(r) > relError){
+	relError = error/fabs(r);
+      }
+    }
+
+    double libraryNs = TimeApproximant(f.library, in.data(), out.data());
+    double scalarNs = TimeApproximant(f.scalar, in.data(), out.data());
+    double simdNs = TimeApproximant(f.simd, in.data(), out.data());
+
+    if(csv){
+      printf("%s,%g,%g,%.3g,%.3g,%.3f,%.3f,%.3f\n", f.name, f.lo, f.hi, absError, relError, libraryNs, scalarNs, simdNs);
+    }
+    else{
+      printf("%-14s %5.1f..%-5.1f %10.2e %10.2e %10.3f %10.3f %10.3f\n", f.name, f.lo, f.hi, absError, relError,
+	     libraryNs, scalarNs, simdNs);
+    }
+    fflush(stdout);
+  }
+}
+
+// lane bits of the comparison masks against the lanes compared one at
+// a time, over every pattern of lanes below and above a threshold.
+// returns the number of mismatching patterns
+static int RunSIMDCheck(){
+  int failures = 0;
+
+  for(int pattern=0; pattern < (1 << SIMD_WIDTH); pattern++){
+    float a[SIMD_WIDTH];
+    float b[SIMD_WIDTH];
+    int expected = 0;
+
+    for(int l=0; l<SIMD_WIDTH; l++){
+      a[l] = (pattern >> l) & 1 ? -1.f - l : 1.f + l;
+      b[l] = 0.5f*l - 0.25f;
+      expected |= (a[l] < b[l]) << l;
+    }
+
+    SIMDMask mask = SIMDLess(SIMDLoad(a), SIMDLoad(b));
+    int bits = SIMDMaskBits(mask);
+    int inverse = SIMDMaskBits(SIMDGreaterEqual(SIMDLoad(a), SIMDLoad(b)));
+
+    if(bits != expected || inverse != (~expected & ((1 << SIMD_WIDTH) - 1)) ||
+       SIMDAnyTrue(mask) != (expected != 0)){
+      printf("mask bits %#x, inverse %#x, expected %#x\n", bits, inverse, expected);
+      failures++;
+    }
+  }
+
+  printf("%d lane mask patterns, %d failed\n", 1 << SIMD_WIDTH, failures);
+
+  return failures;
+}
+
+template <class D> static BenchmarkResult RunBenchmark(int method, int oversampling, float cutoff, float resonance,
+						       const std::vector<float> &input){
+  BenchmarkResult result;
+  std::vector<float> output(blockSizes[BENCHMARK_BLOCK_SIZES-1]);
+  int samples = input.size();
+
+  for(int b=0; b<BENCHMARK_BLOCK_SIZES; b++){
+    int blockSize = blockSizes[b];
+    int blocks = samples/blockSize;
+    D* driver = new D();
+
+    driver->Setup(method, oversampling);
+
+    // warm up caches and filter state
+    for(int ii=0; ii<blocks/8 + 1; ii++){
+      driver->Process(&input[ii*blockSize], output.data(), blockSize, cutoff, resonance);
+    }
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    unsigned long long c0 = ReadCycleCounter();
+
+    for(int ii=0; ii<blocks; ii++){
+      driver->Process(&input[ii*blockSize], output.data(), blockSize, cutoff, resonance);
+      benchmarkSink = output[blockSize-1];
+    }
+
+    unsigned long long c1 = ReadCycleCounter();
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    double n = (double)blocks*blockSize*driver->voices;
+    result.nsPerSample[b] = std::chrono::duration<double, std::nano>(t1 - t0).count()/n;
+    result.cyclesPerSample[b] = (double)(c1 - c0)/n;
+
+    delete driver;
+  }
+
+  return result;
+}
+
+static void PrintHeader(bool csv){
+  if(csv){
+    printf("filter,method,oversampling,cutoff,resonance,ns_per_sample,cycles_per_sample");
+    for(int b=0; b<BENCHMARK_BLOCK_SIZES; b++){
+      printf(",budget_%d", blockSizes[b]);
+    }
+    printf("\n");
+  }
+  else{
+    printf("%-8s %-42s %3s %6s %5s %9s %9s", "filter", "method", "os", "cutoff", "reso", "ns/smp", "cyc/smp");
+    for(int b=0; b<BENCHMARK_BLOCK_SIZES; b++){
+      printf("   %%rt@%-3d", blockSizes[b]);
+    }
+    printf("\n");
+  }
+}
+
+static void PrintResult(bool csv, const char* filter, const char* method, int oversampling,
+			float cutoff, float resonance, const BenchmarkResult &r){
+  // report per sample figures at the default OWL block size
+  int reference = 1;
+
+  // share of the per sample real-time budget at 48 kHz
+  double budget = 1.0e9/BENCHMARK_SAMPLERATE;
+
+  if(csv){
+    printf("%s,%s,%d,%g,%g,%.2f,%.1f", filter, method, oversampling, cutoff, resonance,
+	   r.nsPerSample[reference], r.cyclesPerSample[reference]);
+    for(int b=0; b<BENCHMARK_BLOCK_SIZES; b++){
+      printf(",%.3f", 100.0*r.nsPerSample[b]/budget);
+    }
+    printf("\n");
+  }
+  else{
+    printf("%-8s %-42s %3d %6.3f %5.2f %9.2f", filter, method, oversampling, cutoff, resonance,
+	   r.nsPerSample[reference]);
+    if(BENCHMARK_HAVE_TSC){
+      printf(" %9.1f", r.cyclesPerSample[reference]);
+    }
+    else{
+      printf(" %9s", "-");
+    }
+    for(int b=0; b<BENCHMARK_BLOCK_SIZES; b++){
+      printf(" %9.3f", 100.0*r.nsPerSample[b]/budget);
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+template <class D> static void SweepFilter(bool csv, const char* filter, const char** methodNames, int methods,
+					   const std::vector<float> &input){
+  for(int m=0; m<methods; m++){
+    for(unsigned int o=0; o<sizeof(oversamplingFactors)/sizeof(int); o++){
+      for(unsigned int c=0; c<sizeof(cutoffs)/sizeof(float); c++){
+	for(unsigned int r=0; r<sizeof(resonances)/sizeof(float); r++){
+	  BenchmarkResult result = RunBenchmark<D>(m, oversamplingFactors[o], cutoffs[c], resonances[r], input);
+	  PrintResult(csv, filter, methodNames[m], oversamplingFactors[o], cutoffs[c], resonances[r], result);
+	}
+      }
+    }
+  }
+}
+
+static void PrintUsage(const char* name){
+  fprintf(stderr,
+	  "usage: %s [options]\n"
+	  "  --filter <SVF|LADDER|SK|IIR|IIRBLOCK|SVFBANK|LADDERBANK|SKBANK|DELAY|MULTITAP>\n"
+	  "                                benchmark one filter only, IIR includes the\n"
+	  "                                IIRBLOCK rows and DELAY the MULTITAP rows\n"
+	  "  --samples <n>                 samples per measurement (default 48000)\n"
+	  "  --signal <spec>               input signal (default saw:110)\n"
+	  "  --resampler <iir|halfband>    scalar filter resampler (default iir)\n"
+	  "  --approximation <pade|minimax>\n"
+	  "                                filter nonlinearities (default pade)\n"
+	  "  --newton-step <plain|damped|halley>\n"
+	  "                                newton update rule (default plain)\n"
+	  "  --antialiasing                antiderivative antialiased ladder and SVF\n"
+	  "  --modulation                  audio rate cutoff modulation\n"
+	  "  --voices <n>                  voices of the filter banks (default 2*SIMD_WIDTH)\n"
+	  "  --taps                        lowpass, bandpass and highpass SVF and ladder taps\n"
+	  "  --storage <float32|int16|float16>\n"
+	  "                                delay line sample storage (default float32)\n"
+	  "  --interpolation <linear|hermite|lagrange>\n"
+	  "                                delay line interpolation (default linear)\n"
+	  "  --fastmath                    approximant accuracy and throughput table\n"
+	  "  --simd                        check the SIMD lane masks and exit\n"
+	  "  --csv                         comma separated output\n", name);
+}
+
+int main(int argc, char** argv){
+  const char* only = NULL;
+  const char* signalSpec = "saw:110";
+  int samples = 48000;
+  bool csv = false;
+  bool fastmath = false;
+  bool simd = false;
+
+  for(int ii=1; ii<argc; ii++){
+    if(!strcmp(argv[ii], "--csv")){
+      csv = true;
+    }
+    else if(!strcmp(argv[ii], "--fastmath")){
+      fastmath = true;
+    }
+    else if(!strcmp(argv[ii], "--simd")){
+      simd = true;
+    }
+    else if(!strcmp(argv[ii], "--antialiasing")){
+      benchmarkAntialiasing = true;
+    }
+    else if(!strcmp(argv[ii], "--modulation")){
+      benchmarkModulation = true;
+    }
+    else if(!strcmp(argv[ii], "--taps")){
+      benchmarkTaps = true;
+    }
+    else if(!strcmp(argv[ii], "--filter") && ii + 1 < argc){
+      only = argv[++ii];
+    }
+    else if(!strcmp(argv[ii], "--voices") && ii + 1 < argc){
+      benchmarkVoices = atoi(argv[++ii]);
+      if(benchmarkVoices < 1 || benchmarkVoices > BENCHMARK_MAX_VOICES){
+	PrintUsage(argv[0]);
+	return 1;
+      }
+    }
+    else if(!strcmp(argv[ii], "--samples") && ii + 1 < argc){
+      samples = atoi(argv[++ii]);
+    }
+    else if(!strcmp(argv[ii], "--signal") && ii + 1 < argc){
+      signalSpec = argv[++ii];
+    }
+    else if(!strcmp(argv[ii], "--approximation") && ii + 1 < argc){
+      ii++;
+      if(!strcmp(argv[ii], "minimax")){
+	benchmarkApproximation = FASTMATH_MINIMAX;
+      }
+      else if(strcmp(argv[ii], "pade")){
+	PrintUsage(argv[0]);
+	return 1;
+      }
+    }
+    else if(!strcmp(argv[ii], "--newton-step") && ii + 1 < argc){
+      ii++;
+      if(!strcmp(argv[ii], "damped")){
+	benchmarkNewtonStep = NEWTON_DAMPED;
+      }
+      else if(!strcmp(argv[ii], "halley")){
+	benchmarkNewtonStep = NEWTON_HALLEY;
+      }
+      else if(strcmp(argv[ii], "plain")){
+	PrintUsage(argv[0]);
+	return 1;
+      }
+    }
+    else if(!strcmp(argv[ii], "--storage") && ii + 1 < argc){
+      ii++;
+      if(!strcmp(argv[ii], "int16")){
+	benchmarkStorage = DELAY_STORAGE_INT16;
+      }
+      else if(!strcmp(argv[ii], "float16")){
+	benchmarkStorage = DELAY_STORAGE_FLOAT16;
+      }
+      else if(strcmp(argv[ii], "float32")){
+	PrintUsage(argv[0]);
+	return 1;
+      }
+    }
+    else if(!strcmp(argv[ii], "--interpolation") && ii + 1 < argc){
+      ii++;
+      if(!strcmp(argv[ii], "hermite")){
+	benchmarkInterpolation = DELAY_INTERPOLATION_HERMITE;
+      }
+      else if(!strcmp(argv[ii], "lagrange")){
+	benchmarkInterpolation = DELAY_INTERPOLATION_LAGRANGE;
+      }
+      else if(strcmp(argv[ii], "linear")){
+	PrintUsage(argv[0]);
+	return 1;
+      }
+    }
+    else if(!strcmp(argv[ii], "--resampler") && ii + 1 < argc){
+      ii++;
+      if(!strcmp(argv[ii], "halfband")){
+	benchmarkResampler = RESAMPLER_HALFBAND;
+      }
+      else if(strcmp(argv[ii], "iir")){
+	PrintUsage(argv[0]);
+	return 1;
+      }
+    }
+    else{
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if(simd){
+    return RunSIMDCheck() ? 1 : 0;
+  }
+
+  if(fastmath){
+    RunFastmath(csv);
+    return 0;
+  }
+
+  InitializeModulation();
+
+  if(samples < blockSizes[BENCHMARK_BLOCK_SIZES-1]){
+    samples = blockSizes[BENCHMARK_BLOCK_SIZES-1];
+  }
+
+  std::vector<float> input(samples);
+  if(!GenerateSignal(signalSpec, input.data(), samples, BENCHMARK_SAMPLERATE, 0.5f)){
+    fprintf(stderr, "unknown signal: %s\n", signalSpec);
+    return 1;
+  }
+
+  if(!csv){
+    printf("# ns and cycles per sample at block size %d, %%rt is share of the 48 kHz real-time budget\n", blockSizes[1]);
+    if(BENCHMARK_HAVE_TSC){
+      printf("# cycles are time stamp counter ticks\n");
+    }
+  }
+  PrintHeader(csv);
+
+  if(!only || !strcmp(only, "SVF")){
+    SweepFilter<SVFDriver>(csv, "SVF", svfMethodNames, 4, input);
+  }
+  if(!only || !strcmp(only, "LADDER")){
+    SweepFilter<LadderDriver>(csv, "LADDER", ladderMethodNames, 4, input);
+  }
+  if(!only || !strcmp(only, "SK")){
+    SweepFilter<SKDriver>(csv, "SK", skMethodNames, 3, input);
+  }
+  if(!only || !strcmp(only, "SVFBANK")){
+    SweepFilter<SVFBankDriver>(csv, "SVFBANK", svfMethodNames, 4, input);
+  }
+  if(!only || !strcmp(only, "LADDERBANK")){
+    SweepFilter<LadderBankDriver>(csv, "LADDERBANK", ladderMethodNames, 4, input);
+  }
+  if(!only || !strcmp(only, "SKBANK")){
+    SweepFilter<SKBankDriver>(csv, "SKBANK", skMethodNames, 3, input);
+  }
+  // IIR and DELAY include the IIRBLOCK and MULTITAP rows, which can be
+  // selected on their own
+  bool iir = !only || !strcmp(only, "IIR");
+  bool iirBlock = iir || !strcmp(only, "IIRBLOCK");
+  bool delay = !only || !strcmp(only, "DELAY");
+  bool multiTap = delay || !strcmp(only, "MULTITAP");
+
+  if(iir || iirBlock){
+    // decimator orders used by the filters, at the oversampled rates
+    static const char* iirNames[] = {"IIR_ORDER_8", "IIR_ORDER_16"};
+    static const int iirOrders[] = {8, 16};
+
+    for(int m=0; m<2; m++){
+      for(unsigned int o=1; o<sizeof(oversamplingFactors)/sizeof(int); o++){
+	if(iir){
+	  BenchmarkResult result = RunBenchmark<IIRDriver>(iirOrders[m], oversamplingFactors[o], 0.f, 0.f, input);
+	  PrintResult(csv, "IIR", iirNames[m], oversamplingFactors[o], 0.f, 0.f, result);
+	}
+
+	BenchmarkResult result = RunBenchmark<IIRBlockDriver>(iirOrders[m], oversamplingFactors[o], 0.f, 0.f, input);
+	PrintResult(csv, "IIRBLOCK", iirNames[m], oversamplingFactors[o], 0.f, 0.f, result);
+      }
+    }
+  }
+  if(delay || multiTap){
+    // delays inside one block, of a few blocks and of the whole buffer
+    static const char* delayNames[] = {"DELAY_20_SAMPLES", "DELAY_100_MS", "DELAY_2_S"};
+    static const int delays[] = {20, 4800, 2*(int)(BENCHMARK_SAMPLERATE) - 1};
+
+    for(int m=0; m<3 && delay; m++){
+      BenchmarkResult result = RunBenchmark<DelayDriver>(delays[m], 1, 0.f, 0.f, input);
+      PrintResult(csv, "DELAY", delayNames[m], 1, 0.f, 0.f, result);
+    }
+
+    // four stereo taps of one buffer up to the same delays
+    static const char* multiTapNames[] = {"MULTITAP_4_20_SAMPLES", "MULTITAP_4_100_MS", "MULTITAP_4_2_S"};
+    for(int m=0; m<3; m++){
+      BenchmarkResult result = RunBenchmark<MultiTapDriver>(delays[m], 1, 0.f, 0.f, input);
+      PrintResult(csv, "DELAY", multiTapNames[m], 1, 0.f, 0.f, result);
+    }
+  }
+
+  return 0;
+}
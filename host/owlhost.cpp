@@ -0,0 +1,427 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// offline host for the OWL patches
+//
+// drives a patch's processAudio() block by block from a wav file or a
+// generated test signal, with optional scripted parameter automation,
+// and writes the result to a 32 bit float wav file
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+#include "Patch.h"
+#include "wavfile.h"
+#include "signals.h"
+#include "automation.h"
+
+#include "SVFPatch.hpp"
+#include "LADRPatch.hpp"
+#include "SKFPatch.hpp"
+#include "DigiDelayPatch.hpp"
+#include "DigiDelayClockedPatch.hpp"
+#include "MultiTapDelayPatch.hpp"
+
+template <class P> static Patch* CreatePatch(){
+  return new P();
+}
+
+// turn on the solver statistics of a filter patch
+template <class P> static NewtonStatistics* EnableNewtonStatistics(Patch* patch){
+  P* p = static_cast<P*>(patch);
+  p->setNewtonStatistics(true);
+  return p->getNewtonStatistics();
+}
+
+// select the nonlinearity approximants of a filter patch
+template <class P> static void SetApproximation(Patch* patch, FastmathApproximation approximation){
+  static_cast<P*>(patch)->setApproximation(approximation);
+}
+
+// select the newton update rule of a filter patch
+template <class P> static void SetNewtonStep(Patch* patch, NewtonStep step){
+  static_cast<P*>(patch)->setNewtonStep(step);
+}
+
+// turn on antiderivative antialiasing of a filter patch
+template <class P> static void EnableAntialiasing(Patch* patch){
+  static_cast<P*>(patch)->setAntialiasing(true);
+}
+
+struct PatchEntry {
+  const char* name;
+  Patch* (*create)();
+  NewtonStatistics* (*newtonStatistics)(Patch* patch);
+  void (*approximation)(Patch* patch, FastmathApproximation approximation);
+  void (*newtonStep)(Patch* patch, NewtonStep step);
+  void (*antialiasing)(Patch* patch);
+};
+
+static const PatchEntry patchTable[] = {
+  {"SVF", CreatePatch<SVFPatch>, EnableNewtonStatistics<SVFPatch>, SetApproximation<SVFPatch>, SetNewtonStep<SVFPatch>, EnableAntialiasing<SVFPatch>},
+  {"LADR", CreatePatch<LADRPatch>, EnableNewtonStatistics<LADRPatch>, SetApproximation<LADRPatch>, SetNewtonStep<LADRPatch>, EnableAntialiasing<LADRPatch>},
+  {"SKF", CreatePatch<SKFPatch>, EnableNewtonStatistics<SKFPatch>, SetApproximation<SKFPatch>, SetNewtonStep<SKFPatch>, NULL},
+  {"DigiDelay", CreatePatch<DigiDelayPatch>, NULL, NULL, NULL, NULL},
+  {"DigiDelayClocked", CreatePatch<DigiDelayClockedPatch>, NULL, NULL, NULL, NULL},
+  {"MultiTapDelay", CreatePatch<MultiTapDelayPatch>, NULL, NULL, NULL, NULL}
+};
+
+static const int numPatches = sizeof(patchTable)/sizeof(patchTable[0]);
+
+static void PrintUsage(const char* name){
+  fprintf(stderr,
+	  "usage: %s --patch <name> (--input <in.wav> | --signal <spec>) [options]\n"
+	  "  --output <out.wav>     write processed audio\n"
+	  "  --signal <spec>        sine:<hz> saw:<hz> square:<hz> sweep:<hz0>:<hz1>\n"
+	  "                         noise impulse:<seconds> silence\n"
+	  "  --duration <seconds>   length of generated signal (default 2)\n"
+	  "  --amplitude <gain>     level of generated signal (default 0.5)\n"
+	  "  --samplerate <hz>      host samplerate for generated signals (default 48000)\n"
+	  "  --blocksize <samples>  host block size (default 64)\n"
+	  "  --channels <n>         host channel count (default 2)\n"
+	  "  --param <A..H>=<value> set parameter at time zero\n"
+	  "  --automation <file>    parameter and button automation script\n"
+	  "  --newton-stats         report newton solver convergence of filter patches\n"
+	  "  --approximation <pade|minimax>\n"
+	  "                         nonlinearity approximants of filter patches (default pade)\n"
+	  "  --newton-step <plain|damped|halley>\n"
+	  "                         newton update rule of filter patches (default plain)\n"
+	  "  --antialiasing         antiderivative antialiased ladder and SVF patches\n"
+	  "  --compare <ref.wav>    fail if the output differs from a reference render\n"
+	  "  --tolerance <level>    largest sample difference --compare accepts (default 0)\n"
+	  "patches:", name);
+
+  for(int ii=0; ii<numPatches; ii++){
+    fprintf(stderr, " %s", patchTable[ii].name);
+  }
+  fprintf(stderr, "\n");
+}
+
+static void PrintNewtonStatistics(const NewtonStatistics* stats){
+  fprintf(stderr, "newton: %ld solves, %ld not converged, max residual %g\n",
+	  stats->solves, stats->failures, stats->maxResidual);
+
+  if(stats->solves == 0){
+    return;
+  }
+
+  fprintf(stderr, "  steps     solves   share\n");
+  for(int ii=0; ii<=NEWTON_MAX_ITERATIONS; ii++){
+    fprintf(stderr, "  %5d %10ld %6.2f%%\n", ii, stats->histogram[ii],
+	    100.0*stats->histogram[ii]/stats->solves);
+  }
+}
+
+// compare a render against a reference wav file, reports the largest
+// sample difference and fails when it exceeds the tolerance
+static bool CompareWavFile(const char* path, const std::vector<float> &output, int channels, float tolerance){
+  std::vector<float> reference;
+  int referenceChannels;
+  float referenceRate;
+
+  if(!ReadWavFile(path, reference, referenceChannels, referenceRate)){
+    fprintf(stderr, "cannot read wav file: %s\n", path);
+    return false;
+  }
+  if(referenceChannels != channels || reference.size() != output.size()){
+    fprintf(stderr, "compare: %s has a different length or channel count\n", path);
+    return false;
+  }
+
+  float difference = 0.f;
+  for(size_t ii=0; ii<output.size(); ii++){
+    float d = fabsf(output[ii] - reference[ii]);
+
+    // nan in either render is a mismatch
+    if(d != d){
+      d = INFINITY;
+    }
+    if(d > difference){
+      difference = d;
+    }
+  }
+
+  fprintf(stderr, "compare: max difference %g to %s\n", difference, path);
+  return difference <= tolerance;
+}
+
+int main(int argc, char** argv){
+  const char* patchName = NULL;
+  const char* inputPath = NULL;
+  const char* outputPath = NULL;
+  const char* signalSpec = NULL;
+  const char* automationPath = NULL;
+  const char* comparePath = NULL;
+  float tolerance = 0.f;
+  float duration = 2.f;
+  float amplitude = 0.5f;
+  float sampleRate = 48000.f;
+  int blockSize = 64;
+  int channels = 2;
+  bool newtonReport = false;
+  FastmathApproximation approximation = FASTMATH_PADE;
+  NewtonStep newtonStep = NEWTON_PLAIN;
+  bool antialiasing = false;
+
+  ParameterAutomation automation;
+
+  // parse arguments
+  for(int ii=1; ii<argc; ii++){
+    const char* arg = argv[ii];
+    const char* value = ii + 1 < argc ? argv[ii+1] : NULL;
+
+    if(!strcmp(arg, "--help")){
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    if(!strcmp(arg, "--newton-stats")){
+      newtonReport = true;
+      continue;
+    }
+    if(!strcmp(arg, "--antialiasing")){
+      antialiasing = true;
+      continue;
+    }
+    if(!value){
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    ii++;
+
+    if(!strcmp(arg, "--patch")){
+      patchName = value;
+    }
+    else if(!strcmp(arg, "--input")){
+      inputPath = value;
+    }
+    else if(!strcmp(arg, "--output")){
+      outputPath = value;
+    }
+    else if(!strcmp(arg, "--signal")){
+      signalSpec = value;
+    }
+    else if(!strcmp(arg, "--automation")){
+      automationPath = value;
+    }
+    else if(!strcmp(arg, "--compare")){
+      comparePath = value;
+    }
+    else if(!strcmp(arg, "--tolerance")){
+      tolerance = atof(value);
+    }
+    else if(!strcmp(arg, "--duration")){
+      duration = atof(value);
+    }
+    else if(!strcmp(arg, "--amplitude")){
+      amplitude = atof(value);
+    }
+    else if(!strcmp(arg, "--samplerate")){
+      sampleRate = atof(value);
+    }
+    else if(!strcmp(arg, "--blocksize")){
+      blockSize = atoi(value);
+    }
+    else if(!strcmp(arg, "--channels")){
+      channels = atoi(value);
+    }
+    else if(!strcmp(arg, "--approximation")){
+      if(!strcmp(value, "minimax")){
+	approximation = FASTMATH_MINIMAX;
+      }
+      else if(strcmp(value, "pade")){
+	PrintUsage(argv[0]);
+	return 1;
+      }
+    }
+    else if(!strcmp(arg, "--newton-step")){
+      if(!strcmp(value, "damped")){
+	newtonStep = NEWTON_DAMPED;
+      }
+      else if(!strcmp(value, "halley")){
+	newtonStep = NEWTON_HALLEY;
+      }
+      else if(strcmp(value, "plain")){
+	PrintUsage(argv[0]);
+	return 1;
+      }
+    }
+    else if(!strcmp(arg, "--param")){
+      char name;
+      float v;
+      if(sscanf(value, "%c=%f", &name, &v) != 2 || name < 'A' || name >= 'A' + HOST_PARAMETERS){
+	fprintf(stderr, "bad parameter setting: %s\n", value);
+	return 1;
+      }
+      automation.AddParameterPoint((PatchParameterId)(name - 'A'), 0.0, v, false);
+    }
+    else{
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if(!patchName || (!inputPath && !signalSpec) || blockSize < 1 ||
+     channels < 1 || channels > HOST_MAX_CHANNELS){
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  if(automationPath && !automation.Load(automationPath)){
+    fprintf(stderr, "cannot load automation: %s\n", automationPath);
+    return 1;
+  }
+
+  // prepare interleaved input signal
+  std::vector<float> input;
+  int frames;
+
+  if(inputPath){
+    int fileChannels;
+    std::vector<float> file;
+
+    if(!ReadWavFile(inputPath, file, fileChannels, sampleRate)){
+      fprintf(stderr, "cannot read wav file: %s\n", inputPath);
+      return 1;
+    }
+
+    // map file channels to host channels, mono is copied to all
+    frames = file.size()/fileChannels;
+    input.resize(frames*channels);
+    for(int i=0; i<frames; i++){
+      for(int ch=0; ch<channels; ch++){
+	input[i*channels + ch] = ch < fileChannels ? file[i*fileChannels + ch] :
+	                         (fileChannels == 1 ? file[i] : 0.f);
+      }
+    }
+  }
+  else{
+    frames = (int)(duration*sampleRate);
+    std::vector<float> mono(frames);
+
+    if(!GenerateSignal(signalSpec, mono.data(), frames, sampleRate, amplitude)){
+      fprintf(stderr, "unknown signal: %s\n", signalSpec);
+      return 1;
+    }
+
+    input.resize(frames*channels);
+    for(int i=0; i<frames; i++){
+      for(int ch=0; ch<channels; ch++){
+	input[i*channels + ch] = mono[i];
+      }
+    }
+  }
+
+  // host settings must be in place before the patch is constructed
+  Patch::setHostSampleRate(sampleRate);
+  Patch::setHostBlockSize(blockSize);
+  Patch::setHostChannels(channels);
+
+  // parameter values at time zero are the knob positions the patch
+  // constructor reads
+  automation.ApplyInitialValues();
+
+  Patch* patch = NULL;
+  NewtonStatistics* newtonStats = NULL;
+  for(int ii=0; ii<numPatches; ii++){
+    if(!strcmp(patchName, patchTable[ii].name)){
+      patch = patchTable[ii].create();
+
+      if(newtonReport && patchTable[ii].newtonStatistics){
+	newtonStats = patchTable[ii].newtonStatistics(patch);
+      }
+      if(approximation != FASTMATH_PADE && patchTable[ii].approximation){
+	patchTable[ii].approximation(patch, approximation);
+      }
+      if(newtonStep != NEWTON_PLAIN && patchTable[ii].newtonStep){
+	patchTable[ii].newtonStep(patch, newtonStep);
+      }
+      if(antialiasing && patchTable[ii].antialiasing){
+	patchTable[ii].antialiasing(patch);
+      }
+    }
+  }
+  if(!patch){
+    fprintf(stderr, "unknown patch: %s\n", patchName);
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  if(newtonReport && !newtonStats){
+    fprintf(stderr, "patch %s has no newton solver statistics\n", patchName);
+  }
+
+  std::vector<float> output(frames*channels);
+  AudioBuffer buffer(channels, blockSize);
+  double processTime = 0.0;
+
+  // process signal block by block, a trailing partial block is zero padded
+  for(long start=0; start<frames; start+=blockSize){
+    int n = frames - start < blockSize ? frames - start : blockSize;
+
+    buffer.clear();
+    for(int ch=0; ch<channels; ch++){
+      float* buf = buffer.getSamples(ch);
+      for(int i=0; i<n; i++){
+	buf[i] = input[(start + i)*channels + ch];
+      }
+    }
+
+    automation.ApplyBlock(patch, start, blockSize, sampleRate);
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    patch->processAudio(buffer);
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    processTime += std::chrono::duration<double>(t1 - t0).count();
+
+    for(int ch=0; ch<channels; ch++){
+      float* buf = buffer.getSamples(ch);
+      for(int i=0; i<n; i++){
+	output[(start + i)*channels + ch] = buf[i];
+      }
+    }
+  }
+
+  double audioTime = frames/(double)sampleRate;
+  fprintf(stderr, "%s: %d frames, %d channels, %.0f Hz, block %d: processed in %.3f ms (%.2f%% of real time)\n",
+	  patchName, frames, channels, sampleRate, blockSize,
+	  1.0e3*processTime, 100.0*processTime/audioTime);
+
+  if(newtonStats){
+    PrintNewtonStatistics(newtonStats);
+  }
+
+  if(outputPath && !WriteWavFile(outputPath, output.data(), frames, channels, sampleRate)){
+    fprintf(stderr, "cannot write wav file: %s\n", outputPath);
+    delete patch;
+    return 1;
+  }
+
+  delete patch;
+
+  if(comparePath && !CompareWavFile(comparePath, output, channels, tolerance)){
+    return 1;
+  }
+
+  return 0;
+}
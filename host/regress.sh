@@ -0,0 +1,130 @@
+#!/bin/sh
+#
+#  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+#
+#  All rights reserved.
+#
+#  This file is part of Kocmoc OWL Patch.
+#
+#  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+# render and compare regression check of the patches
+#
+# renders every patch over a set of settings, block sizes and automation
+# scripts. with record the renders become the references, otherwise each
+# render is compared to its reference and has to match it bit for bit
+#
+#   host/regress.sh <owlhost> <refdir> record
+#   host/regress.sh <owlhost> <refdir> [tolerance]
+
+if [ $# -lt 2 ]; then
+  echo "usage: $0 <owlhost> <refdir> [record | tolerance]" >&2
+  exit 1
+fi
+
+host=$1
+refdir=$2
+mode=${3:-0}
+
+mkdir -p "$refdir" || exit 1
+scripts=$(mktemp -d) || exit 1
+trap 'rm -rf "$scripts"' EXIT
+
+# filter knobs moved within and across blocks
+cat > "$scripts/filter.txt" <<EOF
+0.0   A  0.2
+0.3   A  0.8  ramp
+0.5   B  0.9  ramp
+0.7   D  0.6
+1.0   A  0.1  ramp
+EOF
+
+# delay time swept down to zero and back, feedback raised on the way
+cat > "$scripts/delay.txt" <<EOF
+0.0   A  0.3
+0.4   A  0.0  ramp
+0.6   B  0.8
+0.9   A  0.05 ramp
+1.2   A  0.6
+EOF
+
+# tap clock of the clocked delay
+cat > "$scripts/clock.txt" <<EOF
+0.0   A  0.5
+0.10  button  A  1
+0.15  button  A  0
+0.40  button  A  1
+0.45  button  A  0
+0.70  button  A  1
+0.75  button  A  0
+EOF
+
+failures=0
+cases=0
+
+# run one case, the name is the reference file
+render(){
+  name=$1
+  shift
+  cases=$((cases + 1))
+
+  if [ "$mode" = "record" ]; then
+    "$host" "$@" --duration 1.5 --output "$refdir/$name.wav" 2>/dev/null || {
+      echo "FAIL $name: render"
+      failures=$((failures + 1))
+    }
+  elif ! "$host" "$@" --duration 1.5 --compare "$refdir/$name.wav" --tolerance "$mode" 2>"$scripts/log"; then
+    echo "FAIL $name: $(grep compare "$scripts/log")"
+    failures=$((failures + 1))
+  fi
+}
+
+for block in 37 64 256; do
+  for patch in SVF LADR SKF; do
+    for knob in 0.1 0.5 0.9; do
+      render "$patch-$block-$knob" --patch $patch --signal saw:110 --blocksize $block \
+	     --param A=0.5 --param B=0.7 --param C=0.3 --param D=$knob
+    done
+    render "$patch-$block-auto" --patch $patch --signal sweep:50:5000 --blocksize $block \
+	   --automation "$scripts/filter.txt"
+    render "$patch-$block-minimax" --patch $patch --signal saw:220 --blocksize $block \
+	   --param A=0.6 --param B=0.8 --approximation minimax
+  done
+
+  for patch in SVF LADR; do
+    render "$patch-$block-aa" --patch $patch --signal saw:440 --blocksize $block \
+	   --param A=0.7 --param B=0.5 --param C=0.6 --antialiasing
+  done
+
+  for patch in DigiDelay DigiDelayClocked MultiTapDelay; do
+    render "$patch-$block" --patch $patch --signal impulse:0.25 --blocksize $block \
+	   --param A=0.2 --param B=0.6 --param D=0.5 --param E=1
+    render "$patch-$block-auto" --patch $patch --signal saw:110 --blocksize $block \
+	   --automation "$scripts/delay.txt" --param D=0.7 --param E=0.5
+    render "$patch-$block-mono" --patch $patch --signal noise --blocksize $block --channels 1 \
+	   --param A=0.01 --param B=0.9 --param D=0.5
+  done
+
+  render "DigiDelayClocked-$block-clock" --patch DigiDelayClocked --signal saw:110 --blocksize $block \
+	 --automation "$scripts/clock.txt" --param B=0.5 --param D=0.5
+done
+
+if [ "$mode" = "record" ]; then
+  echo "recorded $cases renders in $refdir, $failures failed"
+else
+  echo "$cases renders, $failures differ from $refdir"
+fi
+
+[ $failures -eq 0 ]
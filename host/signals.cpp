@@ -0,0 +1,86 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include "signals.h"
+
+bool GenerateSignal(const char* spec, float* out, int frames, float sampleRate, float amplitude){
+  float f0 = 0.f, f1 = 0.f;
+  double phase = 0.0;
+
+  if(sscanf(spec, "sine:%f", &f0) == 1){
+    for(int i=0; i<frames; i++){
+      out[i] = amplitude*(float)sin(2.0*M_PI*phase);
+      phase += f0/sampleRate;
+      phase -= floor(phase);
+    }
+  }
+  else if(sscanf(spec, "saw:%f", &f0) == 1){
+    for(int i=0; i<frames; i++){
+      out[i] = amplitude*(float)(2.0*phase - 1.0);
+      phase += f0/sampleRate;
+      phase -= floor(phase);
+    }
+  }
+  else if(sscanf(spec, "square:%f", &f0) == 1){
+    for(int i=0; i<frames; i++){
+      out[i] = phase < 0.5 ? amplitude : -amplitude;
+      phase += f0/sampleRate;
+      phase -= floor(phase);
+    }
+  }
+  else if(sscanf(spec, "sweep:%f:%f", &f0, &f1) == 2){
+    // exponential sine sweep over the whole signal
+    for(int i=0; i<frames; i++){
+      double f = f0*pow((double)f1/f0, (double)i/frames);
+      out[i] = amplitude*(float)sin(2.0*M_PI*phase);
+      phase += f/sampleRate;
+      phase -= floor(phase);
+    }
+  }
+  else if(sscanf(spec, "impulse:%f", &f0) == 1){
+    int period = (int)(f0*sampleRate);
+    for(int i=0; i<frames; i++){
+      out[i] = (period > 0 && i % period == 0) ? amplitude : 0.f;
+    }
+  }
+  else if(!strcmp(spec, "noise")){
+    // fixed seed so renders are repeatable
+    uint32_t state = 22222u;
+    for(int i=0; i<frames; i++){
+      state = state*1664525u + 1013904223u;
+      out[i] = amplitude*((float)(state >> 8)/8388608.f - 1.f);
+    }
+  }
+  else if(!strcmp(spec, "silence")){
+    for(int i=0; i<frames; i++){
+      out[i] = 0.f;
+    }
+  }
+  else{
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,31 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __hostsignalsh__
+#define __hostsignalsh__
+
+// generate a test signal into a mono buffer, returns false if the
+// specification is not recognized. supported specifications:
+//   sine:<hz>  saw:<hz>  square:<hz>  sweep:<hz0>:<hz1>
+//   noise  impulse:<period in seconds>  silence
+bool GenerateSignal(const char* spec, float* out, int frames, float sampleRate, float amplitude);
+
+#endif
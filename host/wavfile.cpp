@@ -0,0 +1,176 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include "wavfile.h"
+
+// wav format tags
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_IEEE_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xfffe
+
+static uint32_t ReadLE32(const unsigned char* p){
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t ReadLE16(const unsigned char* p){
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void WriteLE32(FILE* f, uint32_t v){
+  unsigned char b[4] = {(unsigned char)(v), (unsigned char)(v >> 8),
+			(unsigned char)(v >> 16), (unsigned char)(v >> 24)};
+  fwrite(b, 1, 4, f);
+}
+
+static void WriteLE16(FILE* f, uint16_t v){
+  unsigned char b[2] = {(unsigned char)(v), (unsigned char)(v >> 8)};
+  fwrite(b, 1, 2, f);
+}
+
+bool ReadWavFile(const char* path, std::vector<float> &samples, int &channels, float &sampleRate){
+  FILE* f = fopen(path, "rb");
+  if(!f){
+    return false;
+  }
+
+  unsigned char riff[12];
+  if(fread(riff, 1, 12, f) != 12 || memcmp(riff, "RIFF", 4) || memcmp(riff+8, "WAVE", 4)){
+    fclose(f);
+    return false;
+  }
+
+  int format = 0;
+  int bits = 0;
+  channels = 0;
+  sampleRate = 0.f;
+
+  // walk chunks until data chunk
+  unsigned char chunk[8];
+  while(fread(chunk, 1, 8, f) == 8){
+    uint32_t chunkSize = ReadLE32(chunk+4);
+
+    if(!memcmp(chunk, "fmt ", 4)){
+      unsigned char fmt[40];
+      uint32_t n = chunkSize < sizeof(fmt) ? chunkSize : sizeof(fmt);
+      if(n < 16 || fread(fmt, 1, n, f) != n){
+	break;
+      }
+      format = ReadLE16(fmt);
+      channels = ReadLE16(fmt+2);
+      sampleRate = (float)ReadLE32(fmt+4);
+      bits = ReadLE16(fmt+14);
+
+      // extensible format carries the real tag in the subformat guid
+      if(format == WAV_FORMAT_EXTENSIBLE && n >= 26){
+	format = ReadLE16(fmt+24);
+      }
+      fseek(f, (long)(chunkSize - n + (chunkSize & 1)), SEEK_CUR);
+    }
+    else if(!memcmp(chunk, "data", 4)){
+      if(channels < 1 || bits < 8){
+	break;
+      }
+
+      int bytes = bits/8;
+      int count = chunkSize/bytes;
+      std::vector<unsigned char> raw(chunkSize);
+      count = fread(raw.data(), 1, chunkSize, f)/bytes;
+      count -= count % channels;
+      samples.resize(count);
+
+      for(int i=0; i<count; i++){
+	const unsigned char* p = raw.data() + i*bytes;
+
+	if(format == WAV_FORMAT_IEEE_FLOAT && bits == 32){
+	  uint32_t u = ReadLE32(p);
+	  float v;
+	  memcpy(&v, &u, 4);
+	  samples[i] = v;
+	}
+	else if(format == WAV_FORMAT_PCM && bits == 16){
+	  samples[i] = (float)(int16_t)ReadLE16(p)/32768.f;
+	}
+	else if(format == WAV_FORMAT_PCM && bits == 24){
+	  int32_t v = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+	  samples[i] = (float)v/8388608.f;
+	}
+	else if(format == WAV_FORMAT_PCM && bits == 32){
+	  samples[i] = (float)(int32_t)ReadLE32(p)/2147483648.f;
+	}
+	else{
+	  fclose(f);
+	  return false;
+	}
+      }
+
+      fclose(f);
+      return true;
+    }
+    else{
+      // skip unknown chunk, chunks are word aligned
+      fseek(f, (long)(chunkSize + (chunkSize & 1)), SEEK_CUR);
+    }
+  }
+
+  fclose(f);
+  return false;
+}
+
+bool WriteWavFile(const char* path, const float* samples, int frames, int channels, float sampleRate){
+  FILE* f = fopen(path, "wb");
+  if(!f){
+    return false;
+  }
+
+  uint32_t dataSize = (uint32_t)frames*channels*4;
+
+  // riff header
+  fwrite("RIFF", 1, 4, f);
+  WriteLE32(f, 36 + dataSize);
+  fwrite("WAVE", 1, 4, f);
+
+  // format chunk
+  fwrite("fmt ", 1, 4, f);
+  WriteLE32(f, 16);
+  WriteLE16(f, WAV_FORMAT_IEEE_FLOAT);
+  WriteLE16(f, (uint16_t)channels);
+  WriteLE32(f, (uint32_t)sampleRate);
+  WriteLE32(f, (uint32_t)sampleRate*channels*4);
+  WriteLE16(f, (uint16_t)(channels*4));
+  WriteLE16(f, 32);
+
+  // data chunk
+  fwrite("data", 1, 4, f);
+  WriteLE32(f, dataSize);
+  for(int i=0; i<frames*channels; i++){
+    uint32_t u;
+    memcpy(&u, &samples[i], 4);
+    WriteLE32(f, u);
+  }
+
+  bool ok = !ferror(f);
+  fclose(f);
+
+  return ok;
+}
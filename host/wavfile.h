@@ -0,0 +1,34 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __hostwavfileh__
+#define __hostwavfileh__
+
+#include <vector>
+
+// read a PCM (16/24/32 bit) or IEEE float (32 bit) wav file into
+// interleaved float samples, returns false on error
+bool ReadWavFile(const char* path, std::vector<float> &samples, int &channels, float &sampleRate);
+
+// write interleaved float samples as a 32 bit IEEE float wav file
+bool WriteWavFile(const char* path, const float* samples, int frames, int channels, float sampleRate);
+
+#endif
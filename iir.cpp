@@ -21,207 +21,216 @@
 
 #include <cmath>
 #include "iir.h"
+#include "simd.h"
+
+// design cache entry
+struct IIRCacheEntry {
+  float samplerate;
+  float cutoff;
+  int order;
+  float sections[IIR_CACHE_MAX_ORDER/2*IIR_SECTION_STRIDE];
+};
+
+// designs looked up by all filter instances, replaced round robin. the
+// cache is single thread only: the table and its counters are not locked,
+// and patches set their filters up and change rates from one thread
+static IIRCacheEntry iirCache[IIR_CACHE_ENTRIES];
+static int iirCacheEntries = 0;
+static int iirCacheNext = 0;
+
+// load one section entry per section into vector lanes, lanes past the
+// last section are zero
+static SIMDFloat GatherSections(const float* v, int first, int sections){
+  float lanes[SIMD_WIDTH];
+
+  for(int l=0; l<SIMD_WIDTH; l++){
+    lanes[l] = first + l < sections ? v[(first + l)*IIR_SECTION_STRIDE] : 0.f;
+  }
 
-// constructor
-IIRLowpass::IIRLowpass(float newSamplerate, float newCutoff, int newOrder)
-{
-  // initialize filter design parameters
-  samplerate = newSamplerate;
-  cutoff = newCutoff;
-  order = newOrder;
-
-  // allocate dsp vectors
-  a1 = new float[order/2];
-  a2 = new float[order/2];
-  K = new float[order/2];
-  pa_real = new float[order/2];
-  pa_imag = new float[order/2];
-  p_real = new float[order/2];
-  p_imag = new float[order/2];
-
-  // allocate cascaded biquad buffer
-  z = new float[order];
-  
-  // initialize cascade delayline
-  InitializeBiquadCascade();
-  
-  // compute impulse response
-  ComputeCoefficients();
+  return SIMDLoad(lanes);
 }
 
-// default constructor
-IIRLowpass::IIRLowpass()
-{
-  // set default design parameters
-  samplerate=(float)(44100.0);
-  cutoff=(float)(440.0);
-  order=32;
-  
-  // allocate dsp vectors
-  a1 = new float[order/2];
-  a2 = new float[order/2];
-  K = new float[order/2];
-  pa_real = new float[order/2];
-  pa_imag = new float[order/2];
-  p_real = new float[order/2];
-  p_imag = new float[order/2];
-
-  // allocate cascaded biquad buffer
-  z = new float[order];
-  
-  // initialize cascade delayline
-  InitializeBiquadCascade();
-  
-  // compute impulse response
-  ComputeCoefficients();
-}
+void IIRComputeCoefficients(float* sections, float samplerate, float cutoff, int order){
+  // prewarp cutoff
+  float Fc = samplerate/M_PI*tan(M_PI*cutoff/samplerate);  
 
-// destructor
-IIRLowpass::~IIRLowpass(){
-  // free dsp vectors
-  delete[] a1;
-  delete[] a2;
-  delete[] K;
-  delete[] pa_real;
-  delete[] pa_imag;
-  delete[] p_real;
-  delete[] p_imag;
-  
-  // free cascaded biquad buffer
-  delete[] z;
-}
+  for(int ii = 0; ii<order/2; ii++) {
+    float *s = sections + ii*IIR_SECTION_STRIDE;
 
-void IIRLowpass::SetFilterOrder(int newOrder){
-  order = newOrder;
-
-  // free dsp vectors
-  delete[] a1;
-  delete[] a2;
-  delete[] K;
-  delete[] pa_real;
-  delete[] pa_imag;
-  delete[] p_real;
-  delete[] p_imag;
+    // place butterworth style analog filter pole
+    int k = order/2 - ii;
+    float theta = (2.0*(float)(k) - 1.0)*M_PI/(2.0*(float)(order));
     
-  // free cascaded biquad buffer
-  delete[] z;
-
-  // allocate dsp vectors
-  a1 = new float[order/2];
-  a2 = new float[order/2];
-  K = new float[order/2];
-  pa_real = new float[order/2];
-  pa_imag = new float[order/2];
-  p_real = new float[order/2];
-  p_imag = new float[order/2];
-
-  // allocate cascaded biquad buffer
-  z = new float[order];
-
-  // initialize cascade delayline
-  InitializeBiquadCascade();
-  
-  // compute new impulse response
-  ComputeCoefficients();
-}
-
-void IIRLowpass::SetFilterSamplerate(float newSamplerate){
-  samplerate = newSamplerate;
-
-  // initialize cascade delayline
-  InitializeBiquadCascade();
-  
-  // compute new cascade coefficients
-  ComputeCoefficients();
-}
-
-void IIRLowpass::SetFilterCutoff(float newCutoff){
-  cutoff = newCutoff;
+    float pa_real = -1.0*sin(theta);
+    float pa_imag = cos(theta);
+
+    // scale pole
+    pa_real *= 2.0*M_PI*Fc; 
+    pa_imag *= 2.0*M_PI*Fc; 
+
+    // bilinear transform to z-plane with complex division
+    float u = (2.0*samplerate+pa_real)/(2.0*samplerate); 
+    float v = pa_imag/(2.0*samplerate); 
+    float x = (2.0*samplerate-pa_real)/(2.0*samplerate); 
+    float y = -1.0*pa_imag/(2.0*samplerate);
+    
+    float c = 1.0/(x*x + y*y);
+    
+    float p_real = c*(u*x + v*y);
+    float p_imag = c*(v*x - u*y);
 
-  // initialize cascade delayline
-  InitializeBiquadCascade();
-  
-  // compute new cascade coefficients
-  ComputeCoefficients();
+    // compute cascade coefficients
+    s[IIR_SECTION_A1] = -2.0*p_real;
+    s[IIR_SECTION_A2] = p_real*p_real + p_imag*p_imag;
+    s[IIR_SECTION_K] = (1.0 + s[IIR_SECTION_A1] + s[IIR_SECTION_A2])/4.0;
+  }
 }
 
-void IIRLowpass::InitializeBiquadCascade(){
-  for(int ii=0; ii<order/2; ii++){
-    z[ii*2+1] = 0.0;
-    z[ii*2] = 0.0;
+void IIRLookupCoefficients(float* sections, float samplerate, float cutoff, int order){
+  if(order > IIR_CACHE_MAX_ORDER){
+    IIRComputeCoefficients(sections, samplerate, cutoff, order);
+    return;
   }
-}
 
-float IIRLowpass::IIRfilter(float input){
-  float out=input;
-  float in;
-
-  // process biquad cascade
-  for(int ii=0; ii<order/2; ii++) {
-    // compute biquad input
-    in = K[ii]*out - a1[ii]*z[ii*2] - a2[ii]*z[ii*2+1];
-      
-    // compute biquad output
-    out = in + 2.0*z[ii*2] + z[ii*2+1];
-    
-    // update delays
-    z[ii*2+1] = z[ii*2];
-    z[ii*2] = in;
+  // find a matching design
+  IIRCacheEntry *entry = NULL;
+  for(int e=0; e<iirCacheEntries; e++){
+    if(iirCache[e].samplerate == samplerate && iirCache[e].cutoff == cutoff && iirCache[e].order == order){
+      entry = &iirCache[e];
+      break;
+    }
   }
-  
-  return out;
-}
 
-float* IIRLowpass::GetFilterCoeffA1(){
-  return a1;
-}
+  // design into the next free or oldest entry on a miss
+  if(entry == NULL){
+    entry = &iirCache[iirCacheNext];
+    IIRComputeCoefficients(entry->sections, samplerate, cutoff, order);
+    entry->samplerate = samplerate;
+    entry->cutoff = cutoff;
+    entry->order = order;
+
+    iirCacheNext = (iirCacheNext + 1) % IIR_CACHE_ENTRIES;
+    if(iirCacheEntries < IIR_CACHE_ENTRIES){
+      iirCacheEntries++;
+    }
+  }
 
-float* IIRLowpass::GetFilterCoeffA2(){
-  return a2;
-}
+  // copy coefficients into the instance, delays are left alone
+  for(int ii=0; ii<order/2; ii++){
+    const float *c = entry->sections + ii*IIR_SECTION_STRIDE;
+    float *s = sections + ii*IIR_SECTION_STRIDE;
 
-float* IIRLowpass::GetFilterCoeffK(){
-  return K;
+    s[IIR_SECTION_A1] = c[IIR_SECTION_A1];
+    s[IIR_SECTION_A2] = c[IIR_SECTION_A2];
+    s[IIR_SECTION_K] = c[IIR_SECTION_K];
+  }
 }
 
-void IIRLowpass::ComputeCoefficients(){
-  // place butterworth style analog filter poles
-  float theta;
+template <int groups>
+static void IIRfilterPipeline(float* s, int sections, float* buffer, int n){
+  // section k of the cascade runs in lane k and works on sample t-k at
+  // step t, so every section updates at once. the pipeline is filled at
+  // the start of the block and drained at its end, which keeps the
+  // output aligned with the serial cascade
+  float lanes[SIMD_WIDTH];
+  SIMDFloat vK[groups], va1[groups], va2[groups];
+  SIMDFloat z1[groups], z2[groups], y[groups];
+
+  // gather coefficients and delays, unused lanes stay silent
+  for(int g=0; g<groups; g++){
+    vK[g] = GatherSections(s + IIR_SECTION_K, g*SIMD_WIDTH, sections);
+    va1[g] = GatherSections(s + IIR_SECTION_A1, g*SIMD_WIDTH, sections);
+    va2[g] = GatherSections(s + IIR_SECTION_A2, g*SIMD_WIDTH, sections);
+    z1[g] = GatherSections(s + IIR_SECTION_Z1, g*SIMD_WIDTH, sections);
+    z2[g] = GatherSections(s + IIR_SECTION_Z2, g*SIMD_WIDTH, sections);
+    y[g] = 0.f;
+  }
 
-  for(int ii = 0; ii<order/2; ii++) {
-    int k = order/2 - ii;
-    theta = (2.0*(float)(k) - 1.0)*M_PI/(2.0*(float)(order));
-    
-    pa_real[ii] = -1.0*sin(theta);
-    pa_imag[ii] = cos(theta);
+  // output leaves the pipeline from the last section
+  int last = sections - 1;
+  SIMDFloat laneIndex = SIMDLaneIndex();
+
+  for(int t=0; t<n+last; t++){
+    // steps during fill and drain leave lanes without a sample idle
+    bool edge = t < last || t >= n;
+    SIMDFloat x[groups];
+
+    // move every section output one lane up, new sample enters lane 0
+    x[0] = SIMDShiftIn(y[0], SIMDFloat(t < n ? buffer[t] : 0.f));
+    for(int g=1; g<groups; g++){
+      x[g] = SIMDShiftIn(y[g], y[g-1]);
+    }
+
+    for(int g=0; g<groups; g++){
+      // compute biquad input
+      SIMDFloat in = vK[g]*x[g] - va1[g]*z1[g] - va2[g]*z2[g];
+
+      // compute biquad output
+      y[g] = in + 2.f*z1[g] + z2[g];
+
+      // update delays
+      if(edge){
+	SIMDFloat sample = SIMDFloat((float)(t - g*SIMD_WIDTH)) - laneIndex;
+	SIMDMask active = SIMDGreaterEqual(sample, 0.f) & SIMDLess(sample, (float)(n));
+
+	z2[g] = SIMDSelect(active, z1[g], z2[g]);
+	z1[g] = SIMDSelect(active, in, z1[g]);
+      }
+      else{
+	z2[g] = z1[g];
+	z1[g] = in;
+      }
+    }
+
+    // collect finished sample, buffer slot has been consumed already
+    if(t >= last){
+      SIMDStore(lanes, y[last/SIMD_WIDTH]);
+      buffer[t - last] = lanes[last % SIMD_WIDTH];
+    }
   }
 
-  // prewarp and scale poles
-  float Fc = samplerate/M_PI*tan(M_PI*cutoff/samplerate);  
-  for(int ii = 0; ii<order/2; ii++) {
-    pa_real[ii] *= 2.0*M_PI*Fc; 
-    pa_imag[ii] *= 2.0*M_PI*Fc; 
+  // store delays
+  for(int g=0; g<groups; g++){
+    SIMDStore(lanes, z1[g]);
+    for(int l=0; l<SIMD_WIDTH && g*SIMD_WIDTH + l < sections; l++){
+      s[(g*SIMD_WIDTH + l)*IIR_SECTION_STRIDE + IIR_SECTION_Z1] = lanes[l];
+    }
+    SIMDStore(lanes, z2[g]);
+    for(int l=0; l<SIMD_WIDTH && g*SIMD_WIDTH + l < sections; l++){
+      s[(g*SIMD_WIDTH + l)*IIR_SECTION_STRIDE + IIR_SECTION_Z2] = lanes[l];
+    }
   }
+}
 
-  // bilinear transform to z-plane
-  for(int ii = 0; ii<order/2; ii++) {
-    // complex division
-    float u = (2.0*samplerate+pa_real[ii])/(2.0*samplerate); 
-    float v = pa_imag[ii]/(2.0*samplerate); 
-    float x = (2.0*samplerate-pa_real[ii])/(2.0*samplerate); 
-    float y = -1.0*pa_imag[ii]/(2.0*samplerate);
-    
-    float c = 1.0/(x*x + y*y);
-    
-    p_real[ii] = c*(u*x + v*y);
-    p_imag[ii] = c*(v*x - u*y);
+void IIRfilterSectionsBlock(float* sections, int order, float* buffer, int n){
+  int count = order/2;
+
+  // short blocks run the serial cascade
+  if(n < IIR_PIPELINE_MIN_SPAN*count){
+    for(int i=0; i<n; i++){
+      buffer[i] = IIRfilterSections(sections, order, buffer[i]);
+    }
+    return;
   }
-  
-  // compute cascade coefficients
-  for(int ii = 0; ii<order/2; ii++) {
-    a1[ii] = -2.0*p_real[ii];
-    a2[ii] = p_real[ii]*p_real[ii] + p_imag[ii]*p_imag[ii];
-    K[ii] = (1.0 + a1[ii] + a2[ii])/4.0;
+
+  // pipeline depth is a compile time constant
+  switch(SIMDGroups(count)){
+  case 1:
+    IIRfilterPipeline<1>(sections, count, buffer, n);
+    break;
+  case 2:
+    IIRfilterPipeline<2>(sections, count, buffer, n);
+    break;
+  case 3:
+    IIRfilterPipeline<3>(sections, count, buffer, n);
+    break;
+  case 4:
+    IIRfilterPipeline<4>(sections, count, buffer, n);
+    break;
+  default:
+    // cascade too long for the pipeline
+    for(int i=0; i<n; i++){
+      buffer[i] = IIRfilterSections(sections, order, buffer[i]);
+    }
   }
 }
-
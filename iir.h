@@ -22,17 +22,79 @@
 #ifndef __dspiirh__
 #define __dspiirh__
 
-class IIRLowpass{
+// oversampled samples collected for one block decimation pass
+#define IIR_BLOCK_SIZE 256
+
+// per section layout of the interleaved coefficient and delay array
+#define IIR_SECTION_A1 0
+#define IIR_SECTION_A2 1
+#define IIR_SECTION_K 2
+#define IIR_SECTION_Z1 3
+#define IIR_SECTION_Z2 4
+#define IIR_SECTION_STRIDE 8
+
+// samples per section below which a block runs the serial cascade, the
+// pipeline fill and drain outweigh the lanes on shorter blocks
+#define IIR_PIPELINE_MIN_SPAN 8
+
+// number of designs held by the coefficient design cache
+#define IIR_CACHE_ENTRIES 16
+
+// largest order kept in the cache, longer cascades are always designed
+#define IIR_CACHE_MAX_ORDER 32
+
+// compute butterworth biquad cascade coefficients of a section array
+void IIRComputeCoefficients(float* sections, float samplerate, float cutoff, int order);
+
+// copy butterworth biquad cascade coefficients of a section array from the
+// design cache, designing them on a miss. the cache saves the design work
+// only, every instance holds its own copy next to the section delays.
+// voices that should share one coefficient set run in an IIRLowpassBank.
+// not thread safe, call from the thread that sets the filters up
+void IIRLookupCoefficients(float* sections, float samplerate, float cutoff, int order);
+
+// IIR filter a block of samples in place through a section array
+void IIRfilterSectionsBlock(float* sections, int order, float* buffer, int n);
+
+// IIR filter signal through a section array
+inline float IIRfilterSections(float* sections, int order, float input){
+  float out=input;
+  float in;
+
+  // process biquad cascade
+  for(int ii=0; ii<order/2; ii++) {
+    float *s = sections + ii*IIR_SECTION_STRIDE;
+
+    // compute biquad input
+    in = s[IIR_SECTION_K]*out - s[IIR_SECTION_A1]*s[IIR_SECTION_Z1] - s[IIR_SECTION_A2]*s[IIR_SECTION_Z2];
+      
+    // compute biquad output
+    out = in + 2.f*s[IIR_SECTION_Z1] + s[IIR_SECTION_Z2];
+    
+    // update delays
+    s[IIR_SECTION_Z2] = s[IIR_SECTION_Z1];
+    s[IIR_SECTION_Z1] = in;
+  }
+  
+  return out;
+}
+
+// butterworth lowpass biquad cascade with a compile time maximum order.
+// coefficients and delays of each section sit next to each other in one
+// inline array, so the filter never allocates and the order can be
+// changed from the audio thread
+template <int maxOrder>
+class FixedIIRLowpass{
 public:
-  // constructor/destructor
-  IIRLowpass(float newSamplerate, float newCutoff, int newOrder);
-  IIRLowpass();
-  ~IIRLowpass();
+  // constructor
+  FixedIIRLowpass(float newSamplerate, float newCutoff, int newOrder);
+  FixedIIRLowpass();
 
   // set filter parameters
   void SetFilterOrder(int newOrder);
   void SetFilterSamplerate(float newSamplerate);
   void SetFilterCutoff(float newCutoff);
+  void SetFilterParameters(float newSamplerate, float newCutoff);
 
   // initialize biquad cascade delayline
   void InitializeBiquadCascade();
@@ -40,31 +102,128 @@ public:
   // IIR filter signal 
   float IIRfilter(float input);
 
-  // get filter coefficients
-  float* GetFilterCoeffA1();
-  float* GetFilterCoeffA2();
-  float* GetFilterCoeffK();
+  // IIR filter a block of samples in place, same result as IIRfilter
+  // on every sample in turn
+  void IIRfilterBlock(float* buffer, int n);
+
+  // get filter order
+  int GetFilterOrder();
+
+  // get interleaved section coefficients and delays
+  const float* GetFilterSections();
   
 private:
-  // compute biquad cascade coefficients
-  void ComputeCoefficients();
-
   // filter design variables
   float samplerate;
   float cutoff;
   int order;
   
-  // dsp variables
-  float *a1;
-  float *a2;
-  float *K;
-  float *pa_real;
-  float *pa_imag;
-  float *p_real;
-  float *p_imag;
-  
-  // cascaded biquad buffers
-  float *z;
+  // interleaved biquad cascade coefficients and delays
+  alignas(16) float sections[maxOrder/2*IIR_SECTION_STRIDE];
 };
 
+// general purpose cascade up to order 32
+typedef FixedIIRLowpass<32> IIRLowpass;
+
+template <int maxOrder>
+FixedIIRLowpass<maxOrder>::FixedIIRLowpass(float newSamplerate, float newCutoff, int newOrder){
+  // initialize filter design parameters
+  samplerate = newSamplerate;
+  cutoff = newCutoff;
+  order = newOrder > maxOrder ? maxOrder : newOrder;
+
+  // initialize cascade delayline
+  InitializeBiquadCascade();
+  
+  // compute impulse response
+  IIRLookupCoefficients(sections, samplerate, cutoff, order);
+}
+
+template <int maxOrder>
+FixedIIRLowpass<maxOrder>::FixedIIRLowpass(){
+  // set default design parameters
+  samplerate = 44100.f;
+  cutoff = 440.f;
+  order = maxOrder;
+
+  // initialize cascade delayline
+  InitializeBiquadCascade();
+  
+  // compute impulse response
+  IIRLookupCoefficients(sections, samplerate, cutoff, order);
+}
+
+template <int maxOrder>
+void FixedIIRLowpass<maxOrder>::SetFilterOrder(int newOrder){
+  order = newOrder > maxOrder ? maxOrder : newOrder;
+
+  // initialize cascade delayline
+  InitializeBiquadCascade();
+  
+  // compute new impulse response
+  IIRLookupCoefficients(sections, samplerate, cutoff, order);
+}
+
+template <int maxOrder>
+void FixedIIRLowpass<maxOrder>::SetFilterSamplerate(float newSamplerate){
+  samplerate = newSamplerate;
+
+  // initialize cascade delayline
+  InitializeBiquadCascade();
+  
+  // compute new cascade coefficients
+  IIRLookupCoefficients(sections, samplerate, cutoff, order);
+}
+
+template <int maxOrder>
+void FixedIIRLowpass<maxOrder>::SetFilterCutoff(float newCutoff){
+  cutoff = newCutoff;
+
+  // initialize cascade delayline
+  InitializeBiquadCascade();
+  
+  // compute new cascade coefficients
+  IIRLookupCoefficients(sections, samplerate, cutoff, order);
+}
+
+template <int maxOrder>
+void FixedIIRLowpass<maxOrder>::SetFilterParameters(float newSamplerate, float newCutoff){
+  samplerate = newSamplerate;
+  cutoff = newCutoff;
+
+  // initialize cascade delayline
+  InitializeBiquadCascade();
+  
+  // compute new cascade coefficients
+  IIRLookupCoefficients(sections, samplerate, cutoff, order);
+}
+
+template <int maxOrder>
+void FixedIIRLowpass<maxOrder>::InitializeBiquadCascade(){
+  for(int ii=0; ii<maxOrder/2; ii++){
+    sections[ii*IIR_SECTION_STRIDE + IIR_SECTION_Z1] = 0.f;
+    sections[ii*IIR_SECTION_STRIDE + IIR_SECTION_Z2] = 0.f;
+  }
+}
+
+template <int maxOrder>
+inline float FixedIIRLowpass<maxOrder>::IIRfilter(float input){
+  return IIRfilterSections(sections, order, input);
+}
+
+template <int maxOrder>
+void FixedIIRLowpass<maxOrder>::IIRfilterBlock(float* buffer, int n){
+  IIRfilterSectionsBlock(sections, order, buffer, n);
+}
+
+template <int maxOrder>
+int FixedIIRLowpass<maxOrder>::GetFilterOrder(){
+  return order;
+}
+
+template <int maxOrder>
+const float* FixedIIRLowpass<maxOrder>::GetFilterSections(){
+  return sections;
+}
+
 #endif
@@ -0,0 +1,65 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "iirbank.h"
+
+// constructor
+IIRLowpassBank::IIRLowpassBank(int newVoices, float newSamplerate, float newCutoff, int newOrder) :
+  design(newSamplerate, newCutoff, newOrder)
+{
+  sections = newOrder/2;
+  groups = SIMDGroups(newVoices);
+
+  // coefficients are owned by the design filter
+  coef = design.GetFilterSections();
+
+  // allocate cascaded biquad buffers
+  z = new float[groups*sections*2*SIMD_WIDTH];
+
+  // initialize cascade delaylines
+  InitializeBiquadCascade();
+}
+
+// destructor
+IIRLowpassBank::~IIRLowpassBank(){
+  delete[] z;
+}
+
+void IIRLowpassBank::SetFilterSamplerate(float newSamplerate){
+  design.SetFilterSamplerate(newSamplerate);
+  InitializeBiquadCascade();
+}
+
+void IIRLowpassBank::SetFilterCutoff(float newCutoff){
+  design.SetFilterCutoff(newCutoff);
+  InitializeBiquadCascade();
+}
+
+void IIRLowpassBank::SetFilterParameters(float newSamplerate, float newCutoff){
+  design.SetFilterParameters(newSamplerate, newCutoff);
+  InitializeBiquadCascade();
+}
+
+void IIRLowpassBank::InitializeBiquadCascade(){
+  for(int ii=0; ii<groups*sections*2*SIMD_WIDTH; ii++){
+    z[ii] = 0.f;
+  }
+}
@@ -0,0 +1,82 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __dspiirbankh__
+#define __dspiirbankh__
+
+#include "simd.h"
+#include "iir.h"
+
+// butterworth lowpass biquad cascade for a bank of voices, with one
+// voice per vector lane and the coefficients shared by all voices
+class IIRLowpassBank{
+public:
+  // constructor/destructor
+  IIRLowpassBank(int newVoices, float newSamplerate, float newCutoff, int newOrder);
+  ~IIRLowpassBank();
+
+  // set filter parameters
+  void SetFilterSamplerate(float newSamplerate);
+  void SetFilterCutoff(float newCutoff);
+  void SetFilterParameters(float newSamplerate, float newCutoff);
+
+  // initialize biquad cascade delaylines
+  void InitializeBiquadCascade();
+
+  // IIR filter one sample of a voice group
+  inline SIMDFloat IIRfilter(int group, SIMDFloat input);
+
+private:
+  // coefficient design
+  IIRLowpass design;
+  const float *coef;
+  int sections;
+
+  // cascaded biquad buffers, two delays per section per voice group
+  int groups;
+  float *z;
+};
+
+inline SIMDFloat IIRLowpassBank::IIRfilter(int group, SIMDFloat input){
+  SIMDFloat out = input;
+  float *zg = z + group*sections*2*SIMD_WIDTH;
+
+  // process biquad cascade
+  for(int ii=0; ii<sections; ii++) {
+    SIMDFloat z1 = SIMDLoad(zg + (ii*2)*SIMD_WIDTH);
+    SIMDFloat z2 = SIMDLoad(zg + (ii*2 + 1)*SIMD_WIDTH);
+
+    // compute biquad input
+    const float *c = coef + ii*IIR_SECTION_STRIDE;
+    SIMDFloat in = c[IIR_SECTION_K]*out - c[IIR_SECTION_A1]*z1 - c[IIR_SECTION_A2]*z2;
+
+    // compute biquad output
+    out = in + 2.f*z1 + z2;
+
+    // update delays
+    SIMDStore(zg + (ii*2 + 1)*SIMD_WIDTH, z1);
+    SIMDStore(zg + (ii*2)*SIMD_WIDTH, in);
+  }
+
+  return out;
+}
+
+#endif
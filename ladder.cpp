@@ -19,18 +19,47 @@
  *  along with Ladder Filter OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <cstdlib>
 #include <cmath>
 #include "ladder.h"
 #include "iir.h"
 #include "fastmath.h"
-
-// steepness of downsample filter response
-#define IIR_DOWNSAMPLE_ORDER 8
+#include "newton.h"
+#include "adaa.h"
 
 // downsampling passthrough bandwidth
 #define IIR_DOWNSAMPLING_BANDWIDTH 0.9
 
+// trapezoidal feedback equation x + x*tanh(g*x)*C_t - tanh(g*x) - C_t = 0
+template <FastmathApproximation approximation>
+struct LadderTrapezoidalResidual {
+  float g, C_t;
+
+  inline void Evaluate(float x, float& f, float& df, float& d2f) const {
+    // tanh and its first two derivatives
+    float t = Fastmath<approximation>::Tanh(g*x);
+    float t1 = g*(1.f - t*t);
+    float t2 = -2.f*g*t*t1;
+
+    f = x + x*t*C_t - t - C_t;
+    df = 1.f + C_t*(t + x*t1) - t1;
+    d2f = C_t*(2.f*t1 + x*t2) - t2;
+  }
+};
+
+// newton-raphson solve of the trapezoidal feedback equation from x, the
+// approximant branch is taken once per solve rather than once per
+// evaluation
+static inline NewtonResult LadderTrapezoidalSolve(FastmathApproximation approximation, NewtonStep step, float g, float C_t,
+						  float x, float tolerance, bool report){
+  if(approximation == FASTMATH_MINIMAX){
+    LadderTrapezoidalResidual<FASTMATH_MINIMAX> residual = {g, C_t};
+    return NewtonSolve<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+  }
+
+  LadderTrapezoidalResidual<FASTMATH_PADE> residual = {g, C_t};
+  return NewtonSolve<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+}
+
 // constructor
 Ladder::Ladder(float newCutoff, float newResonance, int newOversamplingFactor,
 	       LadderFilterMode newFilterMode, float newSampleRate, LadderIntegrationMethod newIntegrationMethod){
@@ -44,12 +73,33 @@ Ladder::Ladder(float newCutoff, float newResonance, int newOversamplingFactor,
   SetFilterIntegrationRate();
 
   // initialize filter state
-  p0 = p1 = p2 = p3 = out = ut_1 = 0.0;
+  p0 = p1 = p2 = p3 = out = ut_1 = 0.f;
+  xk_t1 = xk_t2 = 0.f;
+  ResetADAAState(driveState);
+  ResetADAAState(delayedDriveState);
+  ResetADAAState(outputState);
   
   integrationMethod = newIntegrationMethod;
+  resamplerType = RESAMPLER_IIR;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+  antialiasing = false;
+  morph = 0.f;
+
+  SelectKernel();
   
   // instantiate downsampling filter
-  iir = new IIRLowpass(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, IIR_DOWNSAMPLE_ORDER);
+  iir = new FixedIIRLowpass<LADDER_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, LADDER_IIR_DOWNSAMPLE_ORDER);
+
+  // instantiate half-band resampler chain
+  halfband = new HalfbandResampler(oversamplingFactor);
+
+  // multi-output taps get their decimators when enabled
+  taps = new FilterTaps<LADDER_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0,
+					       oversamplingFactor);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
 }
 
 // default constructor
@@ -64,79 +114,255 @@ Ladder::Ladder(){
   SetFilterIntegrationRate();
   
   // initialize filter state
-  p0 = p1 = p2 = p3 = out = ut_1 = 0.0;
+  p0 = p1 = p2 = p3 = out = ut_1 = 0.f;
+  xk_t1 = xk_t2 = 0.f;
+  ResetADAAState(driveState);
+  ResetADAAState(delayedDriveState);
+  ResetADAAState(outputState);
   
   integrationMethod = LADDER_PREDICTOR_CORRECTOR_FULL_TANH;
+  resamplerType = RESAMPLER_IIR;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+  antialiasing = false;
+  morph = 0.f;
+
+  SelectKernel();
   
   // instantiate downsampling filter
-  iir = new IIRLowpass(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, IIR_DOWNSAMPLE_ORDER);
+  iir = new FixedIIRLowpass<LADDER_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, LADDER_IIR_DOWNSAMPLE_ORDER);
+
+  // instantiate half-band resampler chain
+  halfband = new HalfbandResampler(oversamplingFactor);
+
+  // multi-output taps get their decimators when enabled
+  taps = new FilterTaps<LADDER_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0,
+					       oversamplingFactor);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
 }
 
 // default destructor
 Ladder::~Ladder(){
   delete iir;
+  delete halfband;
+  delete taps;
+  delete newtonStats;
 }
 
 void Ladder::ResetFilterState(){
   // initialize filter parameters
   cutoffFrequency = 0.25;
-  Resonance = 0.0;
+  Resonance = 0.f;
 
   SetFilterIntegrationRate();
   
   // initialize filter state
-  p0 = p1 = p2 = p3 = out = ut_1 = 0.0;
+  p0 = p1 = p2 = p3 = out = ut_1 = 0.f;
+  xk_t1 = xk_t2 = 0.f;
+  ResetADAAState(driveState);
+  ResetADAAState(delayedDriveState);
+  ResetADAAState(outputState);
   
   // set oversampling
-  iir->SetFilterSamplerate(sampleRate * oversamplingFactor);
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  halfband->InitializeResampler();
+  taps->SetTapsParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, oversamplingFactor);
 }
 
 void Ladder::SetFilterCutoff(float newCutoff){
-  cutoffFrequency = newCutoff;
+  // derived constants are only invalidated by a change
+  if(newCutoff != cutoffFrequency){
+    cutoffFrequency = newCutoff;
 
-  SetFilterIntegrationRate();
+    SetFilterIntegrationRate();
+  }
 }
 
 void Ladder::SetFilterResonance(float newResonance){
-  Resonance = newResonance;
+  if(newResonance != Resonance){
+    Resonance = newResonance;
+    coefficientsDirty = true;
+  }
 }
 
 void Ladder::SetFilterOversamplingFactor(int newOversamplingFactor){
   oversamplingFactor = newOversamplingFactor;
-  iir->SetFilterSamplerate(sampleRate * oversamplingFactor);
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  halfband->SetResamplerFactor(oversamplingFactor);
+  taps->SetTapsParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, oversamplingFactor);
 
   SetFilterIntegrationRate();
+  SelectKernel();
 }
 
 void Ladder::SetFilterMode(LadderFilterMode newFilterMode){
   filterMode = newFilterMode;
+  SelectKernel();
 }
 
 void Ladder::SetFilterSampleRate(float newSampleRate){
   sampleRate = newSampleRate;
-  iir->SetFilterSamplerate(sampleRate * (float)(oversamplingFactor));
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * (float)(oversamplingFactor), IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  taps->SetTapsParameters(sampleRate * (float)(oversamplingFactor), IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0,
+			  oversamplingFactor);
 
   SetFilterIntegrationRate();
 }
 
 void Ladder::SetFilterIntegrationMethod(LadderIntegrationMethod method){
   integrationMethod = method;
+  SelectKernel();
+}
+
+void Ladder::SetFilterResampler(ResamplerType newResampler){
+  resamplerType = newResampler;
+  halfband->InitializeResampler();
+  taps->InitializeTaps();
+  SelectKernel();
+}
+
+void Ladder::SetFilterApproximation(FastmathApproximation newApproximation){
+  approximation = newApproximation;
+}
+
+void Ladder::SetFilterNewtonStep(NewtonStep newStep){
+  newtonStep = newStep;
+}
+
+void Ladder::SetFilterAntialiasing(bool enable){
+  antialiasing = enable;
+
+  // segments start over from the origin
+  ResetADAAState(driveState);
+  ResetADAAState(delayedDriveState);
+  ResetADAAState(outputState);
+}
+
+void Ladder::SetFilterMorph(float newMorph){
+  morph = newMorph;
+}
+
+void Ladder::SetFilterNoiseSeed(uint32_t newSeed){
+  dither.SetNoiseSeed(newSeed);
+}
+
+void Ladder::SetFilterTaps(int mask){
+  taps->SetTaps(mask);
+}
+
+void Ladder::SetFilterNewtonStatistics(bool enable){
+  if(enable && newtonStats == NULL){
+    newtonStats = new NewtonStatistics();
+  }
+  else if(!enable){
+    delete newtonStats;
+    newtonStats = NULL;
+  }
+}
+
+// clamp integration rate
+static inline float LadderClampIntegrationRate(float dt){
+  if(dt < 0.f){
+    dt = 0.f;
+  }
+  else if(dt > 0.85f){
+    dt = 0.85f;
+  }
+
+  return dt;
+}
+
+// derive the kernel constants from the integration rate and resonance
+static inline void LadderDeriveCoefficients(LadderCoefficients& coefficients, float dt, float resonance){
+  float b, c, r;
+
+  // feedback amount
+  coefficients.fb = 8.f*resonance;
+
+  // trapezoidal stage weights
+  r = 1.f/(1.f + 0.5f*dt);
+  b = 0.5f*dt*r;
+  c = (1.f - 0.5f*dt)*r;
+  coefficients.b = b;
+  coefficients.c = c;
+  coefficients.g = -coefficients.fb*b*b*b*b;
+
+  // weights of the stage outputs and the drive in the predicted output
+  coefficients.dp0 = b*b*b+b*b*b*c;
+  coefficients.dp1 = b*b+b*b*c;
+  coefficients.dp2 = b + c*b;
+  coefficients.dut = b*b*b*b;
 }
 
 void Ladder::SetFilterIntegrationRate(){
   // normalize cutoff freq to samplerate
-  dt = 44100.0 / (sampleRate * oversamplingFactor) * cutoffFrequency;
+  dt = LadderClampIntegrationRate(44100.0 / (sampleRate * oversamplingFactor) * cutoffFrequency);
 
-  // clamp integration rate
-  if(dt < 0.0){
-    dt = 0.0;
-  }
-  else if(dt > 0.85){
-    dt = 0.85;
+  coefficientsDirty = true;
+}
+
+void Ladder::UpdateFilterCoefficients(){
+  LadderDeriveCoefficients(coefficients, dt, Resonance);
+
+  coefficientsDirty = false;
+}
+
+// kernel table entries for the specialized oversampling factors
+#define LADDER_KERNEL_ROW(method, mode, multiOutput) \
+  {&Ladder::ProcessBlockKernel<method, mode, multiOutput, 0>, \
+   &Ladder::ProcessBlockKernel<method, mode, multiOutput, 1>, \
+   &Ladder::ProcessBlockKernel<method, mode, multiOutput, 2>, \
+   &Ladder::ProcessBlockKernel<method, mode, multiOutput, 4>, \
+   &Ladder::ProcessBlockKernel<method, mode, multiOutput, 8>}
+
+#define LADDER_KERNEL_MODES(method) \
+  {LADDER_KERNEL_ROW(method, LADDER_LOWPASS_MODE, false), \
+   LADDER_KERNEL_ROW(method, LADDER_BANDPASS_MODE, false), \
+   LADDER_KERNEL_ROW(method, LADDER_HIGHPASS_MODE, false)}
+
+void Ladder::SelectKernel(){
+  static const ProcessBlockKernelFn kernels[4][3][5] = {
+    LADDER_KERNEL_MODES(LADDER_EULER_FULL_TANH),
+    LADDER_KERNEL_MODES(LADDER_PREDICTOR_CORRECTOR_FULL_TANH),
+    LADDER_KERNEL_MODES(LADDER_PREDICTOR_CORRECTOR_FEEDBACK_TANH),
+    LADDER_KERNEL_MODES(LADDER_TRAPEZOIDAL_FEEDBACK_TANH)
+  };
+
+  // multi-output kernels compute every response, the mode is unused
+  static const ProcessBlockKernelFn tapsKernels[4][5] = {
+    LADDER_KERNEL_ROW(LADDER_EULER_FULL_TANH, LADDER_LOWPASS_MODE, true),
+    LADDER_KERNEL_ROW(LADDER_PREDICTOR_CORRECTOR_FULL_TANH, LADDER_LOWPASS_MODE, true),
+    LADDER_KERNEL_ROW(LADDER_PREDICTOR_CORRECTOR_FEEDBACK_TANH, LADDER_LOWPASS_MODE, true),
+    LADDER_KERNEL_ROW(LADDER_TRAPEZOIDAL_FEEDBACK_TANH, LADDER_LOWPASS_MODE, true)
+  };
+
+  // specialized oversampling factors, other factors use the generic kernel
+  int os;
+  switch(oversamplingFactor){
+  case 1:
+    os = 1;
+    break;
+  case 2:
+    os = 2;
+    break;
+  case 4:
+    os = 3;
+    break;
+  case 8:
+    os = 4;
+    break;
+  default:
+    os = 0;
   }
+
+  kernel = kernels[integrationMethod][filterMode][os];
+  tapsKernel = tapsKernels[integrationMethod][os];
+
+  // half-band chain handles power of two factors only
+  halfbandResampler = resamplerType == RESAMPLER_HALFBAND && oversamplingFactor > 1 &&
+    HalfbandResampler::IsResamplerFactor(oversamplingFactor);
 }
 
 float Ladder::GetFilterCutoff(){
@@ -167,154 +393,351 @@ LadderIntegrationMethod Ladder::GetFilterIntegrationMethod(){
   return integrationMethod;
 }
 
+ResamplerType Ladder::GetFilterResampler(){
+  return resamplerType;
+}
+
+FastmathApproximation Ladder::GetFilterApproximation(){
+  return approximation;
+}
+
+NewtonStep Ladder::GetFilterNewtonStep(){
+  return newtonStep;
+}
+
+bool Ladder::GetFilterAntialiasing(){
+  return antialiasing;
+}
+
+float Ladder::GetFilterMorph(){
+  return morph;
+}
+
+NewtonStatistics* Ladder::GetFilterNewtonStatistics(){
+  return newtonStats;
+}
+
 void Ladder::LadderFilter(float input){
-  // noise term
-  float noise;
+  ProcessBlock(&input, &out, 1);
+}
 
-  // feedback amount
-  float fb = 8.0*Resonance;
+void Ladder::ProcessBlock(const float* in, float* out, int n){
+  (this->*kernel)(in, &out, n, NULL, NULL);
+}
 
-  // update noise terms
-  noise = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-  noise = 1.0e-6 * 2.0 * (noise - 0.5);
+void Ladder::ProcessBlock(const float* in, float* out, int n, const float* cutoff, const float* resonance){
+  (this->*kernel)(in, &out, n, cutoff, resonance);
 
-  input += noise;
-  
-  // integrate filter state
-  // with oversampling
-  for(int nn = 0; nn < oversamplingFactor; nn++){
-    // switch integration method
-    switch(integrationMethod){
-    case LADDER_EULER_FULL_TANH:
-      // semi-implicit euler integration
-      // with full tanh stages
-      {
-	p0 = p0 + dt*(TanhPade32(input - fb*p3) - TanhPade32(p0));
-	p1 = p1 + dt*(TanhPade32(p0) - TanhPade32(p1));
-	p2 = p2 + dt*(TanhPade32(p1) - TanhPade32(p2));
-	p3 = p3 + dt*(TanhPade32(p2) - TanhPade32(p3));
+  // keep the last modulated values for the following blocks
+  if(n > 0){
+    if(cutoff){
+      SetFilterCutoff(cutoff[n - 1]);
+    }
+    if(resonance){
+      SetFilterResonance(resonance[n - 1]);
+    }
+  }
+}
+
+void Ladder::ProcessBlockTaps(const float* in, float* const* outputs, int n){
+  ProcessBlockTaps(in, outputs, n, NULL, NULL);
+}
+
+void Ladder::ProcessBlockTaps(const float* in, float* const* outputs, int n, const float* cutoff, const float* resonance){
+  // taps without a decimator are skipped
+  float* enabled[FILTER_TAPS];
+  taps->EnabledTaps(outputs, enabled);
+
+  (this->*tapsKernel)(in, enabled, n, cutoff, resonance);
+
+  // keep the last modulated values for the following blocks
+  if(n > 0){
+    if(cutoff){
+      SetFilterCutoff(cutoff[n - 1]);
+    }
+    if(resonance){
+      SetFilterResonance(resonance[n - 1]);
+    }
+  }
+}
+
+template <LadderIntegrationMethod method, LadderFilterMode mode, bool multiOutput, int oversampling>
+void Ladder::ProcessBlockKernel(const float* in, float* const* outputs, int n, const float* cutoff, const float* resonance){
+  // nothing to filter, the modulation buffers may be empty
+  if(n <= 0){
+    return;
+  }
+
+  // oversampling factor is a compile time constant unless zero
+  const int factor = oversampling ? oversampling : oversamplingFactor;
+
+  // resampler, tanh approximant and antialiasing are fixed over the block
+  const bool halfbandResampler = this->halfbandResampler;
+  const FastmathApproximation approximation = this->approximation;
+  const FastmathRuntime approximant = {approximation};
+  const FastmathADAARuntime antialiased = {approximation};
+  const bool antialiasing = this->antialiasing;
+
+  // oversampled input and output of the half-band resampler
+  float upsampled[HALFBAND_MAX_FACTOR];
+  float decimated[HALFBAND_MAX_FACTOR];
+
+  // oversampled output collected for the block decimation filter
+  float oversampled[IIR_BLOCK_SIZE];
+  int pending = 0;
+
+  // single output, or one output per tap
+  float* output = outputs[0];
+
+  // response weights of the morph tap, the saturated highpass response is
+  // only computed when a tap needs it
+  const FilterMorph morph = FilterMorphWeights(this->morph);
+  const bool highpass = multiOutput && (outputs[FILTER_TAP_HIGHPASS] ||
+						     (outputs[FILTER_TAP_MORPH] && morph.highpass != 0.f));
+
+  // update derived constants after a parameter change
+  if(coefficientsDirty){
+    UpdateFilterCoefficients();
+  }
+
+  // derived constants, kept in registers over the block
+  LadderCoefficients coefficients = this->coefficients;
+  float dt = this->dt;
+
+  // feedback amount
+  float fb = coefficients.fb;
+
+  // integration rate per unit cutoff for the modulation buffers
+  float rate = cutoff ? 44100.f / (sampleRate * (float)(factor)) : 0.f;
+
+  // keep filter state in registers over the block
+  NoiseGenerator dither = this->dither;
+  float p0 = this->p0;
+  float p1 = this->p1;
+  float p2 = this->p2;
+  float p3 = this->p3;
+  float ut_1 = this->ut_1;
+  float xk_t1 = this->xk_t1;
+  float xk_t2 = this->xk_t2;
+  float out = this->out;
+  ADAAState driveState = this->driveState;
+  ADAAState delayedDriveState = this->delayedDriveState;
+  ADAAState outputState = this->outputState;
+
+  for(int i = 0; i < n; i++){
+    float input = in[i];
+
+    // derive the constants of this sample from the modulation buffers,
+    // held values keep the constants of the sample before
+    if((cutoff && (i == 0 || cutoff[i] != cutoff[i - 1])) ||
+       (resonance && (i == 0 || resonance[i] != resonance[i - 1]))){
+      if(cutoff){
+	dt = LadderClampIntegrationRate(rate*cutoff[i]);
       }
-      break;
+
+      LadderDeriveCoefficients(coefficients, dt, resonance ? resonance[i] : Resonance);
+      fb = coefficients.fb;
+    }
+
+    // add dither
+    input += dither.NoiseSample(1.0e-6f);
+
+    // interpolate input to the oversampled rate
+    if(halfbandResampler){
+      halfband->Upsample(input, upsampled);
+    }
+
+    // integrate filter state
+    // with oversampling
+    for(int nn = 0; nn < factor; nn++){
+      // oversampled input, held over the substeps without the half-band chain
+      float u = halfbandResampler ? upsampled[nn] : input;
+
+      // integration method and filter mode are compile time constants
+      switch(method){
+      case LADDER_EULER_FULL_TANH:
+	// semi-implicit euler integration
+	// with full tanh stages
+	{
+	  float drive = antialiasing ? antialiased.Tanh(driveState, u - fb*p3) : approximant.Tanh(u - fb*p3);
+
+	  p0 = p0 + dt*(drive - approximant.Tanh(p0));
+	  p1 = p1 + dt*(approximant.Tanh(p0) - approximant.Tanh(p1));
+	  p2 = p2 + dt*(approximant.Tanh(p1) - approximant.Tanh(p2));
+	  p3 = p3 + dt*(approximant.Tanh(p2) - approximant.Tanh(p3));
+	}
+	break;
       
-    case LADDER_PREDICTOR_CORRECTOR_FULL_TANH:
-      // predictor-corrector integration
-      // with full tanh stages
-      {
-	float p0_prime, p1_prime, p2_prime, p3_prime, p3t_1;
-
-	// predictor
-	p0_prime = p0 + dt*(TanhPade32(ut_1 - fb*p3) - TanhPade32(p0));
-	p1_prime = p1 + dt*(TanhPade32(p0) - TanhPade32(p1));
-	p2_prime = p2 + dt*(TanhPade32(p1) - TanhPade32(p2));
-	p3_prime = p3 + dt*(TanhPade32(p2) - TanhPade32(p3));
-
-	// corrector
-	p3t_1 = p3;
-	p3 = p3 + 0.5*dt*((TanhPade32(p2) - TanhPade32(p3)) + (TanhPade32(p2_prime) - TanhPade32(p3_prime)));
-	p2 = p2 + 0.5*dt*((TanhPade32(p1) - TanhPade32(p2)) + (TanhPade32(p1_prime) - TanhPade32(p2_prime)));
-	p1 = p1 + 0.5*dt*((TanhPade32(p0) - TanhPade32(p1)) + (TanhPade32(p0_prime) - TanhPade32(p1_prime)));
-	p0 = p0 + 0.5*dt*((TanhPade32(ut_1 - fb*p3t_1) - TanhPade32(p0)) + (TanhPade32(input - fb*p3) - TanhPade32(p0_prime)));
-      }
-      break;
+      case LADDER_PREDICTOR_CORRECTOR_FULL_TANH:
+	// predictor-corrector integration
+	// with full tanh stages
+	{
+	  float p0_prime, p1_prime, p2_prime, p3_prime, drive, drive_t1;
+
+	  // predictor
+	  drive_t1 = antialiasing ? antialiased.Tanh(delayedDriveState, ut_1 - fb*p3) : approximant.Tanh(ut_1 - fb*p3);
+	  p0_prime = p0 + dt*(drive_t1 - approximant.Tanh(p0));
+	  p1_prime = p1 + dt*(approximant.Tanh(p0) - approximant.Tanh(p1));
+	  p2_prime = p2 + dt*(approximant.Tanh(p1) - approximant.Tanh(p2));
+	  p3_prime = p3 + dt*(approximant.Tanh(p2) - approximant.Tanh(p3));
+
+	  // corrector, reusing the predictor drive at t-1
+	  p3 = p3 + 0.5f*dt*((approximant.Tanh(p2) - approximant.Tanh(p3)) + (approximant.Tanh(p2_prime) - approximant.Tanh(p3_prime)));
+	  p2 = p2 + 0.5f*dt*((approximant.Tanh(p1) - approximant.Tanh(p2)) + (approximant.Tanh(p1_prime) - approximant.Tanh(p2_prime)));
+	  p1 = p1 + 0.5f*dt*((approximant.Tanh(p0) - approximant.Tanh(p1)) + (approximant.Tanh(p0_prime) - approximant.Tanh(p1_prime)));
+	  drive = antialiasing ? antialiased.Tanh(driveState, u - fb*p3) : approximant.Tanh(u - fb*p3);
+	  p0 = p0 + 0.5f*dt*((drive_t1 - approximant.Tanh(p0)) + (drive - approximant.Tanh(p0_prime)));
+	}
+	break;
       
-    case LADDER_PREDICTOR_CORRECTOR_FEEDBACK_TANH:
-      // predictor-corrector integration
-      // with feedback tanh stage only
-      {
-	float p0_prime, p1_prime, p2_prime, p3_prime, p3t_1;
-
-	// predictor
-	p0_prime = p0 + dt*(TanhPade32(ut_1 - fb*p3) - p0);
-	p1_prime = p1 + dt*(p0 - p1);
-	p2_prime = p2 + dt*(p1 - p2);
-	p3_prime = p3 + dt*(p2 - p3);
-
-	// corrector
-	p3t_1 = p3;
-	p3 = p3 + 0.5*dt*((p2 - p3) + (p2_prime - p3_prime));
-	p2 = p2 + 0.5*dt*((p1 - p2) + (p1_prime - p2_prime));
-	p1 = p1 + 0.5*dt*((p0 - p1) + (p0_prime - p1_prime));
-	p0 = p0 + 0.5*dt*((TanhPade32(ut_1 - fb*p3t_1) - p0) +
-			  (TanhPade32(input - fb*p3) - p0_prime));
-      }
-      break;
+      case LADDER_PREDICTOR_CORRECTOR_FEEDBACK_TANH:
+	// predictor-corrector integration
+	// with feedback tanh stage only
+	{
+	  float p0_prime, p1_prime, p2_prime, p3_prime, drive, drive_t1;
+
+	  // predictor
+	  drive_t1 = antialiasing ? antialiased.Tanh(delayedDriveState, ut_1 - fb*p3) : approximant.Tanh(ut_1 - fb*p3);
+	  p0_prime = p0 + dt*(drive_t1 - p0);
+	  p1_prime = p1 + dt*(p0 - p1);
+	  p2_prime = p2 + dt*(p1 - p2);
+	  p3_prime = p3 + dt*(p2 - p3);
+
+	  // corrector, reusing the predictor drive at t-1
+	  p3 = p3 + 0.5f*dt*((p2 - p3) + (p2_prime - p3_prime));
+	  p2 = p2 + 0.5f*dt*((p1 - p2) + (p1_prime - p2_prime));
+	  p1 = p1 + 0.5f*dt*((p0 - p1) + (p0_prime - p1_prime));
+	  drive = antialiasing ? antialiased.Tanh(driveState, u - fb*p3) : approximant.Tanh(u - fb*p3);
+	  p0 = p0 + 0.5f*dt*((drive_t1 - p0) + (drive - p0_prime));
+	}
+	break;
       
-    case LADDER_TRAPEZOIDAL_FEEDBACK_TANH:
-      // implicit trapezoidal integration
-      // with feedback tanh stage only
-      {
-	float x_k, x_k2, g, b, c, C_t, D_t, ut, ut_2;
-	float p0_prime, p1_prime, p2_prime, p3_prime;
-
-	ut = TanhPade32(ut_1 - fb*p3);
-    	b = (0.5*dt)/(1.0 + 0.5*dt);
-	c = (1.0 - 0.5*dt)/(1.0 + 0.5*dt);
-	g = -fb*b*b*b*b;
-	x_k = ut;
-	D_t = c*p3 + (b + c*b)*p2 + (b*b+b*b*c)*p1 +
-	               (b*b*b+b*b*b*c)*p0 + b*b*b*b*ut;
-	C_t = TanhPade32(input - fb*D_t);
-
-	// newton-raphson 
-	for(int ii=0; ii < 8; ii++) {
-	  float tanh_g_xk, tanh_g_xk2;
-	  
-	  tanh_g_xk = TanhPade32(g*x_k);
-	  tanh_g_xk2 = g*(1.0 - TanhPade32(g*x_k)*TanhPade32(g*x_k));
-	  
-	  x_k2 = x_k - (x_k + x_k*tanh_g_xk*C_t - tanh_g_xk - C_t) /
-	                 (1.0 + C_t*(tanh_g_xk + x_k*tanh_g_xk2) - tanh_g_xk2);
-	  
-	  // breaking limit
-	  if(abs(x_k2 - x_k) < 1.0e-9) {
-	    x_k = x_k2;
-	    break;
+      case LADDER_TRAPEZOIDAL_FEEDBACK_TANH:
+	// implicit trapezoidal integration
+	// with feedback tanh stage only
+	{
+	  float b = coefficients.b;
+	  float c = coefficients.c;
+	  float C_t, D_t, ut, ut_2;
+	  float p0_prime, p1_prime, p2_prime, p3_prime;
+
+	  ut = antialiasing ? antialiased.Tanh(delayedDriveState, ut_1 - fb*p3) : approximant.Tanh(ut_1 - fb*p3);
+	  D_t = c*p3 + coefficients.dp2*p2 + coefficients.dp1*p1 +
+	                 coefficients.dp0*p0 + coefficients.dut*ut;
+	  C_t = antialiasing ? antialiased.Tanh(driveState, u - fb*D_t) : approximant.Tanh(u - fb*D_t);
+
+	  // newton-raphson from the extrapolated previous solutions
+	  NewtonResult nr = LadderTrapezoidalSolve(approximation, newtonStep, coefficients.g, C_t, NewtonExtrapolate(xk_t1, xk_t2),
+						   NEWTON_TOLERANCE*(1.f + fabsf(C_t)), newtonStats != NULL);
+	  ut_2 = nr.x;
+
+	  xk_t2 = xk_t1;
+	  xk_t1 = ut_2;
+
+	  if(newtonStats){
+	    newtonStats->AddSolve(nr);
 	  }
-	  
-	  x_k = x_k2;
+
+	  p0_prime = p0;
+	  p1_prime = p1;
+	  p2_prime = p2;
+	  p3_prime = p3;
+
+	  p0 = c*p0_prime + b*(ut + ut_2);
+	  p1 = c*p1_prime + b*(p0_prime + p0);
+	  p2 = c*p2_prime + b*(p1_prime + p1);
+	  p3 = c*p3_prime + b*(p2_prime + p2);
 	}
-	
-	ut_2 = x_k;
-
-	p0_prime = p0;
-	p1_prime = p1;
-	p2_prime = p2;
-	p3_prime = p3;
-
-	p0 = c*p0_prime + b*(ut + ut_2);
-	p1 = c*p1_prime + b*(p0_prime + p0);
-	p2 = c*p2_prime + b*(p1_prime + p1);
-	p3 = c*p3_prime + b*(p2_prime + p2);
-      }
-      break;
+	break;
       
-    default:
-      break;
+      default:
+	break;
+      }
+
+      // input at t-1
+      ut_1 = u;
+
+      // taps are decimated on their own
+      if(!multiOutput){
+	switch(mode){
+	case LADDER_LOWPASS_MODE:
+	  out = p3;
+	  break;
+	case LADDER_BANDPASS_MODE:
+	  out = p1 - p3;
+	  break;
+	case LADDER_HIGHPASS_MODE:
+	  out = antialiasing ? antialiased.Tanh(outputState, u - p0 - fb*p3) : approximant.Tanh(u - p0 - fb*p3);
+	  break;
+	default:
+	  out = 0.f;
+	}
+      }
+
+      // downsampling filter
+      if(multiOutput){
+	float hp = 0.f;
+
+	if(highpass){
+	  hp = antialiasing ? antialiased.Tanh(outputState, u - p0 - fb*p3) : approximant.Tanh(u - p0 - fb*p3);
+	}
+
+	float response[FILTER_TAPS] = {p3, p1 - p3, hp, morph.lowpass*p3 + morph.bandpass*(p1 - p3) + morph.highpass*hp};
+
+	taps->Substep(outputs, response, factor, pending, nn, halfbandResampler);
+      }
+      else if(halfbandResampler){
+	decimated[nn] = out;
+      }
+      else if(factor > IIR_BLOCK_SIZE){
+	out = iir->IIRfilter(out);
+      }
+      else if(factor > 1){
+	oversampled[pending*factor + nn] = out;
+      }
     }
 
-    // input at t-1
-    ut_1 = input;
-
-    //switch filter mode
-    switch(filterMode){
-    case LADDER_LOWPASS_MODE:
-      out = p3;
-      break;
-    case LADDER_BANDPASS_MODE:
-      out = p1 - p3;
-      break;
-    case LADDER_HIGHPASS_MODE:
-      out = TanhPade32(input - p0 - fb*p3);
-      break;
-    default:
-      out = 0.0;
+    // decimate output to the base rate
+    if(multiOutput){
+      taps->Decimate(outputs, factor, pending, i, n, halfbandResampler);
     }
+    else if(halfbandResampler){
+      out = halfband->Downsample(decimated);
+    }
+
+    // decimate collected substeps when the buffer is full or the block ends
+    if(!multiOutput && !halfbandResampler && factor > 1 && factor <= IIR_BLOCK_SIZE){
+      pending++;
 
-    // downsampling filter
-    if(oversamplingFactor > 1){
-      out = iir->IIRfilter(out);
+      if((pending + 1)*factor > IIR_BLOCK_SIZE || i == n - 1){
+	iir->IIRfilterBlock(oversampled, pending*factor);
+
+	for(int j = 0; j < pending; j++){
+	  output[i + 1 - pending + j] = oversampled[(j + 1)*factor - 1];
+	}
+
+	out = output[i];
+	pending = 0;
+      }
+    }
+    else if(!multiOutput){
+      output[i] = out;
     }
   }
+
+  // store filter state
+  this->p0 = p0;
+  this->p1 = p1;
+  this->p2 = p2;
+  this->p3 = p3;
+  this->ut_1 = ut_1;
+  this->xk_t1 = xk_t1;
+  this->xk_t2 = xk_t2;
+  this->out = out;
+  this->dither = dither;
+  this->driveState = driveState;
+  this->delayedDriveState = delayedDriveState;
+  this->outputState = outputState;
 }
 
 float Ladder::GetFilterLowpass(){
@@ -322,11 +745,16 @@ float Ladder::GetFilterLowpass(){
 }
 
 float Ladder::GetFilterBandpass(){
-  return 0.0;
+  return p1 - p3;
 }
 
 float Ladder::GetFilterHighpass(){
-  return 0.0;
+  // saturated highpass response of the last substep
+  float x = ut_1 - p0 - 8.f*Resonance*p3;
+
+  FastmathRuntime approximant = {approximation};
+
+  return approximant.Tanh(x);
 }
 
 
@@ -23,6 +23,15 @@
 #define __dspladderh__
 
 #include "iir.h"
+#include "halfband.h"
+#include "noise.h"
+#include "newton.h"
+#include "fastmath.h"
+#include "adaa.h"
+#include "taps.h"
+
+// steepness of downsample filter response, the decimators are sized for it
+#define LADDER_IIR_DOWNSAMPLE_ORDER 8
 
 // filter modes
 enum LadderFilterMode {
@@ -39,6 +48,23 @@ enum LadderIntegrationMethod {
    LADDER_TRAPEZOIDAL_FEEDBACK_TANH
 };
 
+// kernel constants derived from the filter parameters
+struct LadderCoefficients {
+  // feedback amount
+  float fb;
+
+  // trapezoidal stage input and state weights, implicit feedback gain
+  float b;
+  float c;
+  float g;
+
+  // weights of the stage states and the drive in the predicted output
+  float dp0;
+  float dp1;
+  float dp2;
+  float dut;
+};
+
 class Ladder{
 public:
   // constructor/destructor
@@ -54,6 +80,14 @@ public:
   void SetFilterMode(LadderFilterMode newFilterMode);
   void SetFilterSampleRate(float newSampleRate);
   void SetFilterIntegrationMethod(LadderIntegrationMethod method);
+  void SetFilterResampler(ResamplerType newResampler);
+  void SetFilterApproximation(FastmathApproximation newApproximation);
+  void SetFilterNewtonStep(NewtonStep newStep);
+  void SetFilterAntialiasing(bool enable);
+  void SetFilterMorph(float newMorph);
+  void SetFilterNoiseSeed(uint32_t newSeed);
+  void SetFilterTaps(int mask);
+  void SetFilterNewtonStatistics(bool enable);
   
   // get filter parameters
   float GetFilterCutoff();
@@ -62,10 +96,34 @@ public:
   LadderFilterMode GetFilterMode();  
   float GetFilterSampleRate();
   LadderIntegrationMethod GetFilterIntegrationMethod();
+  ResamplerType GetFilterResampler();
+  FastmathApproximation GetFilterApproximation();
+  NewtonStep GetFilterNewtonStep();
+  bool GetFilterAntialiasing();
+  float GetFilterMorph();
+
+  // get newton solver statistics, NULL unless enabled
+  NewtonStatistics* GetFilterNewtonStatistics();
   
   // tick filter state
   void LadderFilter(float input);
 
+  // filter a block of samples, in and out may be the same buffer
+  void ProcessBlock(const float* in, float* out, int n);
+
+  // filter a block with per sample cutoff and resonance, either buffer
+  // may be NULL to keep the set value. parameters end the block at their
+  // last modulated value
+  void ProcessBlock(const float* in, float* out, int n, const float* cutoff, const float* resonance);
+
+  // filter a block into several outputs from one integration pass.
+  // outputs holds a buffer per FilterTap, NULL for the taps that are not
+  // wanted, and every requested tap is decimated on its own. taps are
+  // enabled beforehand with SetFilterTaps(), the buffers of disabled taps
+  // are left untouched
+  void ProcessBlockTaps(const float* in, float* const* outputs, int n);
+  void ProcessBlockTaps(const float* in, float* const* outputs, int n, const float* cutoff, const float* resonance);
+
   // get filter responses
   float GetFilterLowpass();
   float GetFilterBandpass();
@@ -81,6 +139,23 @@ private:
   // set integration rate
   void SetFilterIntegrationRate();
 
+  // recompute the kernel constants, done at the start of a block after
+  // a setter has invalidated them
+  void UpdateFilterCoefficients();
+
+  // select block processing kernel for current settings
+  void SelectKernel();
+
+  // block processing kernel specialized for integration method,
+  // filter mode or all taps and oversampling factor, zero factor is
+  // generic. resampler, approximants and antialiasing are branches fixed
+  // over the block. modulation buffers are NULL for block rate parameters
+  template <LadderIntegrationMethod method, LadderFilterMode mode, bool multiOutput, int oversampling>
+  void ProcessBlockKernel(const float* in, float* const* outputs, int n, const float* cutoff, const float* resonance);
+
+  typedef void (Ladder::*ProcessBlockKernelFn)(const float* in, float* const* outputs, int n,
+					       const float* cutoff, const float* resonance);
+
   // filter parameters
   float cutoffFrequency;
   float Resonance;
@@ -89,16 +164,55 @@ private:
   float sampleRate;
   float dt;
   LadderIntegrationMethod integrationMethod;
+  ResamplerType resamplerType;
+  FastmathApproximation approximation;
+  NewtonStep newtonStep;
+  bool antialiasing;
+  float morph;
+
+  // derived kernel constants and their invalidation flag
+  LadderCoefficients coefficients;
+  bool coefficientsDirty;
   
   // filter state
   float p0, p1, p2, p3;
   float ut_1;
+
+  // previous newton solutions for the warm start
+  float xk_t1;
+  float xk_t2;
+
+  // antiderivative antialiasing state of the drive tanh at t and t-1
+  // and of the highpass output tanh
+  ADAAState driveState;
+  ADAAState delayedDriveState;
+  ADAAState outputState;
   
   // filter output
   float out;
 
+  // selected block processing kernels of the single output and the
+  // multi-output processing
+  ProcessBlockKernelFn kernel;
+  ProcessBlockKernelFn tapsKernel;
+
+  // half-band chain in use, the resampler type for a factor it handles
+  bool halfbandResampler;
+
   // IIR downsampling filter
-  IIRLowpass *iir;
+  FixedIIRLowpass<LADDER_IIR_DOWNSAMPLE_ORDER> *iir;
+
+  // half-band resampler chain
+  HalfbandResampler *halfband;
+
+  // decimators of the multi-output taps
+  FilterTaps<LADDER_IIR_DOWNSAMPLE_ORDER> *taps;
+
+  // anti-denormal dither generator
+  NoiseGenerator dither;
+
+  // newton solver statistics
+  NewtonStatistics *newtonStats;
 };
 
 #endif
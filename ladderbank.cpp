@@ -0,0 +1,588 @@
+/*
+ *  (C) 2021 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Ladder Filter OWL Patch.
+ *
+ *  Ladder Filter OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ladder Filter OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Ladder Filter OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ladderbank.h"
+#include "simdmath.h"
+#include "newton.h"
+
+// downsampling passthrough bandwidth
+#define IIR_DOWNSAMPLING_BANDWIDTH 0.9
+
+// trapezoidal feedback equation x + x*tanh(g*x)*C_t - tanh(g*x) - C_t = 0
+// per lane
+template <FastmathApproximation approximation>
+struct LadderTrapezoidalLanesResidual {
+  SIMDFloat g, C_t;
+
+  inline void Evaluate(SIMDFloat x, SIMDFloat& f, SIMDFloat& df, SIMDFloat& d2f) const {
+    // tanh and its first two derivatives
+    SIMDFloat t = SIMDFastmath<approximation>::Tanh(g*x);
+    SIMDFloat t1 = g*(1.f - t*t);
+    SIMDFloat t2 = -2.f*g*t*t1;
+
+    f = x + x*t*C_t - t - C_t;
+    df = 1.f + C_t*(t + x*t1) - t1;
+    d2f = C_t*(2.f*t1 + x*t2) - t2;
+  }
+};
+
+// lane masked newton-raphson solve of the trapezoidal feedback equation
+// from x, the approximant branch is taken once per solve rather than
+// once per evaluation
+static inline NewtonLanesResult LadderTrapezoidalLanesSolve(FastmathApproximation approximation, NewtonStep step,
+							    SIMDFloat g, SIMDFloat C_t,
+							    SIMDFloat x, SIMDFloat tolerance, bool report){
+  if(approximation == FASTMATH_MINIMAX){
+    LadderTrapezoidalLanesResidual<FASTMATH_MINIMAX> residual = {g, C_t};
+    return NewtonSolveLanes<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+  }
+
+  LadderTrapezoidalLanesResidual<FASTMATH_PADE> residual = {g, C_t};
+  return NewtonSolveLanes<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+}
+
+// constructor
+LadderBank::LadderBank(int newVoices, float newCutoff, float newResonance, int newOversamplingFactor,
+		       LadderFilterMode newFilterMode, float newSampleRate, LadderIntegrationMethod newIntegrationMethod){
+  Initialize(newVoices, newCutoff, newResonance, newOversamplingFactor,
+	     newFilterMode, newSampleRate, newIntegrationMethod);
+}
+
+// default parameter constructor
+LadderBank::LadderBank(int newVoices){
+  Initialize(newVoices, 0.25, 0.5, 2, LADDER_LOWPASS_MODE, 44100.0, LADDER_PREDICTOR_CORRECTOR_FULL_TANH);
+}
+
+// destructor
+LadderBank::~LadderBank(){
+  delete[] cutoffFrequency;
+  delete[] Resonance;
+  delete[] dt;
+  delete[] p0;
+  delete[] p1;
+  delete[] p2;
+  delete[] p3;
+  delete[] ut_1;
+  delete[] xk_t1;
+  delete[] xk_t2;
+  delete[] driveState;
+  delete[] delayedDriveState;
+  delete[] outputState;
+  delete iir;
+  delete newtonStats;
+}
+
+void LadderBank::Initialize(int newVoices, float newCutoff, float newResonance, int newOversamplingFactor,
+			    LadderFilterMode newFilterMode, float newSampleRate, LadderIntegrationMethod newIntegrationMethod){
+  voices = newVoices;
+  groups = SIMDGroups(voices);
+
+  // allocate per voice vectors padded to whole vector groups
+  int lanes = groups*SIMD_WIDTH;
+  cutoffFrequency = new float[lanes];
+  Resonance = new float[lanes];
+  dt = new float[lanes];
+  p0 = new float[lanes];
+  p1 = new float[lanes];
+  p2 = new float[lanes];
+  p3 = new float[lanes];
+  ut_1 = new float[lanes];
+  xk_t1 = new float[lanes];
+  xk_t2 = new float[lanes];
+  driveState = new ADAAState[lanes];
+  delayedDriveState = new ADAAState[lanes];
+  outputState = new ADAAState[lanes];
+
+  // initialize filter parameters
+  oversamplingFactor = newOversamplingFactor;
+  filterMode = newFilterMode;
+  sampleRate = newSampleRate;
+  integrationMethod = newIntegrationMethod;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+  antialiasing = false;
+
+  for(int v=0; v<lanes; v++){
+    cutoffFrequency[v] = newCutoff;
+    Resonance[v] = newResonance;
+    SetFilterIntegrationRate(v);
+
+    // initialize filter state
+    p0[v] = p1[v] = p2[v] = p3[v] = ut_1[v] = 0.0;
+    xk_t1[v] = xk_t2[v] = 0.0;
+    ResetADAAState(driveState[v]);
+    ResetADAAState(delayedDriveState[v]);
+    ResetADAAState(outputState[v]);
+  }
+
+  SelectKernel();
+
+  // instantiate downsampling filters
+  iir = new IIRLowpassBank(voices, sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, LADDER_IIR_DOWNSAMPLE_ORDER);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
+}
+
+void LadderBank::ResetFilterState(){
+  for(int v=0; v<groups*SIMD_WIDTH; v++){
+    // initialize filter parameters
+    cutoffFrequency[v] = 0.25;
+    Resonance[v] = 0.0;
+    SetFilterIntegrationRate(v);
+
+    // initialize filter state
+    p0[v] = p1[v] = p2[v] = p3[v] = ut_1[v] = 0.0;
+    xk_t1[v] = xk_t2[v] = 0.0;
+    ResetADAAState(driveState[v]);
+    ResetADAAState(delayedDriveState[v]);
+    ResetADAAState(outputState[v]);
+  }
+
+  // set oversampling
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+}
+
+void LadderBank::SetFilterCutoff(int voice, float newCutoff){
+  cutoffFrequency[voice] = newCutoff;
+
+  SetFilterIntegrationRate(voice);
+}
+
+void LadderBank::SetFilterResonance(int voice, float newResonance){
+  Resonance[voice] = newResonance;
+}
+
+void LadderBank::SetFilterOversamplingFactor(int newOversamplingFactor){
+  oversamplingFactor = newOversamplingFactor;
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+
+  for(int v=0; v<voices; v++){
+    SetFilterIntegrationRate(v);
+  }
+  SelectKernel();
+}
+
+void LadderBank::SetFilterMode(LadderFilterMode newFilterMode){
+  filterMode = newFilterMode;
+  SelectKernel();
+}
+
+void LadderBank::SetFilterSampleRate(float newSampleRate){
+  sampleRate = newSampleRate;
+  iir->SetFilterParameters(sampleRate * (float)(oversamplingFactor), IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+
+  for(int v=0; v<voices; v++){
+    SetFilterIntegrationRate(v);
+  }
+}
+
+void LadderBank::SetFilterIntegrationMethod(LadderIntegrationMethod method){
+  integrationMethod = method;
+  SelectKernel();
+}
+
+void LadderBank::SetFilterApproximation(FastmathApproximation newApproximation){
+  approximation = newApproximation;
+}
+
+void LadderBank::SetFilterNewtonStep(NewtonStep newStep){
+  newtonStep = newStep;
+}
+
+void LadderBank::SetFilterAntialiasing(bool enable){
+  antialiasing = enable;
+
+  // antialiased nonlinearities start from a fresh segment
+  for(int v=0; v<groups*SIMD_WIDTH; v++){
+    ResetADAAState(driveState[v]);
+    ResetADAAState(delayedDriveState[v]);
+    ResetADAAState(outputState[v]);
+  }
+}
+
+void LadderBank::SetFilterNoiseSeed(uint32_t newSeed){
+  dither.SetNoiseSeed(newSeed);
+}
+
+void LadderBank::SetFilterNewtonStatistics(bool enable){
+  if(enable && newtonStats == NULL){
+    newtonStats = new NewtonStatistics();
+  }
+  else if(!enable){
+    delete newtonStats;
+    newtonStats = NULL;
+  }
+}
+
+void LadderBank::SetFilterIntegrationRate(int voice){
+  // normalize cutoff freq to samplerate
+  dt[voice] = 44100.0 / (sampleRate * oversamplingFactor) * cutoffFrequency[voice];
+
+  // clamp integration rate
+  if(dt[voice] < 0.0){
+    dt[voice] = 0.0;
+  }
+  else if(dt[voice] > 0.85){
+    dt[voice] = 0.85;
+  }
+}
+
+// kernel table entries for the specialized oversampling factors
+#define LADDER_BANK_KERNEL_ROW(method, mode) \
+  {&LadderBank::ProcessBlockKernel<method, mode, 0>, \
+   &LadderBank::ProcessBlockKernel<method, mode, 1>, \
+   &LadderBank::ProcessBlockKernel<method, mode, 2>, \
+   &LadderBank::ProcessBlockKernel<method, mode, 4>, \
+   &LadderBank::ProcessBlockKernel<method, mode, 8>}
+
+#define LADDER_BANK_KERNEL_MODES(method) \
+  {LADDER_BANK_KERNEL_ROW(method, LADDER_LOWPASS_MODE), \
+   LADDER_BANK_KERNEL_ROW(method, LADDER_BANDPASS_MODE), \
+   LADDER_BANK_KERNEL_ROW(method, LADDER_HIGHPASS_MODE)}
+
+void LadderBank::SelectKernel(){
+  static const ProcessBlockKernelFn kernels[4][3][5] = {
+    LADDER_BANK_KERNEL_MODES(LADDER_EULER_FULL_TANH),
+    LADDER_BANK_KERNEL_MODES(LADDER_PREDICTOR_CORRECTOR_FULL_TANH),
+    LADDER_BANK_KERNEL_MODES(LADDER_PREDICTOR_CORRECTOR_FEEDBACK_TANH),
+    LADDER_BANK_KERNEL_MODES(LADDER_TRAPEZOIDAL_FEEDBACK_TANH)
+  };
+
+  // specialized oversampling factors, other factors use the generic kernel
+  int os;
+  switch(oversamplingFactor){
+  case 1:
+    os = 1;
+    break;
+  case 2:
+    os = 2;
+    break;
+  case 4:
+    os = 3;
+    break;
+  case 8:
+    os = 4;
+    break;
+  default:
+    os = 0;
+  }
+
+  kernel = kernels[integrationMethod][filterMode][os];
+}
+
+int LadderBank::GetFilterVoices(){
+  return voices;
+}
+
+float LadderBank::GetFilterCutoff(int voice){
+  return cutoffFrequency[voice];
+}
+
+float LadderBank::GetFilterResonance(int voice){
+  return Resonance[voice];
+}
+
+int LadderBank::GetFilterOversamplingFactor(){
+  return oversamplingFactor;
+}
+
+LadderFilterMode LadderBank::GetFilterMode(){
+  return filterMode;
+}
+
+float LadderBank::GetFilterSampleRate(){
+  return sampleRate;
+}
+
+LadderIntegrationMethod LadderBank::GetFilterIntegrationMethod(){
+  return integrationMethod;
+}
+
+FastmathApproximation LadderBank::GetFilterApproximation(){
+  return approximation;
+}
+
+NewtonStep LadderBank::GetFilterNewtonStep(){
+  return newtonStep;
+}
+
+bool LadderBank::GetFilterAntialiasing(){
+  return antialiasing;
+}
+
+NewtonStatistics* LadderBank::GetFilterNewtonStatistics(){
+  return newtonStats;
+}
+
+void LadderBank::ProcessBlock(const float* const* in, float* const* out, int n){
+  (this->*kernel)(in, out, n, NULL, NULL);
+}
+
+void LadderBank::ProcessBlock(const float* const* in, float* const* out, int n,
+			      const float* const* cutoff, const float* const* resonance){
+  (this->*kernel)(in, out, n, cutoff, resonance);
+
+  // keep the last modulated values for the following blocks
+  if(n > 0){
+    for(int v=0; v<voices; v++){
+      if(cutoff){
+	SetFilterCutoff(v, cutoff[v][n - 1]);
+      }
+      if(resonance){
+	SetFilterResonance(v, resonance[v][n - 1]);
+      }
+    }
+  }
+}
+
+template <LadderIntegrationMethod method, LadderFilterMode mode, int oversampling>
+void LadderBank::ProcessBlockKernel(const float* const* in, float* const* out, int n,
+				    const float* const* cutoff, const float* const* resonance){
+  // approximants and antialiasing are fixed over the block
+  const FastmathApproximation approximation = this->approximation;
+  const SIMDFastmathRuntime approximant = {approximation};
+  const SIMDFastmathADAARuntime antialiased = {approximation};
+  const bool antialiasing = this->antialiasing;
+
+  // oversampling factor is a compile time constant unless zero
+  const int factor = oversampling ? oversampling : oversamplingFactor;
+
+  // integration rate per unit cutoff for the modulation buffers
+  const float rate = 44100.f / (sampleRate * (float)(factor));
+
+  // per sample integration rates and resonances of a voice group
+  float rates[SIMD_WIDTH];
+  float resonances[SIMD_WIDTH];
+
+  // lane transpose buffer
+  float lanes[SIMD_WIDTH];
+
+  // dither of one sample of every lane
+  float noise[SIMD_WIDTH];
+
+  for(int g = 0; g < groups; g++){
+    int base = g*SIMD_WIDTH;
+    int active = voices - base < SIMD_WIDTH ? voices - base : SIMD_WIDTH;
+
+    // per voice block constants
+    SIMDFloat dtv = SIMDLoad(dt + base);
+    SIMDFloat fb = 8.f*SIMDLoad(Resonance + base);
+    SIMDFloat hdt = 0.5f*dtv;
+
+    // trapezoidal integration weights
+    SIMDFloat b = hdt/(1.f + hdt);
+    SIMDFloat c = (1.f - hdt)/(1.f + hdt);
+    SIMDFloat b2 = b*b;
+    SIMDFloat b3 = b2*b;
+    SIMDFloat b4 = b2*b2;
+    SIMDFloat g_t = -fb*b4;
+    SIMDFloat w2 = b + c*b;
+    SIMDFloat w1 = b2 + b2*c;
+    SIMDFloat w0 = b3 + b3*c;
+
+    // keep voice state in registers over the block
+    SIMDFloat p0v = SIMDLoad(p0 + base);
+    SIMDFloat p1v = SIMDLoad(p1 + base);
+    SIMDFloat p2v = SIMDLoad(p2 + base);
+    SIMDFloat p3v = SIMDLoad(p3 + base);
+    SIMDFloat ut_1v = SIMDLoad(ut_1 + base);
+    SIMDFloat xk_t1v = SIMDLoad(xk_t1 + base);
+    SIMDFloat xk_t2v = SIMDLoad(xk_t2 + base);
+    SIMDFloat outv = 0.f;
+
+    // antialiasing state of the group lanes
+    ADAAState *drive = driveState + base;
+    ADAAState *delayedDrive = delayedDriveState + base;
+    ADAAState *output = outputState + base;
+
+    for(int i = 0; i < n; i++){
+      // derive the constants of this sample from the modulation buffers,
+      // padding lanes keep their set values
+      if(cutoff || resonance){
+	for(int l = 0; l < SIMD_WIDTH; l++){
+	  rates[l] = cutoff && l < active ? rate*cutoff[base + l][i] : dt[base + l];
+	  resonances[l] = resonance && l < active ? resonance[base + l][i] : Resonance[base + l];
+	}
+
+	dtv = SIMDMin(SIMDMax(SIMDLoad(rates), 0.f), 0.85f);
+	fb = 8.f*SIMDLoad(resonances);
+	hdt = 0.5f*dtv;
+
+	SIMDFloat r = 1.f/(1.f + hdt);
+	b = hdt*r;
+	c = (1.f - hdt)*r;
+	b2 = b*b;
+	b3 = b2*b;
+	b4 = b2*b2;
+	g_t = -fb*b4;
+	w2 = b + c*b;
+	w1 = b2 + b2*c;
+	w0 = b3 + b3*c;
+      }
+
+      // gather voice inputs with dither
+      dither.NoiseBlock(noise, SIMD_WIDTH, 1.0e-6f);
+      for(int l = 0; l < SIMD_WIDTH; l++){
+	lanes[l] = l < active ? in[base + l][i] + noise[l] : 0.f;
+      }
+      SIMDFloat input = SIMDLoad(lanes);
+
+      // integrate filter state
+      // with oversampling
+      for(int nn = 0; nn < factor; nn++){
+	// integration method and filter mode are compile time constants
+	switch(method){
+	case LADDER_EULER_FULL_TANH:
+	  // semi-implicit euler integration
+	  // with full tanh stages
+	  {
+	    SIMDFloat drive_t = antialiasing ? antialiased.Tanh(drive, input - fb*p3v) : approximant.Tanh(input - fb*p3v);
+
+	    p0v = p0v + dtv*(drive_t - approximant.Tanh(p0v));
+	    p1v = p1v + dtv*(approximant.Tanh(p0v) - approximant.Tanh(p1v));
+	    p2v = p2v + dtv*(approximant.Tanh(p1v) - approximant.Tanh(p2v));
+	    p3v = p3v + dtv*(approximant.Tanh(p2v) - approximant.Tanh(p3v));
+	  }
+	  break;
+
+	case LADDER_PREDICTOR_CORRECTOR_FULL_TANH:
+	  // predictor-corrector integration
+	  // with full tanh stages
+	  {
+	    SIMDFloat t0 = approximant.Tanh(p0v);
+	    SIMDFloat t1 = approximant.Tanh(p1v);
+	    SIMDFloat t2 = approximant.Tanh(p2v);
+	    SIMDFloat t3 = approximant.Tanh(p3v);
+	    SIMDFloat p0_prime, p1_prime, p2_prime, p3_prime, drive_t, drive_t1;
+
+	    // predictor
+	    drive_t1 = antialiasing ? antialiased.Tanh(delayedDrive, ut_1v - fb*p3v) : approximant.Tanh(ut_1v - fb*p3v);
+	    p0_prime = p0v + dtv*(drive_t1 - t0);
+	    p1_prime = p1v + dtv*(t0 - t1);
+	    p2_prime = p2v + dtv*(t1 - t2);
+	    p3_prime = p3v + dtv*(t2 - t3);
+
+	    // corrector, reusing the predictor drive at t-1
+	    p3v = p3v + hdt*((t2 - t3) + (approximant.Tanh(p2_prime) - approximant.Tanh(p3_prime)));
+	    p2v = p2v + hdt*((t1 - t2) + (approximant.Tanh(p1_prime) - approximant.Tanh(p2_prime)));
+	    p1v = p1v + hdt*((t0 - t1) + (approximant.Tanh(p0_prime) - approximant.Tanh(p1_prime)));
+	    drive_t = antialiasing ? antialiased.Tanh(drive, input - fb*p3v) : approximant.Tanh(input - fb*p3v);
+	    p0v = p0v + hdt*((drive_t1 - t0) + (drive_t - approximant.Tanh(p0_prime)));
+	  }
+	  break;
+
+	case LADDER_PREDICTOR_CORRECTOR_FEEDBACK_TANH:
+	  // predictor-corrector integration
+	  // with feedback tanh stage only
+	  {
+	    SIMDFloat p0_prime, p1_prime, p2_prime, p3_prime, drive_t, drive_t1;
+
+	    // predictor
+	    drive_t1 = antialiasing ? antialiased.Tanh(delayedDrive, ut_1v - fb*p3v) : approximant.Tanh(ut_1v - fb*p3v);
+	    p0_prime = p0v + dtv*(drive_t1 - p0v);
+	    p1_prime = p1v + dtv*(p0v - p1v);
+	    p2_prime = p2v + dtv*(p1v - p2v);
+	    p3_prime = p3v + dtv*(p2v - p3v);
+
+	    // corrector, reusing the predictor drive at t-1
+	    p3v = p3v + hdt*((p2v - p3v) + (p2_prime - p3_prime));
+	    p2v = p2v + hdt*((p1v - p2v) + (p1_prime - p2_prime));
+	    p1v = p1v + hdt*((p0v - p1v) + (p0_prime - p1_prime));
+	    drive_t = antialiasing ? antialiased.Tanh(drive, input - fb*p3v) : approximant.Tanh(input - fb*p3v);
+	    p0v = p0v + hdt*((drive_t1 - p0v) + (drive_t - p0_prime));
+	  }
+	  break;
+
+	case LADDER_TRAPEZOIDAL_FEEDBACK_TANH:
+	  // implicit trapezoidal integration
+	  // with feedback tanh stage only
+	  {
+	    SIMDFloat ut = antialiasing ? antialiased.Tanh(delayedDrive, ut_1v - fb*p3v) : approximant.Tanh(ut_1v - fb*p3v);
+	    SIMDFloat D_t = c*p3v + w2*p2v + w1*p1v + w0*p0v + b4*ut;
+	    SIMDFloat C_t = antialiasing ? antialiased.Tanh(drive, input - fb*D_t) : approximant.Tanh(input - fb*D_t);
+	    // lane masked newton-raphson from the extrapolated previous solutions
+	    NewtonLanesResult nr = LadderTrapezoidalLanesSolve(approximation, newtonStep, g_t, C_t, NewtonExtrapolate(xk_t1v, xk_t2v),
+							       NEWTON_TOLERANCE*(1.f + SIMDAbs(C_t)), newtonStats != NULL);
+	    SIMDFloat x_k = nr.x;
+
+	    xk_t2v = xk_t1v;
+	    xk_t1v = x_k;
+
+	    if(newtonStats){
+	      newtonStats->AddLaneSolves(nr, active);
+	    }
+
+	    SIMDFloat p0_prime = p0v;
+	    SIMDFloat p1_prime = p1v;
+	    SIMDFloat p2_prime = p2v;
+
+	    p0v = c*p0v + b*(ut + x_k);
+	    p1v = c*p1v + b*(p0_prime + p0v);
+	    p2v = c*p2v + b*(p1_prime + p1v);
+	    p3v = c*p3v + b*(p2_prime + p2v);
+	  }
+	  break;
+
+	default:
+	  break;
+	}
+
+	// input at t-1
+	ut_1v = input;
+
+	switch(mode){
+	case LADDER_LOWPASS_MODE:
+	  outv = p3v;
+	  break;
+	case LADDER_BANDPASS_MODE:
+	  outv = p1v - p3v;
+	  break;
+	case LADDER_HIGHPASS_MODE:
+	  outv = antialiasing ? antialiased.Tanh(output, input - p0v - fb*p3v) : approximant.Tanh(input - p0v - fb*p3v);
+	  break;
+	default:
+	  outv = 0.f;
+	}
+
+	// downsampling filter
+	if(factor > 1){
+	  outv = iir->IIRfilter(g, outv);
+	}
+      }
+
+      // scatter voice outputs
+      SIMDStore(lanes, outv);
+      for(int l = 0; l < active; l++){
+	out[base + l][i] = lanes[l];
+      }
+    }
+
+    // store voice state
+    SIMDStore(p0 + base, p0v);
+    SIMDStore(p1 + base, p1v);
+    SIMDStore(p2 + base, p2v);
+    SIMDStore(p3 + base, p3v);
+    SIMDStore(ut_1 + base, ut_1v);
+    SIMDStore(xk_t1 + base, xk_t1v);
+    SIMDStore(xk_t2 + base, xk_t2v);
+  }
+}
@@ -0,0 +1,274 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __kocmocnewtonh__
+#define __kocmocnewtonh__
+
+#include <cmath>
+#include "simd.h"
+
+// newton-raphson solver shared by the implicit integrators. the residual
+// functor evaluates f, f' and f'' of its equation in one call so common
+// nonlinear terms are computed once per iteration, f'' only feeds the
+// halley step and drops out of the other update rules. the filters pick
+// the update rule with SetFilterNewtonStep(). a solve does at
+// most maxIterations evaluations and steps and stops as soon as the
+// residual is below the tolerance. a solve that runs out of iterations
+// reports the residual of the iterate before its last step, unless a
+// report is asked for, which costs one more evaluation of the returned
+// iterate and is meant for the statistics only:
+//
+//   struct Residual {
+//     void Evaluate(float x, float& f, float& df, float& d2f) const;
+//   };
+
+// iteration bound of the filter solvers
+#define NEWTON_MAX_ITERATIONS 8
+
+// residual tolerance relative to the magnitude of the equation, a few
+// float ulps. tighter limits can not be met in single precision
+#define NEWTON_TOLERANCE 1.0e-6f
+
+// largest update of the damped step
+#define NEWTON_MAX_STEP 1.0f
+
+// update rules
+enum NewtonStep {
+  NEWTON_PLAIN,
+  NEWTON_DAMPED,
+  NEWTON_HALLEY
+};
+
+// outcome of a scalar solve
+struct NewtonResult {
+  float x;
+  float residual;
+  int iterations;
+  bool converged;
+};
+
+// outcome of a lane masked solve, iterations are those of the slowest lane
+// and steps those of every lane
+struct NewtonLanesResult {
+  SIMDFloat x;
+  SIMDFloat residual;
+  SIMDFloat steps;
+  SIMDMask converged;
+  int iterations;
+};
+
+// convergence statistics of the solves of one filter instance
+struct NewtonStatistics {
+  // solves by number of steps taken
+  long histogram[NEWTON_MAX_ITERATIONS + 1];
+
+  // solves and solves that ended above the tolerance
+  long solves;
+  long failures;
+
+  // largest residual left by a solve
+  float maxResidual;
+
+  NewtonStatistics(){
+    ResetNewtonStatistics();
+  }
+
+  void ResetNewtonStatistics(){
+    for(int ii=0; ii <= NEWTON_MAX_ITERATIONS; ii++){
+      histogram[ii] = 0;
+    }
+    solves = failures = 0;
+    maxResidual = 0.f;
+  }
+
+  // add one solve
+  inline void AddSolve(int iterations, float residual, bool converged){
+    histogram[iterations < NEWTON_MAX_ITERATIONS ? iterations : NEWTON_MAX_ITERATIONS]++;
+    solves++;
+    if(!converged){
+      failures++;
+    }
+    if(residual > maxResidual){
+      maxResidual = residual;
+    }
+  }
+
+  inline void AddSolve(const NewtonResult& result){
+    AddSolve(result.iterations, result.residual, result.converged);
+  }
+
+  // add the solves of the first active lanes
+  void AddLaneSolves(const NewtonLanesResult& result, int active){
+    float steps[SIMD_WIDTH];
+    float residual[SIMD_WIDTH];
+    int converged = SIMDMaskBits(result.converged);
+
+    SIMDStore(steps, result.steps);
+    SIMDStore(residual, result.residual);
+
+    for(int l=0; l < active && l < SIMD_WIDTH; l++){
+      AddSolve((int)steps[l], residual[l], (converged >> l) & 1);
+    }
+  }
+};
+
+// warm start from the two previous solutions by linear extrapolation
+inline float NewtonExtrapolate(float x_t1, float x_t2){
+  return 2.f*x_t1 - x_t2;
+}
+
+inline SIMDFloat NewtonExtrapolate(SIMDFloat x_t1, SIMDFloat x_t2){
+  return 2.f*x_t1 - x_t2;
+}
+
+// update of the selected rule
+template <NewtonStep step>
+inline float NewtonUpdate(float f, float df, float d2f){
+  switch(step){
+  case NEWTON_DAMPED:
+    // limit step so that flat regions of the nonlinearity can not throw
+    // the iterate far away
+    return fminf(fmaxf(f/df, -NEWTON_MAX_STEP), NEWTON_MAX_STEP);
+  case NEWTON_HALLEY:
+    return 2.f*f*df/(2.f*df*df - f*d2f);
+  default:
+    return f/df;
+  }
+}
+
+template <NewtonStep step>
+inline SIMDFloat NewtonUpdate(SIMDFloat f, SIMDFloat df, SIMDFloat d2f){
+  switch(step){
+  case NEWTON_DAMPED:
+    return SIMDClamp(f/df, -NEWTON_MAX_STEP, NEWTON_MAX_STEP);
+  case NEWTON_HALLEY:
+    return 2.f*f*df/(2.f*df*df - f*d2f);
+  default:
+    return f/df;
+  }
+}
+
+// solve f(x) = 0 from starting point x
+template <NewtonStep step, int maxIterations, class Residual>
+inline NewtonResult NewtonSolve(const Residual& residual, float x, float tolerance, bool report){
+  NewtonResult result;
+  float f, df, d2f;
+
+  result.residual = 0.f;
+  result.iterations = 0;
+  result.converged = false;
+
+  for(int ii=0; ii < maxIterations; ii++){
+    residual.Evaluate(x, f, df, d2f);
+    result.residual = fabsf(f);
+
+    // breaking limit
+    if(result.residual < tolerance){
+      result.converged = true;
+      break;
+    }
+
+    x -= NewtonUpdate<step>(f, df, d2f);
+    result.iterations++;
+  }
+
+  // out of iterations, report the residual of the iterate that is returned
+  if(report && !result.converged){
+    residual.Evaluate(x, f, df, d2f);
+    result.residual = fabsf(f);
+    result.converged = result.residual < tolerance;
+  }
+
+  result.x = x;
+
+  return result;
+}
+
+// solve f(x) = 0 in every lane from starting points x, converged lanes
+// keep their solution while the others iterate
+template <NewtonStep step, int maxIterations, class Residual>
+inline NewtonLanesResult NewtonSolveLanes(const Residual& residual, SIMDFloat x, SIMDFloat tolerance, bool report){
+  NewtonLanesResult result;
+  SIMDFloat f, df, d2f;
+  SIMDMask iterate = SIMDTrueMask();
+
+  result.residual = 0.f;
+  result.steps = 0.f;
+  result.iterations = 0;
+
+  for(int ii=0; ii < maxIterations; ii++){
+    residual.Evaluate(x, f, df, d2f);
+    SIMDFloat r = SIMDAbs(f);
+
+    // breaking limit
+    result.residual = SIMDSelect(iterate, r, result.residual);
+    iterate = iterate & SIMDGreaterEqual(r, tolerance);
+
+    if(!SIMDAnyTrue(iterate)){
+      break;
+    }
+
+    x = SIMDSelect(iterate, x - NewtonUpdate<step>(f, df, d2f), x);
+    result.steps = SIMDSelect(iterate, result.steps + 1.f, result.steps);
+    result.iterations++;
+  }
+
+  // lanes out of iterations report the residual of the iterate that is
+  // returned
+  if(report && result.iterations == maxIterations && SIMDAnyTrue(iterate)){
+    residual.Evaluate(x, f, df, d2f);
+    result.residual = SIMDSelect(iterate, SIMDAbs(f), result.residual);
+  }
+
+  result.x = x;
+  result.converged = SIMDLess(result.residual, tolerance);
+
+  return result;
+}
+
+// solves with the update rule selected at run time, the rule branch is
+// taken once per solve rather than once per step
+template <int maxIterations, class Residual>
+inline NewtonResult NewtonSolve(NewtonStep step, const Residual& residual, float x, float tolerance, bool report){
+  switch(step){
+  case NEWTON_DAMPED:
+    return NewtonSolve<NEWTON_DAMPED, maxIterations>(residual, x, tolerance, report);
+  case NEWTON_HALLEY:
+    return NewtonSolve<NEWTON_HALLEY, maxIterations>(residual, x, tolerance, report);
+  default:
+    return NewtonSolve<NEWTON_PLAIN, maxIterations>(residual, x, tolerance, report);
+  }
+}
+
+template <int maxIterations, class Residual>
+inline NewtonLanesResult NewtonSolveLanes(NewtonStep step, const Residual& residual, SIMDFloat x, SIMDFloat tolerance,
+					  bool report){
+  switch(step){
+  case NEWTON_DAMPED:
+    return NewtonSolveLanes<NEWTON_DAMPED, maxIterations>(residual, x, tolerance, report);
+  case NEWTON_HALLEY:
+    return NewtonSolveLanes<NEWTON_HALLEY, maxIterations>(residual, x, tolerance, report);
+  default:
+    return NewtonSolveLanes<NEWTON_PLAIN, maxIterations>(residual, x, tolerance, report);
+  }
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "noise.h"
+
+// constructor
+NoiseGenerator::NoiseGenerator(uint32_t newSeed){
+  SetNoiseSeed(newSeed);
+}
+
+// default constructor
+NoiseGenerator::NoiseGenerator(){
+  SetNoiseSeed(NOISE_DEFAULT_SEED);
+}
+
+void NoiseGenerator::SetNoiseSeed(uint32_t newSeed){
+  // xorshift state must not be zero
+  state = newSeed ? newSeed : NOISE_DEFAULT_SEED;
+}
+
+void NoiseGenerator::NoiseBlock(float* out, int n, float amplitude){
+  // keep the state in a register over the block
+  uint32_t x = state;
+
+  for(int i=0; i<n; i++){
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    out[i] = amplitude*(float)((int32_t)x)*(1.f/2147483648.f);
+  }
+
+  state = x;
+}
+
+void NoiseGenerator::NoiseBitsBlock(uint32_t* out, int n){
+  uint32_t x = state;
+
+  for(int i=0; i<n; i++){
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    out[i] = x;
+  }
+
+  state = x;
+}
@@ -0,0 +1,72 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __dspnoiseh__
+#define __dspnoiseh__
+
+#include <stdint.h>
+
+// default seed of the dither generators
+#define NOISE_DEFAULT_SEED 22222u
+
+// per instance xorshift noise generator for anti-denormal dither, cheap
+// enough to run per sample and free of shared state so that renders are
+// reproducible
+class NoiseGenerator{
+public:
+  // constructor
+  NoiseGenerator(uint32_t newSeed);
+  NoiseGenerator();
+
+  // restart the sequence from a seed
+  void SetNoiseSeed(uint32_t newSeed);
+
+  // uniform noise sample in -amplitude..amplitude
+  inline float NoiseSample(float amplitude);
+
+  // raw 32 bit generator output
+  inline uint32_t NoiseBits();
+
+  // fill a block with uniform noise in -amplitude..amplitude
+  void NoiseBlock(float* out, int n, float amplitude);
+
+  // fill a block with raw generator output
+  void NoiseBitsBlock(uint32_t* out, int n);
+
+private:
+  uint32_t state;
+};
+
+inline uint32_t NoiseGenerator::NoiseBits(){
+  // xorshift32 step
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+
+  return state;
+}
+
+inline float NoiseGenerator::NoiseSample(float amplitude){
+  // scale signed state to -1..1
+  return amplitude*(float)((int32_t)NoiseBits())*(1.f/2147483648.f);
+}
+
+#endif
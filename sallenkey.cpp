@@ -19,18 +19,42 @@
  *  along with Sallen-Key Filter OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <cstdlib>
 #include <cmath>
 #include "sallenkey.h"
 #include "iir.h"
 #include "fastmath.h"
-
-// steepness of downsample filter response
-#define IIR_DOWNSAMPLE_ORDER 8
+#include "newton.h"
 
 // downsampling passthrough bandwidth
 #define IIR_DOWNSAMPLING_BANDWIDTH 0.9
 
+// trapezoidal equation c*x + alpha/4*sinh(4*x) = D_n
+template <FastmathApproximation approximation>
+struct SKTrapezoidalResidual {
+  float alpha, c, D_n;
+
+  inline void Evaluate(float x, float& f, float& df, float& d2f) const {
+    float s = Fastmath<approximation>::Sinh(4.f*x);
+
+    f = c*x + 0.25f*alpha*s - D_n;
+    df = c + alpha*Fastmath<approximation>::Cosh(4.f*x);
+    d2f = 4.f*alpha*s;
+  }
+};
+
+// newton-raphson solve of the trapezoidal equation from x, the approximant
+// branch is taken once per solve rather than once per evaluation
+static inline NewtonResult SKTrapezoidalSolve(FastmathApproximation approximation, NewtonStep step, float alpha, float c, float D_n,
+					       float x, float tolerance, bool report){
+  if(approximation == FASTMATH_MINIMAX){
+    SKTrapezoidalResidual<FASTMATH_MINIMAX> residual = {alpha, c, D_n};
+    return NewtonSolve<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+  }
+
+  SKTrapezoidalResidual<FASTMATH_PADE> residual = {alpha, c, D_n};
+  return NewtonSolve<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+}
+
 // constructor
 SKFilter::SKFilter(float newCutoff, float newResonance, int newOversamplingFactor,
 		   SKFilterMode newFilterMode, float newSampleRate, SKIntegrationMethod newIntegrationMethod){
@@ -44,16 +68,28 @@ SKFilter::SKFilter(float newCutoff, float newResonance, int newOversamplingFacto
   SetFilterIntegrationRate();
 
   // initialize filter state
-  p0 = p1 = out = 0.0;
+  p0 = p1 = out = 0.f;
+  xk_t1 = xk_t2 = 0.f;
 
   // initialize filter inputs
-  input_lp = input_bp = input_hp = 0.0;
-  input_lp_t1 = input_bp_t1 = input_hp_t1 = 0.0;
+  input_lp = input_bp = input_hp = 0.f;
+  input_lp_t1 = input_bp_t1 = input_hp_t1 = 0.f;
   
   integrationMethod = newIntegrationMethod;
+  resamplerType = RESAMPLER_IIR;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+
+  SelectKernel();
   
   // instantiate downsampling filter
-  iir = new IIRLowpass(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, IIR_DOWNSAMPLE_ORDER);
+  iir = new FixedIIRLowpass<SK_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, SK_IIR_DOWNSAMPLE_ORDER);
+
+  // instantiate half-band resampler chain
+  halfband = new HalfbandResampler(oversamplingFactor);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
 }
 
 // default constructor
@@ -68,21 +104,35 @@ SKFilter::SKFilter(){
   SetFilterIntegrationRate();
   
   // initialize filter state
-  p0 = p1 = out = 0.0;
+  p0 = p1 = out = 0.f;
+  xk_t1 = xk_t2 = 0.f;
 
   // initialize filter inputs
-  input_lp = input_bp = input_hp = 0.0;
-  input_lp_t1 = input_bp_t1 = input_hp_t1 = 0.0;
+  input_lp = input_bp = input_hp = 0.f;
+  input_lp_t1 = input_bp_t1 = input_hp_t1 = 0.f;
   
   integrationMethod = SK_TRAPEZOIDAL;
+  resamplerType = RESAMPLER_IIR;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+
+  SelectKernel();
   
   // instantiate downsampling filter
-  iir = new IIRLowpass(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, IIR_DOWNSAMPLE_ORDER);
+  iir = new FixedIIRLowpass<SK_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, SK_IIR_DOWNSAMPLE_ORDER);
+
+  // instantiate half-band resampler chain
+  halfband = new HalfbandResampler(oversamplingFactor);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
 }
 
 // default destructor
 SKFilter::~SKFilter(){
   delete iir;
+  delete halfband;
+  delete newtonStats;
 }
 
 void SKFilter::ResetFilterState(){
@@ -93,62 +143,172 @@ void SKFilter::ResetFilterState(){
   SetFilterIntegrationRate();
   
   // initialize filter state
-  p0 = p1 = out = 0.0;
+  p0 = p1 = out = 0.f;
+  xk_t1 = xk_t2 = 0.f;
 
   // initialize filter inputs
-  input_lp = input_bp = input_hp = 0.0;
-  input_lp_t1 = input_bp_t1 = input_hp_t1 = 0.0;
+  input_lp = input_bp = input_hp = 0.f;
+  input_lp_t1 = input_bp_t1 = input_hp_t1 = 0.f;
   
   // set oversampling
-  iir->SetFilterSamplerate(sampleRate * oversamplingFactor);
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  halfband->InitializeResampler();
 }
 
 void SKFilter::SetFilterCutoff(float newCutoff){
-  cutoffFrequency = newCutoff;
+  // derived constants are only invalidated by a change
+  if(newCutoff != cutoffFrequency){
+    cutoffFrequency = newCutoff;
 
-  SetFilterIntegrationRate();
+    SetFilterIntegrationRate();
+  }
 }
 
 void SKFilter::SetFilterResonance(float newResonance){
-  Resonance = newResonance;
+  if(newResonance != Resonance){
+    Resonance = newResonance;
+    coefficientsDirty = true;
+  }
 }
 
 void SKFilter::SetFilterOversamplingFactor(int newOversamplingFactor){
   oversamplingFactor = newOversamplingFactor;
-  iir->SetFilterSamplerate(sampleRate * oversamplingFactor);
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  halfband->SetResamplerFactor(oversamplingFactor);
 
   SetFilterIntegrationRate();
+  SelectKernel();
 }
 
 void SKFilter::SetFilterMode(SKFilterMode newFilterMode){
   filterMode = newFilterMode;
+  SelectKernel();
 }
 
 void SKFilter::SetFilterSampleRate(float newSampleRate){
   sampleRate = newSampleRate;
-  iir->SetFilterSamplerate(sampleRate * (float)(oversamplingFactor));
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * (float)(oversamplingFactor), IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
 
   SetFilterIntegrationRate();
 }
 
 void SKFilter::SetFilterIntegrationMethod(SKIntegrationMethod method){
   integrationMethod = method;
+  SelectKernel();
+}
+
+void SKFilter::SetFilterResampler(ResamplerType newResampler){
+  resamplerType = newResampler;
+  halfband->InitializeResampler();
+  SelectKernel();
+}
+
+void SKFilter::SetFilterApproximation(FastmathApproximation newApproximation){
+  approximation = newApproximation;
+}
+
+void SKFilter::SetFilterNewtonStep(NewtonStep newStep){
+  newtonStep = newStep;
+}
+
+void SKFilter::SetFilterNoiseSeed(uint32_t newSeed){
+  dither.SetNoiseSeed(newSeed);
+}
+
+void SKFilter::SetFilterNewtonStatistics(bool enable){
+  if(enable && newtonStats == NULL){
+    newtonStats = new NewtonStatistics();
+  }
+  else if(!enable){
+    delete newtonStats;
+    newtonStats = NULL;
+  }
+}
+
+// clamp integration rate
+static inline float SKClampIntegrationRate(float dt){
+  if(dt < 0.f){
+    dt = 0.f;
+  }
+  else if(dt > 0.35f){
+    dt = 0.35f;
+  }
+
+  return dt;
+}
+
+// derive the kernel constants from the integration rate and resonance
+static inline void SKDeriveCoefficients(SKCoefficients& coefficients, float dt, float resonance){
+  float alpha = 0.5f*dt;
+
+  // feedback amount
+  coefficients.res = 4.f*resonance;
+
+  // trapezoidal half step and the weights of its one step solution
+  coefficients.alpha = alpha;
+  coefficients.state = 1.f/(1.f + alpha);
+  coefficients.input = alpha*coefficients.state;
+  coefficients.bandpass = alpha - alpha*coefficients.input;
+  coefficients.c = 1.f - coefficients.bandpass*coefficients.res + alpha;
 }
 
 void SKFilter::SetFilterIntegrationRate(){
   // normalize cutoff freq to samplerate
-  dt = 44100.0 / (sampleRate * oversamplingFactor) * cutoffFrequency;
+  dt = SKClampIntegrationRate(44100.0 / (sampleRate * oversamplingFactor) * cutoffFrequency);
 
-  // clamp integration rate
-  if(dt < 0.0){
-    dt = 0.0;
-  }
-  else if(dt > 0.35){
-    dt = 0.35;
+  coefficientsDirty = true;
+}
+
+void SKFilter::UpdateFilterCoefficients(){
+  SKDeriveCoefficients(coefficients, dt, Resonance);
+
+  coefficientsDirty = false;
+}
+
+// kernel table entries for the specialized oversampling factors
+#define SK_KERNEL_ROW(method, mode) \
+  {&SKFilter::ProcessBlockKernel<method, mode, 0>, \
+   &SKFilter::ProcessBlockKernel<method, mode, 1>, \
+   &SKFilter::ProcessBlockKernel<method, mode, 2>, \
+   &SKFilter::ProcessBlockKernel<method, mode, 4>, \
+   &SKFilter::ProcessBlockKernel<method, mode, 8>}
+
+#define SK_KERNEL_MODES(method) \
+  {SK_KERNEL_ROW(method, SK_LOWPASS_MODE), \
+   SK_KERNEL_ROW(method, SK_BANDPASS_MODE), \
+   SK_KERNEL_ROW(method, SK_HIGHPASS_MODE)}
+
+void SKFilter::SelectKernel(){
+  static const ProcessBlockKernelFn kernels[3][3][5] = {
+    SK_KERNEL_MODES(SK_SEMI_IMPLICIT_EULER),
+    SK_KERNEL_MODES(SK_PREDICTOR_CORRECTOR),
+    SK_KERNEL_MODES(SK_TRAPEZOIDAL)
+  };
+
+  // specialized oversampling factors, other factors use the generic kernel
+  int os;
+  switch(oversamplingFactor){
+  case 1:
+    os = 1;
+    break;
+  case 2:
+    os = 2;
+    break;
+  case 4:
+    os = 3;
+    break;
+  case 8:
+    os = 4;
+    break;
+  default:
+    os = 0;
   }
+
+  kernel = kernels[integrationMethod][filterMode][os];
+
+  // half-band chain handles power of two factors only
+  halfbandResampler = resamplerType == RESAMPLER_HALFBAND && oversamplingFactor > 1 &&
+    HalfbandResampler::IsResamplerFactor(oversamplingFactor);
 }
 
 float SKFilter::GetFilterCutoff(){
@@ -179,121 +339,269 @@ SKIntegrationMethod SKFilter::GetFilterIntegrationMethod(){
   return integrationMethod;
 }
 
+ResamplerType SKFilter::GetFilterResampler(){
+  return resamplerType;
+}
+
+FastmathApproximation SKFilter::GetFilterApproximation(){
+  return approximation;
+}
+
+NewtonStep SKFilter::GetFilterNewtonStep(){
+  return newtonStep;
+}
+
+NewtonStatistics* SKFilter::GetFilterNewtonStatistics(){
+  return newtonStats;
+}
+
 void SKFilter::filter(float input){
-  // noise term
-  float noise;
+  ProcessBlock(&input, &out, 1);
+}
 
-  // feedback amount variables
-  float res=4.0*Resonance;
-  float fb=0.0;
+void SKFilter::ProcessBlock(const float* in, float* out, int n){
+  (this->*kernel)(in, out, n, NULL, NULL);
+}
 
-  // update noise terms
-  noise = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-  noise = 1.0e-6 * 2.0 * (noise - 0.5);
+void SKFilter::ProcessBlock(const float* in, float* out, int n, const float* cutoff, const float* resonance){
+  (this->*kernel)(in, out, n, cutoff, resonance);
 
-  input += noise;
+  // keep the last modulated values for the following blocks
+  if(n > 0){
+    if(cutoff){
+      SetFilterCutoff(cutoff[n - 1]);
+    }
+    if(resonance){
+      SetFilterResonance(resonance[n - 1]);
+    }
+  }
+}
 
-  // set filter mode
-  switch(filterMode){
-  case SK_LOWPASS_MODE:
-    input_lp = input;
-    input_bp = 0.0;
-    input_hp = 0.0;
-    break;
-  case SK_BANDPASS_MODE:
-    input_lp = 0.0;
-    input_bp = input;
-    input_hp = 0.0;
-    break;
-  case SK_HIGHPASS_MODE:
-    input_lp = 0.0;
-    input_bp = 0.0;
-    input_hp = input;
-    break;
-  default:
-    input_lp = 0.0;
-    input_bp = 0.0;
-    input_hp = 0.0;
+template <SKIntegrationMethod method, SKFilterMode mode, int oversampling>
+void SKFilter::ProcessBlockKernel(const float* in, float* output, int n, const float* cutoff, const float* resonance){
+  // nothing to filter, the modulation buffers may be empty
+  if(n <= 0){
+    return;
+  }
+
+  // oversampling factor is a compile time constant unless zero
+  const int factor = oversampling ? oversampling : oversamplingFactor;
+
+  // resampler and sinh approximant are fixed over the block
+  const bool halfbandResampler = this->halfbandResampler;
+  const FastmathApproximation approximation = this->approximation;
+  const FastmathRuntime approximant = {approximation};
+
+  // oversampled input and output of the half-band resampler
+  float upsampled[HALFBAND_MAX_FACTOR];
+  float decimated[HALFBAND_MAX_FACTOR];
+
+  // oversampled output collected for the block decimation filter
+  float oversampled[IIR_BLOCK_SIZE];
+  int pending = 0;
+
+  // update derived constants after a parameter change
+  if(coefficientsDirty){
+    UpdateFilterCoefficients();
   }
-    
-  // integrate filter state
-  // with oversampling
-  for(int nn = 0; nn < oversamplingFactor; nn++){
-    // switch integration method
-    switch(integrationMethod){
-    case SK_SEMI_IMPLICIT_EULER:
-      // semi-implicit euler integration
-      {
-	fb = input_bp + res*p1;
-	p0 += dt*(input_lp - p0 - fb);
-       	p1 += dt*(p0 + fb - p1 - 1.0/4.0*SinhPade34(p0*4.0));
-      	out = p1;
+
+  // derived constants, kept in registers over the block
+  SKCoefficients coefficients = this->coefficients;
+  float dt = this->dt;
+
+  // feedback amount variables
+  float res = coefficients.res;
+  float fb=0.f;
+
+  // integration rate per unit cutoff for the modulation buffers
+  float rate = cutoff ? 44100.f / (sampleRate * (float)(factor)) : 0.f;
+
+  // keep filter state in registers over the block
+  NoiseGenerator dither = this->dither;
+  float p0 = this->p0;
+  float p1 = this->p1;
+  float input_lp = this->input_lp;
+  float input_bp = this->input_bp;
+  float input_hp = this->input_hp;
+  float input_lp_t1 = this->input_lp_t1;
+  float input_bp_t1 = this->input_bp_t1;
+  float input_hp_t1 = this->input_hp_t1;
+  float xk_t1 = this->xk_t1;
+  float xk_t2 = this->xk_t2;
+  float out = this->out;
+
+  for(int i = 0; i < n; i++){
+    float input = in[i];
+
+    // derive the constants of this sample from the modulation buffers,
+    // held values keep the constants of the sample before
+    if((cutoff && (i == 0 || cutoff[i] != cutoff[i - 1])) ||
+       (resonance && (i == 0 || resonance[i] != resonance[i - 1]))){
+      if(cutoff){
+	dt = SKClampIntegrationRate(rate*cutoff[i]);
       }
-      break;
-    case SK_PREDICTOR_CORRECTOR:
-      // predictor-corrector integration
-      {
-	float p0_prime, p1_prime, fb_prime;
-	  
-	fb = input_bp_t1 + res*p1;
-	p0_prime = p0 + dt*(input_lp_t1 - p0 - fb);
-       	p1_prime = p1 + dt*(p0 + fb - p1 - 1.0/4.0*SinhPade34(p1*4.0));	
-	fb_prime = input_bp + res*p1_prime;
-	
-       	p1 += 0.5*dt*((p0 + fb - p1 - 1.0/4.0*SinhPade34(p1*4.0)) +
-		      (p0_prime + fb_prime - p1_prime - 1.0/4.0*SinhPade34(p1*4.0)));
-	p0 += 0.5*dt*((input_lp_t1 - p0 - fb) +
-		      (input_lp - p0_prime - fb_prime));
 
-	out = p1;
+      SKDeriveCoefficients(coefficients, dt, resonance ? resonance[i] : Resonance);
+      res = coefficients.res;
+    }
+
+    // add dither
+    input += dither.NoiseSample(1.0e-6f);
+
+    // interpolate input to the oversampled rate
+    if(halfbandResampler){
+      halfband->Upsample(input, upsampled);
+    }
+
+    // integrate filter state
+    // with oversampling
+    for(int nn = 0; nn < factor; nn++){
+      // oversampled input, held over the substeps without the half-band chain
+      float u = halfbandResampler ? upsampled[nn] : input;
+
+      // set filter mode
+      switch(mode){
+      case SK_LOWPASS_MODE:
+	input_lp = u;
+	input_bp = 0.f;
+	input_hp = 0.f;
+	break;
+      case SK_BANDPASS_MODE:
+	input_lp = 0.f;
+	input_bp = u;
+	input_hp = 0.f;
+	break;
+      case SK_HIGHPASS_MODE:
+	input_lp = 0.f;
+	input_bp = 0.f;
+	input_hp = u;
+	break;
+      default:
+	input_lp = 0.f;
+	input_bp = 0.f;
+	input_hp = 0.f;
       }
-      break;
-    case SK_TRAPEZOIDAL:
-      // trapezoidal integration
-      {
-	float x_k, x_k2;
-	float fb_t = input_bp_t1 + res*p1;
-	float alpha = dt/2.0;
-	float A = p0 + fb_t - p1 - 1.0/4.0*SinhPade54(4.0*p1) +
-	           p0/(1.0 + alpha) + alpha/(1 + alpha)*(input_lp_t1 - p0 - fb_t + input_lp);
-	float c = 1.0 - (alpha - alpha*alpha/(1.0 + alpha))*res + alpha;
-	float D_n = p1 + alpha*A + (alpha - alpha*alpha/(1.0 + alpha))*input_bp;
-
-	x_k = p1;
-	
-	// newton-raphson
-	for(int ii=0; ii < 8; ii++) {
-	  x_k2 = x_k - (c*x_k + alpha*1.0/4.0*SinhPade54(4.0*x_k) - D_n)/(c + alpha*CoshPade54(4.0*x_k));
+
+      // integration method is a compile time constant
+      switch(method){
+      case SK_SEMI_IMPLICIT_EULER:
+	// semi-implicit euler integration, the sinh shaping of the explicit
+	// methods is the same for both approximations
+	{
+	  fb = input_bp + res*p1;
+	  p0 += dt*(input_lp - p0 - fb);
+	  p1 += dt*(p0 + fb - p1 - 0.25f*SinhPade34(p0*4.f));
+	  out = p1;
+	}
+	break;
+      case SK_PREDICTOR_CORRECTOR:
+	// predictor-corrector integration
+	{
+	  float p0_prime, p1_prime, fb_prime;
 	  
-	  // breaking limit
-	  if(abs(x_k2 - x_k) < 1.0e-9) {
-	    x_k = x_k2;
-	    break;
+	  fb = input_bp_t1 + res*p1;
+	  p0_prime = p0 + dt*(input_lp_t1 - p0 - fb);
+	  p1_prime = p1 + dt*(p0 + fb - p1 - 0.25f*SinhPade34(p1*4.f));	
+	  fb_prime = input_bp + res*p1_prime;
+	
+	  p1 += 0.5f*dt*((p0 + fb - p1 - 0.25f*SinhPade34(p1*4.f)) +
+			(p0_prime + fb_prime - p1_prime - 0.25f*SinhPade34(p1*4.f)));
+	  p0 += 0.5f*dt*((input_lp_t1 - p0 - fb) +
+			(input_lp - p0_prime - fb_prime));
+
+	  out = p1;
+	}
+	break;
+      case SK_TRAPEZOIDAL:
+	// trapezoidal integration
+	{
+	  float fb_t = input_bp_t1 + res*p1;
+	  float alpha = coefficients.alpha;
+	  float A = p0 + fb_t - p1 - 0.25f*approximant.Sinh(4.f*p1) +
+	             coefficients.state*p0 + coefficients.input*(input_lp_t1 - p0 - fb_t + input_lp);
+	  float D_n = p1 + alpha*A + coefficients.bandpass*input_bp;
+
+	  // newton-raphson from the extrapolated previous solutions
+	  NewtonResult nr = SKTrapezoidalSolve(approximation, newtonStep, alpha, coefficients.c, D_n, NewtonExtrapolate(xk_t1, xk_t2),
+					       NEWTON_TOLERANCE*(1.f + fabsf(D_n)), newtonStats != NULL);
+	  p1 = nr.x;
+
+	  xk_t2 = xk_t1;
+	  xk_t1 = p1;
+
+	  if(newtonStats){
+	    newtonStats->AddSolve(nr);
 	  }
-	  
-	  x_k = x_k2;
+	  fb = input_bp + res*p1;
+	  p0 = coefficients.state*p0 + coefficients.input*(input_lp_t1 - p0 - fb_t + input_lp - fb);
+	  out = p1;
 	}
-	
-	p1 = x_k;
-	fb = input_bp + res*p1;
-	p0 = p0/(1.0 + alpha) + alpha/(1.0 + alpha)*(input_lp_t1 - p0 - fb_t + input_lp - fb);
-	out = p1;
+	break;
+      default:
+	break;
+      }
+
+      // downsampling filter
+      if(halfbandResampler){
+	decimated[nn] = out;
+
+	// interpolated input changes every substep
+	input_lp_t1 = input_lp;
+	input_bp_t1 = input_bp;
+	input_hp_t1 = input_hp;
+      }
+      else if(factor > IIR_BLOCK_SIZE){
+	out = iir->IIRfilter(out);
+      }
+      else if(factor > 1){
+	oversampled[pending*factor + nn] = out;
       }
-      break;
-    default:
-      break;
     }
 
-    // downsampling filter
-    if(oversamplingFactor > 1){
-      out = iir->IIRfilter(out);
+    // decimate output to the base rate
+    if(halfbandResampler){
+      out = halfband->Downsample(decimated);
+    }
+    else{
+      // set input at t-1
+      input_lp_t1 = input_lp;    
+      input_bp_t1 = input_bp;    
+      input_hp_t1 = input_hp;    
+    }
+
+    // decimate collected substeps when the buffer is full or the block ends
+    if(!halfbandResampler && factor > 1 && factor <= IIR_BLOCK_SIZE){
+      pending++;
+
+      if((pending + 1)*factor > IIR_BLOCK_SIZE || i == n - 1){
+	iir->IIRfilterBlock(oversampled, pending*factor);
+
+	for(int j = 0; j < pending; j++){
+	  output[i + 1 - pending + j] = oversampled[(j + 1)*factor - 1];
+	}
+
+	out = output[i];
+	pending = 0;
+      }
+    }
+    else{
+      output[i] = out;
     }
   }
-  
-  // set input at t-1
-  input_lp_t1 = input_lp;    
-  input_bp_t1 = input_bp;    
-  input_hp_t1 = input_hp;    
+
+  // store filter state
+  this->p0 = p0;
+  this->p1 = p1;
+  this->input_lp = input_lp;
+  this->input_bp = input_bp;
+  this->input_hp = input_hp;
+  this->input_lp_t1 = input_lp_t1;
+  this->input_bp_t1 = input_bp_t1;
+  this->input_hp_t1 = input_hp_t1;
+  this->xk_t1 = xk_t1;
+  this->xk_t2 = xk_t2;
+  this->out = out;
+  this->dither = dither;
 }
 
 void SKFilter::SetFilterLowpassInput(float input){
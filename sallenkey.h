@@ -23,6 +23,13 @@
 #define __dspskfh__
 
 #include "iir.h"
+#include "halfband.h"
+#include "noise.h"
+#include "newton.h"
+#include "fastmath.h"
+
+// steepness of downsample filter response, the decimators are sized for it
+#define SK_IIR_DOWNSAMPLE_ORDER 8
 
 // filter modes
 enum SKFilterMode {
@@ -38,6 +45,20 @@ enum SKIntegrationMethod {
    SK_TRAPEZOIDAL
 };
 
+// kernel constants derived from the filter parameters
+struct SKCoefficients {
+  // feedback amount
+  float res;
+
+  // trapezoidal half step, weights of the previous state, the input and
+  // the bandpass input in the one step solution, implicit state weight
+  float alpha;
+  float state;
+  float input;
+  float bandpass;
+  float c;
+};
+
 class SKFilter{
 public:
   // constructor/destructor
@@ -53,6 +74,11 @@ public:
   void SetFilterMode(SKFilterMode newFilterMode);
   void SetFilterSampleRate(float newSampleRate);
   void SetFilterIntegrationMethod(SKIntegrationMethod method);
+  void SetFilterResampler(ResamplerType newResampler);
+  void SetFilterApproximation(FastmathApproximation newApproximation);
+  void SetFilterNewtonStep(NewtonStep newStep);
+  void SetFilterNoiseSeed(uint32_t newSeed);
+  void SetFilterNewtonStatistics(bool enable);
   
   // get filter parameters
   float GetFilterCutoff();
@@ -61,10 +87,24 @@ public:
   SKFilterMode GetFilterMode();  
   float GetFilterSampleRate();
   SKIntegrationMethod GetFilterIntegrationMethod();
+  ResamplerType GetFilterResampler();
+  FastmathApproximation GetFilterApproximation();
+  NewtonStep GetFilterNewtonStep();
+
+  // get newton solver statistics, NULL unless enabled
+  NewtonStatistics* GetFilterNewtonStatistics();
   
   // tick filter state
   void filter(float input);
 
+  // filter a block of samples, in and out may be the same buffer
+  void ProcessBlock(const float* in, float* out, int n);
+
+  // filter a block with per sample cutoff and resonance, either buffer
+  // may be NULL to keep the set value. parameters end the block at their
+  // last modulated value
+  void ProcessBlock(const float* in, float* out, int n, const float* cutoff, const float* resonance);
+
   // set filter inputs
   void SetFilterLowpassInput(float input);
   void SetFilterBandpassInput(float input);
@@ -80,6 +120,23 @@ private:
   // set integration rate
   void SetFilterIntegrationRate();
 
+  // recompute the kernel constants, done at the start of a block after
+  // a setter has invalidated them
+  void UpdateFilterCoefficients();
+
+  // select block processing kernel for current settings
+  void SelectKernel();
+
+  // block processing kernel specialized for integration method,
+  // filter mode and oversampling factor, zero factor is generic.
+  // resampler and approximants are branches fixed over the block.
+  // modulation buffers are NULL for block rate parameters
+  template <SKIntegrationMethod method, SKFilterMode mode, int oversampling>
+  void ProcessBlockKernel(const float* in, float* output, int n, const float* cutoff, const float* resonance);
+
+  typedef void (SKFilter::*ProcessBlockKernelFn)(const float* in, float* output, int n,
+						 const float* cutoff, const float* resonance);
+
   // filter parameters
   float cutoffFrequency;
   float Resonance;
@@ -88,6 +145,13 @@ private:
   float sampleRate;
   float dt;
   SKIntegrationMethod integrationMethod;
+  ResamplerType resamplerType;
+  FastmathApproximation approximation;
+  NewtonStep newtonStep;
+
+  // derived kernel constants and their invalidation flag
+  SKCoefficients coefficients;
+  bool coefficientsDirty;
   
   // filter state
   float p0;
@@ -100,12 +164,31 @@ private:
   float input_lp_t1;
   float input_bp_t1;
   float input_hp_t1;
+
+  // previous newton solutions for the warm start
+  float xk_t1;
+  float xk_t2;
   
   // filter output
   float out;
 
+  // selected block processing kernel
+  ProcessBlockKernelFn kernel;
+
+  // half-band chain in use, the resampler type for a factor it handles
+  bool halfbandResampler;
+
   // IIR downsampling filter
-  IIRLowpass *iir;
+  FixedIIRLowpass<SK_IIR_DOWNSAMPLE_ORDER> *iir;
+
+  // half-band resampler chain
+  HalfbandResampler *halfband;
+
+  // anti-denormal dither generator
+  NoiseGenerator dither;
+
+  // newton solver statistics
+  NewtonStatistics *newtonStats;
 };
 
 #endif
@@ -0,0 +1,367 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __kocmocsimdh__
+#define __kocmocsimdh__
+
+// portable single precision vector type for processing several
+// independent filter voices per instruction. the lane count is fixed
+// at compile time by the available instruction set: 8 lanes with AVX,
+// 4 lanes with SSE2 or NEON, and 4 emulated lanes otherwise or when
+// SIMD_FORCE_SCALAR is defined
+
+#if defined(SIMD_FORCE_SCALAR)
+#define SIMD_SCALAR 1
+#define SIMD_WIDTH 4
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_AVX 1
+#define SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE 1
+#define SIMD_WIDTH 4
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#define SIMD_WIDTH 4
+#else
+#define SIMD_SCALAR 1
+#define SIMD_WIDTH 4
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+// half precision bits to float. the magnitude moves into the float
+// exponent and mantissa fields and is rebiased by one multiply, which
+// also takes care of subnormal halves
+inline float HalfToFloat(uint16_t h) {
+  uint32_t mag = (uint32_t)(h & 0x7fff) << 13;
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  float f;
+  memcpy(&f, &mag, 4);
+  f *= 5.192296858534828e33f;
+  uint32_t bits;
+  memcpy(&bits, &f, 4);
+  bits |= sign;
+  memcpy(&f, &bits, 4);
+  return f;
+}
+
+#if defined(SIMD_AVX)
+
+struct SIMDFloat {
+  __m256 v;
+  SIMDFloat() {}
+  SIMDFloat(__m256 x) : v(x) {}
+  SIMDFloat(float x) : v(_mm256_set1_ps(x)) {}
+};
+
+struct SIMDMask {
+  __m256 m;
+  SIMDMask() {}
+  SIMDMask(__m256 x) : m(x) {}
+};
+
+inline SIMDFloat operator+(SIMDFloat a, SIMDFloat b) { return _mm256_add_ps(a.v, b.v); }
+inline SIMDFloat operator-(SIMDFloat a, SIMDFloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline SIMDFloat operator*(SIMDFloat a, SIMDFloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline SIMDFloat operator/(SIMDFloat a, SIMDFloat b) { return _mm256_div_ps(a.v, b.v); }
+inline SIMDFloat operator-(SIMDFloat a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f)); }
+
+inline SIMDFloat SIMDLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void SIMDStore(float* p, SIMDFloat a) { _mm256_storeu_ps(p, a.v); }
+
+// SIMD_WIDTH signed 16 bit integers converted to float
+inline SIMDFloat SIMDLoadInt16(const int16_t* p) {
+  __m128i h = _mm_loadu_si128((const __m128i*)p);
+  __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(h, h), 16);
+  __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(h, h), 16);
+  return _mm256_cvtepi32_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+}
+
+// four zero extended half precision values converted to float, AVX has
+// no 256 bit integer shifts so each half of the vector goes through SSE2
+inline __m128 SIMDHalfQuad(__m128i h) {
+  __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+  __m128i mag = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+  __m128 f = _mm_mul_ps(_mm_castsi128_ps(mag), _mm_set1_ps(5.192296858534828e33f));
+  return _mm_or_ps(f, _mm_castsi128_ps(sign));
+}
+
+// SIMD_WIDTH half precision values converted to float, see HalfToFloat()
+inline SIMDFloat SIMDLoadHalf(const uint16_t* p) {
+  __m128i h = _mm_loadu_si128((const __m128i*)p);
+  __m128 lo = SIMDHalfQuad(_mm_unpacklo_epi16(h, _mm_setzero_si128()));
+  __m128 hi = SIMDHalfQuad(_mm_unpackhi_epi16(h, _mm_setzero_si128()));
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+inline SIMDFloat SIMDMin(SIMDFloat a, SIMDFloat b) { return _mm256_min_ps(a.v, b.v); }
+inline SIMDFloat SIMDMax(SIMDFloat a, SIMDFloat b) { return _mm256_max_ps(a.v, b.v); }
+inline SIMDFloat SIMDAbs(SIMDFloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v); }
+
+inline SIMDMask SIMDLess(SIMDFloat a, SIMDFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline SIMDMask SIMDGreaterEqual(SIMDFloat a, SIMDFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline SIMDMask operator&(SIMDMask a, SIMDMask b) { return _mm256_and_ps(a.m, b.m); }
+inline SIMDMask operator|(SIMDMask a, SIMDMask b) { return _mm256_or_ps(a.m, b.m); }
+
+// per lane mask ? a : b
+inline SIMDFloat SIMDSelect(SIMDMask mask, SIMDFloat a, SIMDFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.m); }
+
+// one bit per lane
+inline int SIMDMaskBits(SIMDMask mask) { return _mm256_movemask_ps(mask.m); }
+
+// lanes of a moved up by one, lane 0 filled from the last lane of b
+inline SIMDFloat SIMDShiftIn(SIMDFloat a, SIMDFloat b) {
+  __m256 t = _mm256_permute2f128_ps(a.v, b.v, 0x03);
+  __m256 u = _mm256_shuffle_ps(t, a.v, _MM_SHUFFLE(0, 0, 3, 3));
+  return _mm256_shuffle_ps(u, a.v, _MM_SHUFFLE(2, 1, 2, 0));
+}
+
+#elif defined(SIMD_SSE)
+
+struct SIMDFloat {
+  __m128 v;
+  SIMDFloat() {}
+  SIMDFloat(__m128 x) : v(x) {}
+  SIMDFloat(float x) : v(_mm_set1_ps(x)) {}
+};
+
+struct SIMDMask {
+  __m128 m;
+  SIMDMask() {}
+  SIMDMask(__m128 x) : m(x) {}
+};
+
+inline SIMDFloat operator+(SIMDFloat a, SIMDFloat b) { return _mm_add_ps(a.v, b.v); }
+inline SIMDFloat operator-(SIMDFloat a, SIMDFloat b) { return _mm_sub_ps(a.v, b.v); }
+inline SIMDFloat operator*(SIMDFloat a, SIMDFloat b) { return _mm_mul_ps(a.v, b.v); }
+inline SIMDFloat operator/(SIMDFloat a, SIMDFloat b) { return _mm_div_ps(a.v, b.v); }
+inline SIMDFloat operator-(SIMDFloat a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.f)); }
+
+inline SIMDFloat SIMDLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void SIMDStore(float* p, SIMDFloat a) { _mm_storeu_ps(p, a.v); }
+
+// SIMD_WIDTH signed 16 bit integers converted to float
+inline SIMDFloat SIMDLoadInt16(const int16_t* p) {
+  __m128i h = _mm_loadl_epi64((const __m128i*)p);
+  return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(h, h), 16));
+}
+
+// SIMD_WIDTH half precision values converted to float, see HalfToFloat()
+inline SIMDFloat SIMDLoadHalf(const uint16_t* p) {
+  __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+  __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+  __m128i mag = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+  __m128 f = _mm_mul_ps(_mm_castsi128_ps(mag), _mm_set1_ps(5.192296858534828e33f));
+  return _mm_or_ps(f, _mm_castsi128_ps(sign));
+}
+
+inline SIMDFloat SIMDMin(SIMDFloat a, SIMDFloat b) { return _mm_min_ps(a.v, b.v); }
+inline SIMDFloat SIMDMax(SIMDFloat a, SIMDFloat b) { return _mm_max_ps(a.v, b.v); }
+inline SIMDFloat SIMDAbs(SIMDFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+
+inline SIMDMask SIMDLess(SIMDFloat a, SIMDFloat b) { return _mm_cmplt_ps(a.v, b.v); }
+inline SIMDMask SIMDGreaterEqual(SIMDFloat a, SIMDFloat b) { return _mm_cmpge_ps(a.v, b.v); }
+inline SIMDMask operator&(SIMDMask a, SIMDMask b) { return _mm_and_ps(a.m, b.m); }
+inline SIMDMask operator|(SIMDMask a, SIMDMask b) { return _mm_or_ps(a.m, b.m); }
+
+// per lane mask ? a : b
+inline SIMDFloat SIMDSelect(SIMDMask mask, SIMDFloat a, SIMDFloat b) {
+  return _mm_or_ps(_mm_and_ps(mask.m, a.v), _mm_andnot_ps(mask.m, b.v));
+}
+
+// one bit per lane
+inline int SIMDMaskBits(SIMDMask mask) { return _mm_movemask_ps(mask.m); }
+
+// lanes of a moved up by one, lane 0 filled from the last lane of b
+inline SIMDFloat SIMDShiftIn(SIMDFloat a, SIMDFloat b) {
+  __m128 u = _mm_shuffle_ps(b.v, a.v, _MM_SHUFFLE(0, 0, 3, 3));
+  return _mm_shuffle_ps(u, a.v, _MM_SHUFFLE(2, 1, 2, 0));
+}
+
+#elif defined(SIMD_NEON)
+
+struct SIMDFloat {
+  float32x4_t v;
+  SIMDFloat() {}
+  SIMDFloat(float32x4_t x) : v(x) {}
+  SIMDFloat(float x) : v(vdupq_n_f32(x)) {}
+};
+
+struct SIMDMask {
+  uint32x4_t m;
+  SIMDMask() {}
+  SIMDMask(uint32x4_t x) : m(x) {}
+};
+
+inline SIMDFloat operator+(SIMDFloat a, SIMDFloat b) { return vaddq_f32(a.v, b.v); }
+inline SIMDFloat operator-(SIMDFloat a, SIMDFloat b) { return vsubq_f32(a.v, b.v); }
+inline SIMDFloat operator*(SIMDFloat a, SIMDFloat b) { return vmulq_f32(a.v, b.v); }
+inline SIMDFloat operator-(SIMDFloat a) { return vnegq_f32(a.v); }
+
+inline SIMDFloat operator/(SIMDFloat a, SIMDFloat b) {
+#if defined(__aarch64__)
+  return vdivq_f32(a.v, b.v);
+#else
+  // reciprocal estimate with two newton steps
+  float32x4_t r = vrecpeq_f32(b.v);
+  r = vmulq_f32(vrecpsq_f32(b.v, r), r);
+  r = vmulq_f32(vrecpsq_f32(b.v, r), r);
+  return vmulq_f32(a.v, r);
+#endif
+}
+
+inline SIMDFloat SIMDLoad(const float* p) { return vld1q_f32(p); }
+inline void SIMDStore(float* p, SIMDFloat a) { vst1q_f32(p, a.v); }
+
+// SIMD_WIDTH signed 16 bit integers converted to float
+inline SIMDFloat SIMDLoadInt16(const int16_t* p) { return vcvtq_f32_s32(vmovl_s16(vld1_s16(p))); }
+
+// SIMD_WIDTH half precision values converted to float, see HalfToFloat()
+inline SIMDFloat SIMDLoadHalf(const uint16_t* p) {
+  uint32x4_t h = vmovl_u16(vld1_u16(p));
+  uint32x4_t sign = vshlq_n_u32(vandq_u32(h, vdupq_n_u32(0x8000)), 16);
+  uint32x4_t mag = vshlq_n_u32(vandq_u32(h, vdupq_n_u32(0x7fff)), 13);
+  float32x4_t f = vmulq_f32(vreinterpretq_f32_u32(mag), vdupq_n_f32(5.192296858534828e33f));
+  return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(f), sign));
+}
+
+inline SIMDFloat SIMDMin(SIMDFloat a, SIMDFloat b) { return vminq_f32(a.v, b.v); }
+inline SIMDFloat SIMDMax(SIMDFloat a, SIMDFloat b) { return vmaxq_f32(a.v, b.v); }
+inline SIMDFloat SIMDAbs(SIMDFloat a) { return vabsq_f32(a.v); }
+
+inline SIMDMask SIMDLess(SIMDFloat a, SIMDFloat b) { return vcltq_f32(a.v, b.v); }
+inline SIMDMask SIMDGreaterEqual(SIMDFloat a, SIMDFloat b) { return vcgeq_f32(a.v, b.v); }
+inline SIMDMask operator&(SIMDMask a, SIMDMask b) { return vandq_u32(a.m, b.m); }
+inline SIMDMask operator|(SIMDMask a, SIMDMask b) { return vorrq_u32(a.m, b.m); }
+
+// per lane mask ? a : b
+inline SIMDFloat SIMDSelect(SIMDMask mask, SIMDFloat a, SIMDFloat b) { return vbslq_f32(mask.m, a.v, b.v); }
+
+// one bit per lane
+inline int SIMDMaskBits(SIMDMask mask) {
+  static const int32_t shift[4] = {0, 1, 2, 3};
+  uint32x4_t bits = vshlq_u32(vshrq_n_u32(mask.m, 31), vld1q_s32(shift));
+  return vgetq_lane_u32(bits, 0) | vgetq_lane_u32(bits, 1) | vgetq_lane_u32(bits, 2) | vgetq_lane_u32(bits, 3);
+}
+
+// lanes of a moved up by one, lane 0 filled from the last lane of b
+inline SIMDFloat SIMDShiftIn(SIMDFloat a, SIMDFloat b) { return vextq_f32(b.v, a.v, 3); }
+
+#else
+
+// emulated lanes, left for the compiler to vectorize where it can
+struct SIMDFloat {
+  float v[SIMD_WIDTH];
+  SIMDFloat() {}
+  SIMDFloat(float x) { for(int l=0; l<SIMD_WIDTH; l++) v[l] = x; }
+};
+
+struct SIMDMask {
+  bool m[SIMD_WIDTH];
+};
+
+#define SIMD_SCALAR_OP(op) \
+  inline SIMDFloat operator op(SIMDFloat a, SIMDFloat b) { \
+    SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = a.v[l] op b.v[l]; return r; }
+
+SIMD_SCALAR_OP(+)
+SIMD_SCALAR_OP(-)
+SIMD_SCALAR_OP(*)
+SIMD_SCALAR_OP(/)
+
+inline SIMDFloat operator-(SIMDFloat a) { SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = -a.v[l]; return r; }
+
+inline SIMDFloat SIMDLoad(const float* p) { SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = p[l]; return r; }
+inline void SIMDStore(float* p, SIMDFloat a) { for(int l=0; l<SIMD_WIDTH; l++) p[l] = a.v[l]; }
+
+// SIMD_WIDTH signed 16 bit integers converted to float
+inline SIMDFloat SIMDLoadInt16(const int16_t* p) { SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = (float)p[l]; return r; }
+
+// SIMD_WIDTH half precision values converted to float
+inline SIMDFloat SIMDLoadHalf(const uint16_t* p) { SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = HalfToFloat(p[l]); return r; }
+
+inline SIMDFloat SIMDMin(SIMDFloat a, SIMDFloat b) {
+  SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = a.v[l] < b.v[l] ? a.v[l] : b.v[l]; return r;
+}
+inline SIMDFloat SIMDMax(SIMDFloat a, SIMDFloat b) {
+  SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = a.v[l] > b.v[l] ? a.v[l] : b.v[l]; return r;
+}
+inline SIMDFloat SIMDAbs(SIMDFloat a) {
+  SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = a.v[l] < 0.f ? -a.v[l] : a.v[l]; return r;
+}
+
+inline SIMDMask SIMDLess(SIMDFloat a, SIMDFloat b) {
+  SIMDMask r; for(int l=0; l<SIMD_WIDTH; l++) r.m[l] = a.v[l] < b.v[l]; return r;
+}
+inline SIMDMask SIMDGreaterEqual(SIMDFloat a, SIMDFloat b) {
+  SIMDMask r; for(int l=0; l<SIMD_WIDTH; l++) r.m[l] = a.v[l] >= b.v[l]; return r;
+}
+inline SIMDMask operator&(SIMDMask a, SIMDMask b) {
+  SIMDMask r; for(int l=0; l<SIMD_WIDTH; l++) r.m[l] = a.m[l] && b.m[l]; return r;
+}
+inline SIMDMask operator|(SIMDMask a, SIMDMask b) {
+  SIMDMask r; for(int l=0; l<SIMD_WIDTH; l++) r.m[l] = a.m[l] || b.m[l]; return r;
+}
+
+// per lane mask ? a : b
+inline SIMDFloat SIMDSelect(SIMDMask mask, SIMDFloat a, SIMDFloat b) {
+  SIMDFloat r; for(int l=0; l<SIMD_WIDTH; l++) r.v[l] = mask.m[l] ? a.v[l] : b.v[l]; return r;
+}
+
+// one bit per lane
+inline int SIMDMaskBits(SIMDMask mask) {
+  int bits = 0; for(int l=0; l<SIMD_WIDTH; l++) bits |= mask.m[l] << l; return bits;
+}
+
+// lanes of a moved up by one, lane 0 filled from the last lane of b
+inline SIMDFloat SIMDShiftIn(SIMDFloat a, SIMDFloat b) {
+  SIMDFloat r; r.v[0] = b.v[SIMD_WIDTH-1]; for(int l=1; l<SIMD_WIDTH; l++) r.v[l] = a.v[l-1]; return r;
+}
+
+#endif
+
+inline SIMDFloat& operator+=(SIMDFloat &a, SIMDFloat b) { a = a + b; return a; }
+inline SIMDFloat& operator-=(SIMDFloat &a, SIMDFloat b) { a = a - b; return a; }
+inline SIMDFloat& operator*=(SIMDFloat &a, SIMDFloat b) { a = a * b; return a; }
+
+// mask with every lane set
+inline SIMDMask SIMDTrueMask() { return SIMDGreaterEqual(SIMDFloat(0.f), SIMDFloat(0.f)); }
+
+// true if any lane of the mask is set
+inline bool SIMDAnyTrue(SIMDMask mask) { return SIMDMaskBits(mask) != 0; }
+
+// clamp lanes to lo..hi
+inline SIMDFloat SIMDClamp(SIMDFloat x, SIMDFloat lo, SIMDFloat hi) { return SIMDMin(SIMDMax(x, lo), hi); }
+
+// lane numbers 0, 1, 2, ...
+inline SIMDFloat SIMDLaneIndex() {
+  static const float index[8] = {0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f};
+  return SIMDLoad(index);
+}
+
+// number of vector groups needed for a voice count
+inline int SIMDGroups(int voices) { return (voices + SIMD_WIDTH - 1)/SIMD_WIDTH; }
+
+#endif
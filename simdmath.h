@@ -0,0 +1,459 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __kocmocsimdmathh__
+#define __kocmocsimdmathh__
+
+#include "simd.h"
+#include "fastmath.h"
+#include "adaa.h"
+
+// vector versions of the fastmath.h approximants, evaluated in single
+// precision on all lanes
+
+// pade 9/8 approximant for sinh
+inline SIMDFloat SinhPade98(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return x*((((4585922449.f*x2 + 1066023933480.f)*x2 + 83284044283440.f)*x2 + 2303682236856000.f)*x2 + 15605159573203200.f)/
+            (45.f*((((1029037.f*x2 - 345207016.f)*x2 + 61570292784.f)*x2 - 6603948711360.f)*x2 + 346781323848960.f));
+}
+
+// pade 9/8 approximant for asinh
+inline SIMDFloat ASinhPade98(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return x*((((4474275508260072601.f*x2 + 152904157921385089560.f)*x2 + 876802506140506785840.f)*x2 + 1599149222427667310400.f)*x2 + 900717260398840684800.f)/
+    (315.f*((((42981288509837475.f*x2 + 779000561224162200.f)*x2 + 3494582558460865872.f)*x2 + 5553234177230076480.f)*x2 + 2859419874282033920.f));
+}
+
+// pade 5/4 approximant for sinh
+inline SIMDFloat SinhPade54(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return x*((551.f*x2 + 22260.f)*x2 + 166320.f)/(15.f*((5.f*x2 - 364.f)*x2 + 11088.f));
+}
+
+// pade 5/4 approximant for cosh
+inline SIMDFloat CoshPade54(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return ((313.f*x2 + 6900.f)*x2 + 15120.f)/((13.f*x2 - 660.f)*x2 + 15120.f);
+}
+
+// pade 5/4 approximant for asinh
+inline SIMDFloat ASinhPade54(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return x*((69049.f*x2 + 717780.f)*x2 + 922320.f)/(15.f*((9675.f*x2 + 58100.f)*x2 + 61488.f));
+}
+
+// pade 5/4 approximant for derivative of asinh
+inline SIMDFloat dASinhPade54(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+  SIMDFloat n = (((44536605.f*x2 + 339381280.f)*x2 + 2410740304.f)*x2 + 5254518528.f)*x2 + 3780774144.f;
+  SIMDFloat d = (9675.f*x2 + 58100.f)*x2 + 61488.f;
+
+  // return approximant
+  return n/(d*d);
+}
+
+// pade 3/2 approximant for sinh
+inline SIMDFloat SinhPade32(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return -(x*(7.f*x2 + 60.f))/(3.f*(x2 - 20.f));
+}
+
+// pade 3/4 approximant for sinh
+inline SIMDFloat SinhPade34(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return (20.f*x*(31.f*x2*x2 + 294.f))/((11.f*x2 - 360.f)*x2 + 5880.f);
+}
+
+// pade 3/2 approximant for cosh
+inline SIMDFloat CoshPade32(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return -(5.f*x2 + 12.f)/(x2 - 12.f);
+}
+
+// pade 3/4 approximant for cosh
+inline SIMDFloat CoshPade34(SIMDFloat x) {
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return (4.f*(61.f*x2 + 150.f))/((3.f*x2 - 56.f)*x2 + 600.f);
+}
+
+// pade 3/2 approximant for tanh
+inline SIMDFloat TanhPade32(SIMDFloat x) {
+  // clamp x to -3..3
+  x = SIMDClamp(x, -3.f, 3.f);
+
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return x*(15.f + x2)/(15.f + 6.f*x2);
+}
+
+// pade 5/4 approximant for tanh
+inline SIMDFloat TanhPade54(SIMDFloat x) {
+  // clamp x to -4..4
+  x = SIMDClamp(x, -4.f, 4.f);
+
+  SIMDFloat x2 = x*x;
+
+  // return approximant
+  return x*((x2 + 105.f)*x2 + 945.f)/((15.f*x2 + 420.f)*x2 + 945.f);
+}
+
+// minimax tanh, max relative error 4.2e-3 on -3..3
+inline SIMDFloat TanhMinimax(SIMDFloat x) {
+  // clamp x to -3..3
+  x = SIMDClamp(x, -3.f, 3.f);
+
+  SIMDFloat x2 = x*x;
+  SIMDFloat x4 = x2*x2;
+
+  // return approximant
+  return x*((1.f - 3.10410823e-1f*x2) + x4*((8.60343469e-2f - 1.46265975e-2f*x2) + x4*(1.29517081e-3f - 4.53793306e-5f*x2)));
+}
+
+// minimax sinh, max relative error 5.3e-5 on -4..4
+inline SIMDFloat SinhMinimax(SIMDFloat x) {
+  SIMDFloat xc = SIMDClamp(x, -MINIMAX_RANGE, MINIMAX_RANGE);
+  SIMDFloat x2 = xc*xc;
+  SIMDFloat x4 = x2*x2;
+
+  // return approximant
+  return xc*((1.f + 1.665289551e-1f*x2) + x4*((8.425804786e-3f + 1.808139205e-4f*x2) + x4*3.976639164e-6f)) +
+    MINIMAX_SINH_SLOPE*(x - xc);
+}
+
+// derivative of the minimax sinh, max relative error 1.8e-4 on -4..4
+inline SIMDFloat CoshMinimax(SIMDFloat x) {
+  SIMDFloat xc = SIMDClamp(x, -MINIMAX_RANGE, MINIMAX_RANGE);
+  SIMDFloat x2 = xc*xc;
+  SIMDFloat x4 = x2*x2;
+
+  // return approximant
+  return (1.f + 3.f*1.665289551e-1f*x2) + x4*((5.f*8.425804786e-3f + 7.f*1.808139205e-4f*x2) + x4*(9.f*3.976639164e-6f));
+}
+
+// minimax asinh, max relative error 6.8e-3 on -4..4
+inline SIMDFloat ASinhMinimax(SIMDFloat x) {
+  SIMDFloat xc = SIMDClamp(x, -MINIMAX_RANGE, MINIMAX_RANGE);
+  SIMDFloat x2 = xc*xc;
+  SIMDFloat x4 = x2*x2;
+
+  // return approximant
+  return xc*((1.f - 1.380802244e-1f*x2) + x4*((2.757754736e-2f - 3.567796666e-3f*x2) + x4*((2.640786988e-4f - 1.019273441e-5f*x2) + x4*1.589768743e-7f))) +
+    MINIMAX_ASINH_SLOPE*(x - xc);
+}
+
+// derivative of the minimax asinh, max relative error 3.4e-2 on -4..4
+inline SIMDFloat dASinhMinimax(SIMDFloat x) {
+  SIMDFloat xc = SIMDClamp(x, -MINIMAX_RANGE, MINIMAX_RANGE);
+  SIMDFloat x2 = xc*xc;
+  SIMDFloat x4 = x2*x2;
+
+  // return approximant
+  return (1.f - 3.f*1.380802244e-1f*x2) + x4*((5.f*2.757754736e-2f - 7.f*3.567796666e-3f*x2) + x4*((9.f*2.640786988e-4f - 11.f*1.019273441e-5f*x2) + x4*(13.f*1.589768743e-7f)));
+}
+
+// apply a vector approximant to an array, SIMD_WIDTH values at a time.
+// the tail goes through a zero padded vector, in and out may be the
+// same array:
+//
+//   SIMDApplyBlock<TanhPade32>(in, out, n);
+template <SIMDFloat (*f)(SIMDFloat)>
+inline void SIMDApplyBlock(const float* in, float* out, int n) {
+  int i = 0;
+
+  for(; i + SIMD_WIDTH <= n; i += SIMD_WIDTH){
+    SIMDStore(out + i, f(SIMDLoad(in + i)));
+  }
+
+  if(i < n){
+    float lanes[SIMD_WIDTH];
+
+    for(int l=0; l<SIMD_WIDTH; l++){
+      lanes[l] = i + l < n ? in[i + l] : 0.f;
+    }
+    SIMDStore(lanes, f(SIMDLoad(lanes)));
+    for(int l=0; i + l < n; l++){
+      out[i + l] = lanes[l];
+    }
+  }
+}
+
+// apply a scalar function lane by lane
+inline SIMDFloat SIMDMap(float (*f)(float), SIMDFloat x) {
+  float lanes[SIMD_WIDTH];
+
+  SIMDStore(lanes, x);
+  for(int l=0; l<SIMD_WIDTH; l++){
+    lanes[l] = f(lanes[l]);
+  }
+
+  return SIMDLoad(lanes);
+}
+
+// vector nonlinearities of an approximant set, resolved at compile time
+template <FastmathApproximation approximation>
+struct SIMDFastmath {
+  static inline SIMDFloat Tanh(SIMDFloat x) {
+    return approximation == FASTMATH_MINIMAX ? TanhMinimax(x) : TanhPade32(x);
+  }
+
+  static inline SIMDFloat Sinh(SIMDFloat x) {
+    return approximation == FASTMATH_MINIMAX ? SinhMinimax(x) : SinhPade54(x);
+  }
+
+  static inline SIMDFloat Cosh(SIMDFloat x) {
+    return approximation == FASTMATH_MINIMAX ? CoshMinimax(x) : CoshPade54(x);
+  }
+
+  static inline SIMDFloat ASinh(SIMDFloat x) {
+    return approximation == FASTMATH_MINIMAX ? ASinhMinimax(x) : ASinhPade54(x);
+  }
+
+  static inline SIMDFloat dASinh(SIMDFloat x) {
+    return approximation == FASTMATH_MINIMAX ? dASinhMinimax(x) : dASinhPade54(x);
+  }
+};
+
+// vector nonlinearities of an approximant set selected at run time
+struct SIMDFastmathRuntime {
+  FastmathApproximation approximation;
+
+  inline SIMDFloat Tanh(SIMDFloat x) const {
+    return approximation == FASTMATH_MINIMAX ? TanhMinimax(x) : TanhPade32(x);
+  }
+
+  inline SIMDFloat Sinh(SIMDFloat x) const {
+    return approximation == FASTMATH_MINIMAX ? SinhMinimax(x) : SinhPade54(x);
+  }
+};
+
+// vector log1p(z)/z of adaa.h. the powers of two reduction is unrolled
+// into conditional scalings, which cover 1 + z in 2^-31..2^31
+inline SIMDFloat Log1pRatio(SIMDFloat z) {
+  static const float scales[5] = {65536.f, 256.f, 16.f, 4.f, 2.f};
+  static const float exponents[5] = {16.f, 8.f, 4.f, 2.f, 1.f};
+  SIMDFloat w = 1.f + z;
+  SIMDFloat e = 0.f;
+
+  // reduce to sqrt(1/2)..sqrt(2)
+  for(int k=0; k<5; k++){
+    SIMDMask high = SIMDGreaterEqual(w, 0.707106781f*scales[k]);
+    w = SIMDSelect(high, w*(1.f/scales[k]), w);
+    e = SIMDSelect(high, e + exponents[k], e);
+
+    SIMDMask low = SIMDLess(w, 1.41421356f/scales[k]);
+    w = SIMDSelect(low, w*scales[k], w);
+    e = SIMDSelect(low, e - exponents[k], e);
+  }
+
+  // unreduced lanes take s from z to keep the digits near the origin
+  SIMDMask unreduced = SIMDLess(SIMDAbs(e), 0.5f);
+  SIMDFloat s = SIMDSelect(unreduced, z/(2.f + z), (w - 1.f)/(w + 1.f));
+  SIMDFloat t = s*s;
+  SIMDFloat atanh = 1.f + t*(1.f/3.f + t*(1.f/5.f + t*(1.f/7.f + t*(1.f/9.f))));
+
+  return SIMDSelect(unreduced, 2.f/(2.f + z)*atanh, (e*0.693147181f + 2.f*s*atanh)/z);
+}
+
+// vector atan(r)/r of adaa.h
+inline SIMDFloat AtanRatio(SIMDFloat r) {
+  SIMDFloat a = SIMDAbs(r);
+  SIMDMask reduced = SIMDLess(0.414213562f, a);
+  SIMDMask large = SIMDLess(2.41421356f, a);
+  SIMDFloat t = SIMDSelect(large, -1.f/a, SIMDSelect(reduced, (a - 1.f)/(a + 1.f), a));
+  SIMDFloat offset = SIMDSelect(large, 1.57079633f, SIMDSelect(reduced, 0.785398163f, 0.f));
+  SIMDFloat z = t*t;
+  SIMDFloat poly = z*(((8.05374449538e-2f*z - 1.38776856032e-1f)*z + 1.99777106478e-1f)*z - 3.33329491539e-1f);
+
+  return SIMDSelect(reduced, (offset + t + t*poly)/a, 1.f + poly);
+}
+
+// vector mean of a clamped odd approximant, see adaa.h
+template <SIMDFloat (*inner)(SIMDFloat, SIMDFloat)>
+inline SIMDFloat ClampedMean(SIMDFloat x, SIMDFloat y, float edge, float slope, float curvature) {
+  SIMDFloat cx = SIMDClamp(x, -edge, edge);
+  SIMDFloat cy = SIMDClamp(y, -edge, edge);
+  SIMDFloat dx = SIMDAbs(x - cx);
+  SIMDFloat dy = SIMDAbs(y - cy);
+  SIMDFloat m = inner(cx, cy);
+  SIMDFloat c = slope + 0.5f*curvature*(dx + dy);
+
+  // lanes with a segment beyond one edge or crossing an edge
+  SIMDMask xout = SIMDLess(0.f, dx);
+  SIMDMask yout = SIMDLess(0.f, dy);
+  SIMDMask beyond = xout & yout & SIMDLess(0.f, x*y);
+  SIMDMask crossing = xout | yout;
+  SIMDFloat mean = ((cx - cy)*m + (dx - dy)*c)/SIMDSelect(crossing, x - y, 1.f);
+
+  return SIMDSelect(beyond, SIMDSelect(SIMDLess(x, 0.f), -c, c), SIMDSelect(crossing, mean, m));
+}
+
+inline SIMDFloat TanhPade32InnerMean(SIMDFloat x, SIMDFloat y) {
+  SIMDFloat r = 1.f/(2.5f + y*y);
+  SIMDFloat z = (x - y)*(x + y)*r;
+
+  return (x + y)*(1.f/12.f + 25.f/24.f*r*Log1pRatio(z));
+}
+
+inline SIMDFloat TanhPade32Mean(SIMDFloat x, SIMDFloat y) {
+  return ClampedMean<TanhPade32InnerMean>(x, y, 3.f, TanhPade32(3.f), 0.f);
+}
+
+inline SIMDFloat SinhPade54Mean(SIMDFloat x, SIMDFloat y) {
+  const float c = 29.877081517444104f;
+  SIMDFloat sum = x + y;
+  SIMDFloat u = x*x;
+  SIMDFloat v = y*y;
+  SIMDFloat du = (x - y)*sum;
+
+  // logarithm part
+  SIMDFloat n = 5.f*(u + v) - 364.f;
+  SIMDFloat d = (5.f*v - 364.f)*v + 11088.f;
+  SIMDFloat lg = 207.90933333333333f*n/d*Log1pRatio(du*n/d);
+
+  // arctangent part, lanes near the diagonal take the angle difference
+  // quotient and the rest the atan2 form
+  SIMDFloat p = (u - 36.4f)*(1.f/c);
+  SIMDFloat q = (v - 36.4f)*(1.f/c);
+  SIMDFloat dp = du*(1.f/c);
+  SIMDFloat D = 1.f + p*q;
+  SIMDMask diagonal = SIMDGreaterEqual(D, 0.5f);
+  SIMDFloat Dd = SIMDSelect(diagonal, D, 1.f);
+  SIMDFloat dpa = SIMDSelect(diagonal, 1.f, SIMDAbs(dp));
+  SIMDFloat w = D/dpa;
+  SIMDFloat angle = 1.57079633f - w*AtanRatio(w);
+  SIMDFloat at = SIMDSelect(diagonal, sum/(c*Dd)*AtanRatio(dp/Dd),
+			    SIMDSelect(SIMDLess(0.f, dp), angle, -angle)/SIMDSelect(diagonal, 1.f, x - y));
+
+  return sum*(3.6733333333333333f + lg) + 271.06447669388960f*at;
+}
+
+inline SIMDFloat TanhMinimaxInnerMean(SIMDFloat x, SIMDFloat y) {
+  SIMDFloat u = x*x;
+  SIMDFloat v = y*y;
+  SIMDFloat c5 = -4.53793306e-5f/12.f;
+  SIMDFloat c4 = 1.29517081e-3f/10.f + v*c5;
+  SIMDFloat c3 = -1.46265975e-2f/8.f + v*c4;
+  SIMDFloat c2 = 8.60343469e-2f/6.f + v*c3;
+  SIMDFloat c1 = -3.10410823e-1f/4.f + v*c2;
+  SIMDFloat c0 = 0.5f + v*c1;
+
+  return (x + y)*(c0 + u*(c1 + u*(c2 + u*(c3 + u*(c4 + u*c5)))));
+}
+
+inline SIMDFloat TanhMinimaxMean(SIMDFloat x, SIMDFloat y) {
+  return ClampedMean<TanhMinimaxInnerMean>(x, y, 3.f, TanhMinimax(3.f), 0.f);
+}
+
+inline SIMDFloat SinhMinimaxInnerMean(SIMDFloat x, SIMDFloat y) {
+  SIMDFloat u = x*x;
+  SIMDFloat v = y*y;
+  SIMDFloat c4 = 3.976639164e-6f/10.f;
+  SIMDFloat c3 = 1.808139205e-4f/8.f + v*c4;
+  SIMDFloat c2 = 8.425804786e-3f/6.f + v*c3;
+  SIMDFloat c1 = 1.665289551e-1f/4.f + v*c2;
+  SIMDFloat c0 = 0.5f + v*c1;
+
+  return (x + y)*(c0 + u*(c1 + u*(c2 + u*(c3 + u*c4))));
+}
+
+inline SIMDFloat SinhMinimaxMean(SIMDFloat x, SIMDFloat y) {
+  return ClampedMean<SinhMinimaxInnerMean>(x, y, MINIMAX_RANGE, SinhMinimax(MINIMAX_RANGE), MINIMAX_SINH_SLOPE);
+}
+
+// the library sinh has no vector form, its two evaluations go through
+// sinhf per lane like the pointwise mapping
+inline SIMDFloat SinhLibraryMean(SIMDFloat x, SIMDFloat y) {
+  SIMDFloat h = 0.5f*(x - y);
+  SIMDMask small = SIMDLess(SIMDAbs(h), 1.0e-3f);
+  SIMDFloat shc = SIMDSelect(small, 1.f + h*h*(1.f/6.f), SIMDMap(sinhf, h)/SIMDSelect(small, 1.f, h));
+
+  return SIMDMap(sinhf, 0.5f*(x + y))*shc;
+}
+
+// vector antiderivative antialiasing, state points to one state per lane
+template <SIMDFloat (*m)(SIMDFloat, SIMDFloat)>
+inline SIMDFloat ADAAEvaluateLanes(ADAAState* state, SIMDFloat x) {
+  float lanes[SIMD_WIDTH];
+
+  for(int l=0; l<SIMD_WIDTH; l++){
+    lanes[l] = state[l].x1;
+  }
+  SIMDFloat y = m(x, SIMDLoad(lanes));
+
+  SIMDStore(lanes, x);
+  for(int l=0; l<SIMD_WIDTH; l++){
+    state[l].x1 = lanes[l];
+  }
+
+  return y;
+}
+
+// antialiased vector nonlinearities of an approximant set
+template <FastmathApproximation approximation>
+struct SIMDFastmathADAA {
+  static inline SIMDFloat Tanh(ADAAState* state, SIMDFloat x) {
+    return approximation == FASTMATH_MINIMAX ? ADAAEvaluateLanes<TanhMinimaxMean>(state, x) :
+      ADAAEvaluateLanes<TanhPade32Mean>(state, x);
+  }
+
+  static inline SIMDFloat Sinh(ADAAState* state, SIMDFloat x) {
+    return approximation == FASTMATH_MINIMAX ? ADAAEvaluateLanes<SinhMinimaxMean>(state, x) :
+      ADAAEvaluateLanes<SinhPade54Mean>(state, x);
+  }
+};
+
+// antialiased vector nonlinearities of an approximant set selected at
+// run time
+struct SIMDFastmathADAARuntime {
+  FastmathApproximation approximation;
+
+  inline SIMDFloat Tanh(ADAAState* state, SIMDFloat x) const {
+    return approximation == FASTMATH_MINIMAX ? SIMDFastmathADAA<FASTMATH_MINIMAX>::Tanh(state, x) :
+      SIMDFastmathADAA<FASTMATH_PADE>::Tanh(state, x);
+  }
+
+  inline SIMDFloat Sinh(ADAAState* state, SIMDFloat x) const {
+    return approximation == FASTMATH_MINIMAX ? SIMDFastmathADAA<FASTMATH_MINIMAX>::Sinh(state, x) :
+      SIMDFastmathADAA<FASTMATH_PADE>::Sinh(state, x);
+  }
+};
+
+#endif
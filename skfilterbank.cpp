@@ -0,0 +1,484 @@
+/*
+ *  (C) 2021 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Sallen-Key Filter OWL Patch.
+ *
+ *  Sallen-Key Filter OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Sallen-Key Filter OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Sallen-Key Filter OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include "skfilterbank.h"
+#include "simdmath.h"
+#include "newton.h"
+
+// downsampling passthrough bandwidth
+#define IIR_DOWNSAMPLING_BANDWIDTH 0.9
+
+// trapezoidal equation c*x + alpha/4*sinh(4*x) = D_n per lane
+template <FastmathApproximation approximation>
+struct SKTrapezoidalLanesResidual {
+  SIMDFloat alpha, c, D_n;
+
+  inline void Evaluate(SIMDFloat x, SIMDFloat& f, SIMDFloat& df, SIMDFloat& d2f) const {
+    SIMDFloat s = SIMDFastmath<approximation>::Sinh(4.f*x);
+
+    f = c*x + 0.25f*alpha*s - D_n;
+    df = c + alpha*SIMDFastmath<approximation>::Cosh(4.f*x);
+    d2f = 4.f*alpha*s;
+  }
+};
+
+// lane masked newton-raphson solve of the trapezoidal equation from x, the
+// approximant branch is taken once per solve rather than once per
+// evaluation
+static inline NewtonLanesResult SKTrapezoidalLanesSolve(FastmathApproximation approximation, NewtonStep step,
+							SIMDFloat alpha, SIMDFloat c, SIMDFloat D_n,
+							SIMDFloat x, SIMDFloat tolerance, bool report){
+  if(approximation == FASTMATH_MINIMAX){
+    SKTrapezoidalLanesResidual<FASTMATH_MINIMAX> residual = {alpha, c, D_n};
+    return NewtonSolveLanes<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+  }
+
+  SKTrapezoidalLanesResidual<FASTMATH_PADE> residual = {alpha, c, D_n};
+  return NewtonSolveLanes<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+}
+
+// constructor
+SKFilterBank::SKFilterBank(int newVoices, float newCutoff, float newResonance, int newOversamplingFactor,
+			   SKFilterMode newFilterMode, float newSampleRate, SKIntegrationMethod newIntegrationMethod){
+  Initialize(newVoices, newCutoff, newResonance, newOversamplingFactor,
+	     newFilterMode, newSampleRate, newIntegrationMethod);
+}
+
+// default parameter constructor
+SKFilterBank::SKFilterBank(int newVoices){
+  Initialize(newVoices, 0.25, 0.5, 2, SK_LOWPASS_MODE, 44100.0, SK_TRAPEZOIDAL);
+}
+
+// destructor
+SKFilterBank::~SKFilterBank(){
+  delete[] cutoffFrequency;
+  delete[] Resonance;
+  delete[] dt;
+  delete[] p0;
+  delete[] p1;
+  delete[] u_t1;
+  delete[] xk_t1;
+  delete[] xk_t2;
+  delete iir;
+  delete newtonStats;
+}
+
+void SKFilterBank::Initialize(int newVoices, float newCutoff, float newResonance, int newOversamplingFactor,
+			      SKFilterMode newFilterMode, float newSampleRate, SKIntegrationMethod newIntegrationMethod){
+  voices = newVoices;
+  groups = SIMDGroups(voices);
+
+  // allocate per voice vectors padded to whole vector groups
+  int lanes = groups*SIMD_WIDTH;
+  cutoffFrequency = new float[lanes];
+  Resonance = new float[lanes];
+  dt = new float[lanes];
+  p0 = new float[lanes];
+  p1 = new float[lanes];
+  u_t1 = new float[lanes];
+  xk_t1 = new float[lanes];
+  xk_t2 = new float[lanes];
+
+  // initialize filter parameters
+  oversamplingFactor = newOversamplingFactor;
+  filterMode = newFilterMode;
+  sampleRate = newSampleRate;
+  integrationMethod = newIntegrationMethod;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+
+  for(int v=0; v<lanes; v++){
+    cutoffFrequency[v] = newCutoff;
+    Resonance[v] = newResonance;
+    SetFilterIntegrationRate(v);
+
+    // initialize filter state
+    p0[v] = p1[v] = u_t1[v] = 0.0;
+    xk_t1[v] = xk_t2[v] = 0.0;
+  }
+
+  SelectKernel();
+
+  // instantiate downsampling filters
+  iir = new IIRLowpassBank(voices, sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, SK_IIR_DOWNSAMPLE_ORDER);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
+}
+
+void SKFilterBank::ResetFilterState(){
+  for(int v=0; v<groups*SIMD_WIDTH; v++){
+    // initialize filter parameters
+    cutoffFrequency[v] = 0.25;
+    Resonance[v] = 0.5;
+    SetFilterIntegrationRate(v);
+
+    // initialize filter state
+    p0[v] = p1[v] = u_t1[v] = 0.0;
+    xk_t1[v] = xk_t2[v] = 0.0;
+  }
+
+  // set oversampling
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+}
+
+void SKFilterBank::SetFilterCutoff(int voice, float newCutoff){
+  cutoffFrequency[voice] = newCutoff;
+
+  SetFilterIntegrationRate(voice);
+}
+
+void SKFilterBank::SetFilterResonance(int voice, float newResonance){
+  Resonance[voice] = newResonance;
+}
+
+void SKFilterBank::SetFilterOversamplingFactor(int newOversamplingFactor){
+  oversamplingFactor = newOversamplingFactor;
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+
+  for(int v=0; v<voices; v++){
+    SetFilterIntegrationRate(v);
+  }
+  SelectKernel();
+}
+
+void SKFilterBank::SetFilterMode(SKFilterMode newFilterMode){
+  filterMode = newFilterMode;
+  SelectKernel();
+}
+
+void SKFilterBank::SetFilterSampleRate(float newSampleRate){
+  sampleRate = newSampleRate;
+  iir->SetFilterParameters(sampleRate * (float)(oversamplingFactor), IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+
+  for(int v=0; v<voices; v++){
+    SetFilterIntegrationRate(v);
+  }
+}
+
+void SKFilterBank::SetFilterIntegrationMethod(SKIntegrationMethod method){
+  integrationMethod = method;
+  SelectKernel();
+}
+
+void SKFilterBank::SetFilterApproximation(FastmathApproximation newApproximation){
+  approximation = newApproximation;
+}
+
+void SKFilterBank::SetFilterNewtonStep(NewtonStep newStep){
+  newtonStep = newStep;
+}
+
+void SKFilterBank::SetFilterNoiseSeed(uint32_t newSeed){
+  dither.SetNoiseSeed(newSeed);
+}
+
+void SKFilterBank::SetFilterNewtonStatistics(bool enable){
+  if(enable && newtonStats == NULL){
+    newtonStats = new NewtonStatistics();
+  }
+  else if(!enable){
+    delete newtonStats;
+    newtonStats = NULL;
+  }
+}
+
+void SKFilterBank::SetFilterIntegrationRate(int voice){
+  // normalize cutoff freq to samplerate
+  dt[voice] = 44100.0 / (sampleRate * oversamplingFactor) * cutoffFrequency[voice];
+
+  // clamp integration rate
+  if(dt[voice] < 0.0){
+    dt[voice] = 0.0;
+  }
+  else if(dt[voice] > 0.35){
+    dt[voice] = 0.35;
+  }
+}
+
+// kernel table entries for the specialized oversampling factors
+#define SK_BANK_KERNEL_ROW(method, mode) \
+  {&SKFilterBank::ProcessBlockKernel<method, mode, 0>, \
+   &SKFilterBank::ProcessBlockKernel<method, mode, 1>, \
+   &SKFilterBank::ProcessBlockKernel<method, mode, 2>, \
+   &SKFilterBank::ProcessBlockKernel<method, mode, 4>, \
+   &SKFilterBank::ProcessBlockKernel<method, mode, 8>}
+
+#define SK_BANK_KERNEL_MODES(method) \
+  {SK_BANK_KERNEL_ROW(method, SK_LOWPASS_MODE), \
+   SK_BANK_KERNEL_ROW(method, SK_BANDPASS_MODE), \
+   SK_BANK_KERNEL_ROW(method, SK_HIGHPASS_MODE)}
+
+void SKFilterBank::SelectKernel(){
+  static const ProcessBlockKernelFn kernels[3][3][5] = {
+    SK_BANK_KERNEL_MODES(SK_SEMI_IMPLICIT_EULER),
+    SK_BANK_KERNEL_MODES(SK_PREDICTOR_CORRECTOR),
+    SK_BANK_KERNEL_MODES(SK_TRAPEZOIDAL)
+  };
+
+  // specialized oversampling factors, other factors use the generic kernel
+  int os;
+  switch(oversamplingFactor){
+  case 1:
+    os = 1;
+    break;
+  case 2:
+    os = 2;
+    break;
+  case 4:
+    os = 3;
+    break;
+  case 8:
+    os = 4;
+    break;
+  default:
+    os = 0;
+  }
+
+  kernel = kernels[integrationMethod][filterMode][os];
+}
+
+int SKFilterBank::GetFilterVoices(){
+  return voices;
+}
+
+float SKFilterBank::GetFilterCutoff(int voice){
+  return cutoffFrequency[voice];
+}
+
+float SKFilterBank::GetFilterResonance(int voice){
+  return Resonance[voice];
+}
+
+int SKFilterBank::GetFilterOversamplingFactor(){
+  return oversamplingFactor;
+}
+
+SKFilterMode SKFilterBank::GetFilterMode(){
+  return filterMode;
+}
+
+float SKFilterBank::GetFilterSampleRate(){
+  return sampleRate;
+}
+
+SKIntegrationMethod SKFilterBank::GetFilterIntegrationMethod(){
+  return integrationMethod;
+}
+
+FastmathApproximation SKFilterBank::GetFilterApproximation(){
+  return approximation;
+}
+
+NewtonStep SKFilterBank::GetFilterNewtonStep(){
+  return newtonStep;
+}
+
+NewtonStatistics* SKFilterBank::GetFilterNewtonStatistics(){
+  return newtonStats;
+}
+
+void SKFilterBank::ProcessBlock(const float* const* in, float* const* out, int n){
+  (this->*kernel)(in, out, n, NULL, NULL);
+}
+
+void SKFilterBank::ProcessBlock(const float* const* in, float* const* out, int n,
+				const float* const* cutoff, const float* const* resonance){
+  (this->*kernel)(in, out, n, cutoff, resonance);
+
+  // keep the last modulated values for the following blocks
+  if(n > 0){
+    for(int v=0; v<voices; v++){
+      if(cutoff){
+	SetFilterCutoff(v, cutoff[v][n - 1]);
+      }
+      if(resonance){
+	SetFilterResonance(v, resonance[v][n - 1]);
+      }
+    }
+  }
+}
+
+template <SKIntegrationMethod method, SKFilterMode mode, int oversampling>
+void SKFilterBank::ProcessBlockKernel(const float* const* in, float* const* out, int n,
+				      const float* const* cutoff, const float* const* resonance){
+  // sinh approximant is fixed over the block
+  const FastmathApproximation approximation = this->approximation;
+  const SIMDFastmathRuntime approximant = {approximation};
+
+  // oversampling factor is a compile time constant unless zero
+  const int factor = oversampling ? oversampling : oversamplingFactor;
+
+  // integration rate per unit cutoff for the modulation buffers
+  const float rate = 44100.f / (sampleRate * (float)(factor));
+
+  // per sample integration rates and resonances of a voice group
+  float rates[SIMD_WIDTH];
+  float resonances[SIMD_WIDTH];
+
+  // lane transpose buffer
+  float lanes[SIMD_WIDTH];
+
+  // dither of one sample of every lane
+  float noise[SIMD_WIDTH];
+
+  for(int g = 0; g < groups; g++){
+    int base = g*SIMD_WIDTH;
+    int active = voices - base < SIMD_WIDTH ? voices - base : SIMD_WIDTH;
+
+    // per voice block constants
+    SIMDFloat dtv = SIMDLoad(dt + base);
+    SIMDFloat res = 4.f*SIMDLoad(Resonance + base);
+    SIMDFloat hdt = 0.5f*dtv;
+
+    // trapezoidal half step and the weights of its one step solution
+    SIMDFloat w_state = 1.f/(1.f + hdt);
+    SIMDFloat w_input = hdt*w_state;
+    SIMDFloat w_bandpass = hdt - hdt*w_input;
+    SIMDFloat c = 1.f - w_bandpass*res + hdt;
+
+    // keep voice state in registers over the block
+    SIMDFloat p0v = SIMDLoad(p0 + base);
+    SIMDFloat p1v = SIMDLoad(p1 + base);
+    SIMDFloat u_t1v = SIMDLoad(u_t1 + base);
+    SIMDFloat xk_t1v = SIMDLoad(xk_t1 + base);
+    SIMDFloat xk_t2v = SIMDLoad(xk_t2 + base);
+    SIMDFloat outv = 0.f;
+
+    for(int i = 0; i < n; i++){
+      // derive the constants of this sample from the modulation buffers,
+      // padding lanes keep their set values
+      if(cutoff || resonance){
+	for(int l = 0; l < SIMD_WIDTH; l++){
+	  rates[l] = cutoff && l < active ? rate*cutoff[base + l][i] : dt[base + l];
+	  resonances[l] = resonance && l < active ? resonance[base + l][i] : Resonance[base + l];
+	}
+
+	dtv = SIMDMin(SIMDMax(SIMDLoad(rates), 0.f), 0.35f);
+	res = 4.f*SIMDLoad(resonances);
+	hdt = 0.5f*dtv;
+
+	w_state = 1.f/(1.f + hdt);
+	w_input = hdt*w_state;
+	w_bandpass = hdt - hdt*w_input;
+	c = 1.f - w_bandpass*res + hdt;
+      }
+
+      // gather voice inputs with dither
+      dither.NoiseBlock(noise, SIMD_WIDTH, 1.0e-6f);
+      for(int l = 0; l < SIMD_WIDTH; l++){
+	lanes[l] = l < active ? in[base + l][i] + noise[l] : 0.f;
+      }
+      SIMDFloat input = SIMDLoad(lanes);
+
+      // filter mode routes the input, the highpass input is not
+      // connected in the circuit model
+      SIMDFloat input_lp = mode == SK_LOWPASS_MODE ? input : SIMDFloat(0.f);
+      SIMDFloat input_bp = mode == SK_BANDPASS_MODE ? input : SIMDFloat(0.f);
+      SIMDFloat input_lp_t1 = mode == SK_LOWPASS_MODE ? u_t1v : SIMDFloat(0.f);
+      SIMDFloat input_bp_t1 = mode == SK_BANDPASS_MODE ? u_t1v : SIMDFloat(0.f);
+
+      // integrate filter state
+      // with oversampling
+      for(int nn = 0; nn < factor; nn++){
+	// integration method is a compile time constant
+	switch(method){
+	case SK_SEMI_IMPLICIT_EULER:
+	  // semi-implicit euler integration, the sinh shaping of the explicit
+	  // methods is the same for both approximations
+	  {
+	    SIMDFloat fb = input_bp + res*p1v;
+	    p0v = p0v + dtv*(input_lp - p0v - fb);
+	    p1v = p1v + dtv*(p0v + fb - p1v - 0.25f*SinhPade34(4.f*p0v));
+	  }
+	  break;
+
+	case SK_PREDICTOR_CORRECTOR:
+	  // predictor-corrector integration
+	  {
+	    SIMDFloat damping = 0.25f*SinhPade34(4.f*p1v);
+	    SIMDFloat fb = input_bp_t1 + res*p1v;
+	    SIMDFloat p0_prime = p0v + dtv*(input_lp_t1 - p0v - fb);
+	    SIMDFloat p1_prime = p1v + dtv*(p0v + fb - p1v - damping);
+	    SIMDFloat fb_prime = input_bp + res*p1_prime;
+
+	    p1v = p1v + hdt*((p0v + fb - p1v - damping) +
+			     (p0_prime + fb_prime - p1_prime - damping));
+	    p0v = p0v + hdt*((input_lp_t1 - p0v - fb) +
+			     (input_lp - p0_prime - fb_prime));
+	  }
+	  break;
+
+	case SK_TRAPEZOIDAL:
+	  // trapezoidal integration
+	  {
+	    SIMDFloat fb_t = input_bp_t1 + res*p1v;
+	    SIMDFloat A = p0v + fb_t - p1v - 0.25f*approximant.Sinh(4.f*p1v) +
+	      w_state*p0v + w_input*(input_lp_t1 - p0v - fb_t + input_lp);
+	    SIMDFloat D_n = p1v + hdt*A + w_bandpass*input_bp;
+	    // lane masked newton-raphson from the extrapolated previous solutions
+	    NewtonLanesResult nr = SKTrapezoidalLanesSolve(approximation, newtonStep, hdt, c, D_n, NewtonExtrapolate(xk_t1v, xk_t2v),
+							   NEWTON_TOLERANCE*(1.f + SIMDAbs(D_n)), newtonStats != NULL);
+	    p1v = nr.x;
+
+	    xk_t2v = xk_t1v;
+	    xk_t1v = p1v;
+
+	    if(newtonStats){
+	      newtonStats->AddLaneSolves(nr, active);
+	    }
+
+	    SIMDFloat fb = input_bp + res*p1v;
+	    p0v = w_state*p0v + w_input*(input_lp_t1 - p0v - fb_t + input_lp - fb);
+	  }
+	  break;
+
+	default:
+	  break;
+	}
+
+	outv = p1v;
+
+	// downsampling filter
+	if(factor > 1){
+	  outv = iir->IIRfilter(g, outv);
+	}
+      }
+
+      // input at t-1, held over the substeps
+      u_t1v = input;
+
+      // scatter voice outputs
+      SIMDStore(lanes, outv);
+      for(int l = 0; l < active; l++){
+	out[base + l][i] = lanes[l];
+      }
+    }
+
+    // store voice state
+    SIMDStore(p0 + base, p0v);
+    SIMDStore(p1 + base, p1v);
+    SIMDStore(u_t1 + base, u_t1v);
+    SIMDStore(xk_t1 + base, xk_t1v);
+    SIMDStore(xk_t2 + base, xk_t2v);
+  }
+}
@@ -19,18 +19,71 @@
  *  along with State Variable Filter OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <cstdlib>
 #include <cmath>
 #include "svfilter.h"
 #include "iir.h"
 #include "fastmath.h"
-
-// steepness of downsample filter response
-#define IIR_DOWNSAMPLE_ORDER 16
+#include "newton.h"
+#include "adaa.h"
 
 // downsampling passthrough bandwidth
 #define IIR_DOWNSAMPLING_BANDWIDTH 0.9
 
+// trapezoidal bandpass equation x + alpha*sinh(x) + alpha2*x = D_t
+template <FastmathApproximation approximation>
+struct SVFTrapezoidalResidual {
+  float alpha, alpha2, D_t;
+
+  inline void Evaluate(float x, float& f, float& df, float& d2f) const {
+    float s = Fastmath<approximation>::Sinh(x);
+
+    f = x + alpha*s + alpha2*x - D_t;
+    df = 1.f + alpha*Fastmath<approximation>::Cosh(x) + alpha2;
+    d2f = alpha*s;
+  }
+};
+
+// newton-raphson solve of the trapezoidal equation from x, the approximant
+// branch is taken once per solve rather than once per evaluation
+static inline NewtonResult SVFTrapezoidalSolve(FastmathApproximation approximation, NewtonStep step, float alpha, float alpha2, float D_t,
+					       float x, float tolerance, bool report){
+  if(approximation == FASTMATH_MINIMAX){
+    SVFTrapezoidalResidual<FASTMATH_MINIMAX> residual = {alpha, alpha2, D_t};
+    return NewtonSolve<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+  }
+
+  SVFTrapezoidalResidual<FASTMATH_PADE> residual = {alpha, alpha2, D_t};
+  return NewtonSolve<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+}
+
+// inverse trapezoidal equation alpha*y + (1 + alpha2)*asinh(y) = D_t
+template <FastmathApproximation approximation>
+struct SVFInvTrapezoidalResidual {
+  float alpha, alpha2, D_t;
+
+  inline void Evaluate(float y, float& f, float& df, float& d2f) const {
+    float d = Fastmath<approximation>::dASinh(y);
+
+    f = alpha*y + Fastmath<approximation>::ASinh(y)*(1.f + alpha2) - D_t;
+    df = alpha + (1.f + alpha2)*d;
+    d2f = -(1.f + alpha2)*y*d*d*d;
+  }
+};
+
+// newton-raphson solve of the inverse trapezoidal equation from x, the
+// approximant branch is taken once per solve rather than once per
+// evaluation
+static inline NewtonResult SVFInvTrapezoidalSolve(FastmathApproximation approximation, NewtonStep step, float alpha, float alpha2, float D_t,
+						  float x, float tolerance, bool report){
+  if(approximation == FASTMATH_MINIMAX){
+    SVFInvTrapezoidalResidual<FASTMATH_MINIMAX> residual = {alpha, alpha2, D_t};
+    return NewtonSolve<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+  }
+
+  SVFInvTrapezoidalResidual<FASTMATH_PADE> residual = {alpha, alpha2, D_t};
+  return NewtonSolve<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+}
+
 // constructor
 SVFilter::SVFilter(float newCutoff, float newResonance, int newOversamplingFactor,
 		   SVFFilterMode newFilterMode, float newSampleRate, SVFIntegrationMethod newIntegrationMethod){
@@ -44,12 +97,31 @@ SVFilter::SVFilter(float newCutoff, float newResonance, int newOversamplingFacto
   SetFilterIntegrationRate();
 
   // initialize filter state
-  hp = bp = lp = out = u_t1 = 0.0;
+  hp = bp = lp = out = u_t1 = 0.f;
+  xk_t1 = xk_t2 = 0.f;
+  ResetADAAState(dampingState);
   
   integrationMethod = newIntegrationMethod;
+  resamplerType = RESAMPLER_IIR;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+  antialiasing = false;
+  morph = 0.f;
+
+  SelectKernel();
   
   // instantiate downsampling filter
-  iir = new IIRLowpass(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, IIR_DOWNSAMPLE_ORDER);
+  iir = new FixedIIRLowpass<SVF_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, SVF_IIR_DOWNSAMPLE_ORDER);
+
+  // instantiate half-band resampler chain
+  halfband = new HalfbandResampler(oversamplingFactor);
+
+  // multi-output taps get their decimators when enabled
+  taps = new FilterTaps<SVF_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0,
+					       oversamplingFactor);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
 }
 
 // default constructor
@@ -64,17 +136,39 @@ SVFilter::SVFilter(){
   SetFilterIntegrationRate();
   
   // initialize filter state
-  hp = bp = lp = out = u_t1 = 0.0;
+  hp = bp = lp = out = u_t1 = 0.f;
+  xk_t1 = xk_t2 = 0.f;
+  ResetADAAState(dampingState);
   
   integrationMethod = SVF_TRAPEZOIDAL;
+  resamplerType = RESAMPLER_IIR;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+  antialiasing = false;
+  morph = 0.f;
+
+  SelectKernel();
   
   // instantiate downsampling filter
-  iir = new IIRLowpass(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, IIR_DOWNSAMPLE_ORDER);
+  iir = new FixedIIRLowpass<SVF_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, SVF_IIR_DOWNSAMPLE_ORDER);
+
+  // instantiate half-band resampler chain
+  halfband = new HalfbandResampler(oversamplingFactor);
+
+  // multi-output taps get their decimators when enabled
+  taps = new FilterTaps<SVF_IIR_DOWNSAMPLE_ORDER>(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0,
+					       oversamplingFactor);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
 }
 
 // default destructor
 SVFilter::~SVFilter(){
   delete iir;
+  delete halfband;
+  delete taps;
+  delete newtonStats;
 }
 
 void SVFilter::ResetFilterState(){
@@ -85,46 +179,105 @@ void SVFilter::ResetFilterState(){
   SetFilterIntegrationRate();
   
   // initialize filter state
-  hp = bp = lp = out = u_t1 = 0.0;
+  hp = bp = lp = out = u_t1 = 0.f;
+  xk_t1 = xk_t2 = 0.f;
+  ResetADAAState(dampingState);
   
   // set oversampling
-  iir->SetFilterSamplerate(sampleRate * oversamplingFactor);
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  halfband->InitializeResampler();
+  taps->SetTapsParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, oversamplingFactor);
 }
 
 void SVFilter::SetFilterCutoff(float newCutoff){
-  cutoffFrequency = newCutoff;
+  // derived constants are only invalidated by a change
+  if(newCutoff != cutoffFrequency){
+    cutoffFrequency = newCutoff;
 
-  SetFilterIntegrationRate();
+    SetFilterIntegrationRate();
+  }
 }
 
 void SVFilter::SetFilterResonance(float newResonance){
-  Resonance = newResonance;
+  if(newResonance != Resonance){
+    Resonance = newResonance;
+    coefficientsDirty = true;
+  }
 }
 
 void SVFilter::SetFilterOversamplingFactor(int newOversamplingFactor){
   oversamplingFactor = newOversamplingFactor;
-  iir->SetFilterSamplerate(sampleRate * oversamplingFactor);
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  halfband->SetResamplerFactor(oversamplingFactor);
+  taps->SetTapsParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, oversamplingFactor);
 
   SetFilterIntegrationRate();
+  SelectKernel();
 }
 
 void SVFilter::SetFilterMode(SVFFilterMode newFilterMode){
   filterMode = newFilterMode;
+  SelectKernel();
 }
 
 void SVFilter::SetFilterSampleRate(float newSampleRate){
   sampleRate = newSampleRate;
-  iir->SetFilterSamplerate(sampleRate * (float)(oversamplingFactor));
-  iir->SetFilterCutoff(IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  iir->SetFilterParameters(sampleRate * (float)(oversamplingFactor), IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+  taps->SetTapsParameters(sampleRate * (float)(oversamplingFactor), IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0,
+			  oversamplingFactor);
 
   SetFilterIntegrationRate();
 }
 
 void SVFilter::SetFilterIntegrationMethod(SVFIntegrationMethod method){
   integrationMethod = method;
+  coefficientsDirty = true;
   ResetFilterState();
+  SelectKernel();
+}
+
+void SVFilter::SetFilterResampler(ResamplerType newResampler){
+  resamplerType = newResampler;
+  halfband->InitializeResampler();
+  taps->InitializeTaps();
+  SelectKernel();
+}
+
+void SVFilter::SetFilterApproximation(FastmathApproximation newApproximation){
+  approximation = newApproximation;
+}
+
+void SVFilter::SetFilterNewtonStep(NewtonStep newStep){
+  newtonStep = newStep;
+}
+
+void SVFilter::SetFilterAntialiasing(bool enable){
+  antialiasing = enable;
+
+  // segments start over from the origin
+  ResetADAAState(dampingState);
+}
+
+void SVFilter::SetFilterMorph(float newMorph){
+  morph = newMorph;
+}
+
+void SVFilter::SetFilterNoiseSeed(uint32_t newSeed){
+  dither.SetNoiseSeed(newSeed);
+}
+
+void SVFilter::SetFilterTaps(int mask){
+  taps->SetTaps(mask);
+}
+
+void SVFilter::SetFilterNewtonStatistics(bool enable){
+  if(enable && newtonStats == NULL){
+    newtonStats = new NewtonStatistics();
+  }
+  else if(!enable){
+    delete newtonStats;
+    newtonStats = NULL;
+  }
 }
 
 void SVFilter::SetFilterIntegrationRate(){
@@ -135,6 +288,113 @@ void SVFilter::SetFilterIntegrationRate(){
   if(dt < 0.0){
     dt=0.0;
   }
+
+  coefficientsDirty = true;
+}
+
+// derive the kernel constants except the loss factor from the integration
+// rate and resonance, division free so kernels can run it per sample
+static inline void SVFDeriveCoefficients(SVFCoefficients& coefficients, float dt, float resonance,
+					 SVFIntegrationMethod method){
+  // feedback amount variables
+  coefficients.fb = 1.f - 3.5f*resonance;
+
+  // clamp integration rate
+  float dt2 = dt;
+
+  if(dt2 < 0.f){
+    dt2 = 0.f;
+  }
+
+  switch(method){
+  case SVF_TRAPEZOIDAL:
+    if(dt2 > 0.8f){
+      dt2 = 0.8f;
+    }
+    break;
+  case SVF_INV_TRAPEZOIDAL:
+    if(dt2 > 1.f){
+      dt2 = 1.f;
+    }
+    break;
+  default:
+    if(dt2 > 0.25f){
+      dt2 = 0.25f;
+    }
+    break;
+  }
+
+  coefficients.dt = dt2;
+
+  // trapezoidal step weights
+  coefficients.alpha = 0.5f*dt2;
+  coefficients.alpha2 = 0.25f*dt2*dt2 + coefficients.fb*coefficients.alpha;
+  coefficients.gamma = 1.f - 0.25f*dt2*dt2;
+}
+
+void SVFilter::UpdateFilterCoefficients(){
+  SVFDeriveCoefficients(coefficients, dt, Resonance, integrationMethod);
+
+  // loss factor
+  coefficients.beta = 1.0 - (0.0025/oversamplingFactor);
+
+  coefficientsDirty = false;
+}
+
+// kernel table entries for the specialized oversampling factors
+#define SVF_KERNEL_ROW(method, mode, multiOutput) \
+  {&SVFilter::ProcessBlockKernel<method, mode, multiOutput, 0>, \
+   &SVFilter::ProcessBlockKernel<method, mode, multiOutput, 1>, \
+   &SVFilter::ProcessBlockKernel<method, mode, multiOutput, 2>, \
+   &SVFilter::ProcessBlockKernel<method, mode, multiOutput, 4>, \
+   &SVFilter::ProcessBlockKernel<method, mode, multiOutput, 8>}
+
+#define SVF_KERNEL_MODES(method) \
+  {SVF_KERNEL_ROW(method, SVF_LOWPASS_MODE, false), \
+   SVF_KERNEL_ROW(method, SVF_BANDPASS_MODE, false), \
+   SVF_KERNEL_ROW(method, SVF_HIGHPASS_MODE, false)}
+
+void SVFilter::SelectKernel(){
+  static const ProcessBlockKernelFn kernels[4][3][5] = {
+    SVF_KERNEL_MODES(SVF_SEMI_IMPLICIT_EULER),
+    SVF_KERNEL_MODES(SVF_PREDICTOR_CORRECTOR),
+    SVF_KERNEL_MODES(SVF_TRAPEZOIDAL),
+    SVF_KERNEL_MODES(SVF_INV_TRAPEZOIDAL)
+  };
+
+  // multi-output kernels compute every response, the mode is unused
+  static const ProcessBlockKernelFn tapsKernels[4][5] = {
+    SVF_KERNEL_ROW(SVF_SEMI_IMPLICIT_EULER, SVF_LOWPASS_MODE, true),
+    SVF_KERNEL_ROW(SVF_PREDICTOR_CORRECTOR, SVF_LOWPASS_MODE, true),
+    SVF_KERNEL_ROW(SVF_TRAPEZOIDAL, SVF_LOWPASS_MODE, true),
+    SVF_KERNEL_ROW(SVF_INV_TRAPEZOIDAL, SVF_LOWPASS_MODE, true)
+  };
+
+  // specialized oversampling factors, other factors use the generic kernel
+  int os;
+  switch(oversamplingFactor){
+  case 1:
+    os = 1;
+    break;
+  case 2:
+    os = 2;
+    break;
+  case 4:
+    os = 3;
+    break;
+  case 8:
+    os = 4;
+    break;
+  default:
+    os = 0;
+  }
+
+  kernel = kernels[integrationMethod][filterMode][os];
+  tapsKernel = tapsKernels[integrationMethod][os];
+
+  // half-band chain handles power of two factors only
+  halfbandResampler = resamplerType == RESAMPLER_HALFBAND && oversamplingFactor > 1 &&
+    HalfbandResampler::IsResamplerFactor(oversamplingFactor);
 }
 
 float SVFilter::GetFilterCutoff(){
@@ -165,149 +425,308 @@ SVFIntegrationMethod SVFilter::GetFilterIntegrationMethod(){
   return integrationMethod;
 }
 
-void SVFilter::filter(float input){
-  // noise term
-  float noise;
+ResamplerType SVFilter::GetFilterResampler(){
+  return resamplerType;
+}
 
-  // feedback amount variables
-  float fb = 1.0 - (3.5*Resonance);
+FastmathApproximation SVFilter::GetFilterApproximation(){
+  return approximation;
+}
 
-  // integration rate
-  float dt2 = dt;
-  
-  // update noise terms
-  noise = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-  noise = 1.0e-6 * 2.0 * (noise - 0.5);
+NewtonStep SVFilter::GetFilterNewtonStep(){
+  return newtonStep;
+}
 
-  input += noise;
+bool SVFilter::GetFilterAntialiasing(){
+  return antialiasing;
+}
 
-  // clamp integration rate
-  switch(integrationMethod){
-  case SVF_TRAPEZOIDAL:
-    if(dt2 > 0.8){
-      dt2 = 0.8;
+float SVFilter::GetFilterMorph(){
+  return morph;
+}
+
+NewtonStatistics* SVFilter::GetFilterNewtonStatistics(){
+  return newtonStats;
+}
+
+void SVFilter::filter(float input){
+  ProcessBlock(&input, &out, 1);
+}
+
+void SVFilter::ProcessBlock(const float* in, float* out, int n){
+  (this->*kernel)(in, &out, n, NULL, NULL);
+}
+
+void SVFilter::ProcessBlock(const float* in, float* out, int n, const float* cutoff, const float* resonance){
+  (this->*kernel)(in, &out, n, cutoff, resonance);
+
+  // keep the last modulated values for the following blocks
+  if(n > 0){
+    if(cutoff){
+      SetFilterCutoff(cutoff[n - 1]);
     }
-    break;
-  case SVF_INV_TRAPEZOIDAL:
-    if(dt2 > 1.0){
-      dt2 = 1.0;
+    if(resonance){
+      SetFilterResonance(resonance[n - 1]);
     }
-    break;
-  default:
-    if(dt2 > 0.25){
-      dt2 = 0.25;
+  }
+}
+
+void SVFilter::ProcessBlockTaps(const float* in, float* const* outputs, int n){
+  ProcessBlockTaps(in, outputs, n, NULL, NULL);
+}
+
+void SVFilter::ProcessBlockTaps(const float* in, float* const* outputs, int n, const float* cutoff, const float* resonance){
+  // taps without a decimator are skipped
+  float* enabled[FILTER_TAPS];
+  taps->EnabledTaps(outputs, enabled);
+
+  (this->*tapsKernel)(in, enabled, n, cutoff, resonance);
+
+  // keep the last modulated values for the following blocks
+  if(n > 0){
+    if(cutoff){
+      SetFilterCutoff(cutoff[n - 1]);
+    }
+    if(resonance){
+      SetFilterResonance(resonance[n - 1]);
     }
-    break;
   }
-  
-  // integrate filter state
-  // with oversampling
-  for(int nn = 0; nn < oversamplingFactor; nn++){
-    // switch integration method
-    switch(integrationMethod){
-    case SVF_SEMI_IMPLICIT_EULER:
-      {
-	// loss factor
-	float beta = 1.0 - (0.0025/oversamplingFactor);
-
-       	hp = input - lp - fb*bp - SinhPade54(bp);
-	bp += dt2*hp;
-	bp *= beta;
-	lp += dt2*bp;
-      }
-      break;
-    case SVF_TRAPEZOIDAL:
-      // trapezoidal integration
-      {
-	float alpha = dt2/2.0;
-	float beta = 1.0 - (0.0025/oversamplingFactor);
-	float alpha2 = dt2*dt2/4.0 + fb*alpha;
-	float D_t = (1.0 - dt2*dt2/4.0)*bp +
-	              alpha*(u_t1 + input - 2.0*lp - fb*bp - SinhPade54(bp));
-	float x_k, x_k2;
-
-	// starting point is last output
-	x_k = bp;
-	
-	// newton-raphson
-	for(int ii=0; ii < 8; ii++) {
-	  x_k2 = x_k - (x_k + alpha*SinhPade54(x_k) + alpha2*x_k - D_t)/
-	                  (1.0 + alpha*CoshPade54(x_k) + alpha2);
-	  
-	  // breaking limit
-	  if(abs(x_k2 - x_k) < 1.0e-9) {
-	    x_k = x_k2;
-	    break;
+}
+
+template <SVFIntegrationMethod method, SVFFilterMode mode, bool multiOutput, int oversampling>
+void SVFilter::ProcessBlockKernel(const float* in, float* const* outputs, int n, const float* cutoff, const float* resonance){
+  // oversampling factor is a compile time constant unless zero
+  const int factor = oversampling ? oversampling : oversamplingFactor;
+
+  // resampler, approximants and antialiasing are fixed over the block
+  const bool halfbandResampler = this->halfbandResampler;
+  const FastmathApproximation approximation = this->approximation;
+  const FastmathRuntime approximant = {approximation};
+  const FastmathADAARuntime antialiased = {approximation};
+  const bool antialiasing = this->antialiasing;
+
+  // oversampled input and output of the half-band resampler
+  float upsampled[HALFBAND_MAX_FACTOR];
+  float decimated[HALFBAND_MAX_FACTOR];
+
+  // oversampled output collected for the block decimation filter
+  float oversampled[IIR_BLOCK_SIZE];
+  int pending = 0;
+
+  // single output, or one output per tap
+  float* output = outputs[0];
+
+  // response weights of the morph tap
+  const FilterMorph morph = FilterMorphWeights(this->morph);
+
+  // update derived constants after a parameter change
+  if(coefficientsDirty){
+    UpdateFilterCoefficients();
+  }
+
+  // feedback amount, loss factor, integration rate and trapezoidal weights
+  float fb = coefficients.fb;
+  float beta = coefficients.beta;
+  float dt2 = coefficients.dt;
+  float alpha = coefficients.alpha;
+  float alpha2 = coefficients.alpha2;
+  float gamma = coefficients.gamma;
+
+  // integration rate per unit cutoff for the modulation buffers
+  float rate = cutoff ? 44100.f / (sampleRate * (float)(factor)) : 0.f;
+
+  // keep filter state in registers over the block
+  NoiseGenerator dither = this->dither;
+  float lp = this->lp;
+  float bp = this->bp;
+  float hp = this->hp;
+  float u_t1 = this->u_t1;
+  float xk_t1 = this->xk_t1;
+  float xk_t2 = this->xk_t2;
+  float out = this->out;
+  ADAAState dampingState = this->dampingState;
+
+  for(int i = 0; i < n; i++){
+    float input = in[i];
+
+    // derive the constants of this sample from the modulation buffers
+    if(cutoff || resonance){
+      SVFCoefficients modulated;
+
+      SVFDeriveCoefficients(modulated, cutoff ? rate*cutoff[i] : dt, resonance ? resonance[i] : Resonance, method);
+      fb = modulated.fb;
+      dt2 = modulated.dt;
+      alpha = modulated.alpha;
+      alpha2 = modulated.alpha2;
+      gamma = modulated.gamma;
+    }
+    
+    // add dither
+    input += dither.NoiseSample(1.0e-6f);
+
+    // interpolate input to the oversampled rate
+    if(halfbandResampler){
+      halfband->Upsample(input, upsampled);
+    }
+
+    // integrate filter state
+    // with oversampling
+    for(int nn = 0; nn < factor; nn++){
+      // oversampled input, held over the substeps without the half-band chain
+      float u = halfbandResampler ? upsampled[nn] : input;
+
+      // integration method and filter mode are compile time constants
+      switch(method){
+      case SVF_SEMI_IMPLICIT_EULER:
+	{
+	  float damping = antialiasing ? antialiased.Sinh(dampingState, bp) : approximant.Sinh(bp);
+
+	  hp = u - lp - fb*bp - damping;
+	  bp += dt2*hp;
+	  bp *= beta;
+	  lp += dt2*bp;
+	}
+	break;
+      case SVF_TRAPEZOIDAL:
+	// trapezoidal integration
+	{
+	  float damping = antialiasing ? antialiased.Sinh(dampingState, bp) : approximant.Sinh(bp);
+	  float D_t = gamma*bp + alpha*(u_t1 + u - 2.f*lp - fb*bp - damping);
+	  // newton-raphson from the extrapolated previous solutions
+	  NewtonResult nr = SVFTrapezoidalSolve(approximation, newtonStep, alpha, alpha2, D_t, NewtonExtrapolate(xk_t1, xk_t2),
+						NEWTON_TOLERANCE*(1.f + fabsf(D_t)), newtonStats != NULL);
+	  float x_k = nr.x;
+
+	  xk_t2 = xk_t1;
+	  xk_t1 = x_k;
+
+	  if(newtonStats){
+	    newtonStats->AddSolve(nr);
 	  }
-	  
-	  x_k = x_k2;
+
+	  lp += alpha*bp;
+	  bp = beta*x_k;
+	  lp += alpha*bp;
+	  hp = u - lp - fb*bp;
 	}
+	break;
+      case SVF_INV_TRAPEZOIDAL:
+	// inverse trapezoidal integration
+	{
+	  // pade kernels map the state through the library functions
+	  float s;
+	  if(antialiasing){
+	    s = approximation == FASTMATH_MINIMAX ? ADAAEvaluate<SinhMinimaxMean>(dampingState, bp) :
+	      ADAAEvaluate<SinhLibraryMean>(dampingState, bp);
+	  }
+	  else{
+	    s = approximation == FASTMATH_MINIMAX ? SinhMinimax(bp) : sinh(bp);
+	  }
+	  float D_t = gamma*bp + alpha*(u_t1 + u - 2.f*lp - fb*bp - s);
+	  // newton-raphson from the extrapolated previous solutions
+	  NewtonResult nr = SVFInvTrapezoidalSolve(approximation, newtonStep, alpha, alpha2, D_t, NewtonExtrapolate(xk_t1, xk_t2),
+						   NEWTON_TOLERANCE*(1.f + fabsf(D_t)), newtonStats != NULL);
+	  float y_k = nr.x;
 
-	lp += alpha*bp;
-	bp = beta*x_k;
-	lp += alpha*bp;
-      	hp = input - lp - fb*bp;
-      }
-      break;
-    case SVF_INV_TRAPEZOIDAL:
-      // inverse trapezoidal integration
-      {
-	float alpha = dt2/2.0;
-	float beta = 1.0 - (0.0025/oversamplingFactor);
-	float alpha2 = dt2*dt2/4.0 + fb*alpha;
-	float D_t = (1.0 - dt2*dt2/4.0)*bp +
-	              alpha*(u_t1 + input - 2.0*lp - fb*bp - sinh(bp));
-	float y_k, y_k2;
-
-	// starting point is last output
-	y_k = sinh(bp);
-	
-	// newton-raphson
-	for(int ii=0; ii < 8; ii++) {
-	  y_k2 = y_k - (alpha*y_k + ASinhPade54(y_k)*(1.0 + alpha2) - D_t)/
-	                  (alpha + (1.0 + alpha2)*dASinhPade54(y_k));
-	  
-	  // breaking limit
-	  if(abs(y_k2 - y_k) < 1.0e-9) {
-	    y_k = y_k2;
-	    break;
+	  xk_t2 = xk_t1;
+	  xk_t1 = y_k;
+
+	  if(newtonStats){
+	    newtonStats->AddSolve(nr);
 	  }
-	  
-	  y_k = y_k2;
+
+	  lp += alpha*bp;
+	  bp = beta*(approximation == FASTMATH_MINIMAX ? ASinhMinimax(y_k) : asinh(y_k));
+	  lp += alpha*bp;
+	  hp = u - lp - fb*bp;
 	}
+	break;
+      default:
+	break;
+      }
+    
+      // taps are decimated on their own
+      if(!multiOutput){
+	switch(mode){
+	case SVF_LOWPASS_MODE:
+	  out = lp;
+	  break;
+	case SVF_BANDPASS_MODE:
+	  out = bp;
+	  break;
+	case SVF_HIGHPASS_MODE:
+	  out = hp;
+	  break;
+	default:
+	  out = 0.f;
+	}
+      }
+    
+      // downsampling filter
+      if(multiOutput){
+	float response[FILTER_TAPS] = {lp, bp, hp, morph.lowpass*lp + morph.bandpass*bp + morph.highpass*hp};
 
-     	lp += alpha*bp;
-	bp = beta*asinh(y_k);
-	lp += alpha*bp;
-      	hp = input - lp - fb*bp;
+	taps->Substep(outputs, response, factor, pending, nn, halfbandResampler);
+      }
+      else if(halfbandResampler){
+	decimated[nn] = out;
+      }
+      else if(factor > IIR_BLOCK_SIZE){
+	out = iir->IIRfilter(out);
+      }
+      else if(factor > 1){
+	oversampled[pending*factor + nn] = out;
+      }
+
+      // interpolated input changes every substep
+      if(halfbandResampler){
+	u_t1 = u;
       }
-      break;
-    default:
-      break;
     }
-    
-    switch(filterMode){
-    case SVF_LOWPASS_MODE:
-      out = lp;
-      break;
-    case SVF_BANDPASS_MODE:
-      out = bp;
-      break;
-    case SVF_HIGHPASS_MODE:
-      out = hp;
-      break;
-    default:
-      out = 0.0;
+
+    // set input at t-1
+    if(!halfbandResampler){
+      u_t1 = input;
     }
-    
-    // downsampling filter
-    if(oversamplingFactor > 1){
-      out = iir->IIRfilter(out);
+
+    // decimate output to the base rate
+    if(multiOutput){
+      taps->Decimate(outputs, factor, pending, i, n, halfbandResampler);
+    }
+    else if(halfbandResampler){
+      out = halfband->Downsample(decimated);
+    }
+
+    // decimate collected substeps when the buffer is full or the block ends
+    if(!multiOutput && !halfbandResampler && factor > 1 && factor <= IIR_BLOCK_SIZE){
+      pending++;
+
+      if((pending + 1)*factor > IIR_BLOCK_SIZE || i == n - 1){
+	iir->IIRfilterBlock(oversampled, pending*factor);
+
+	for(int j = 0; j < pending; j++){
+	  output[i + 1 - pending + j] = oversampled[(j + 1)*factor - 1];
+	}
+
+	out = output[i];
+	pending = 0;
+      }
+    }
+    else if(!multiOutput){
+      output[i] = out;
     }
   }
-  
-  // set input at t-1
-  u_t1 = input;    
+
+  // store filter state
+  this->lp = lp;
+  this->bp = bp;
+  this->hp = hp;
+  this->u_t1 = u_t1;
+  this->xk_t1 = xk_t1;
+  this->xk_t2 = xk_t2;
+  this->out = out;
+  this->dither = dither;
+  this->dampingState = dampingState;
 }
 
 float SVFilter::GetFilterLowpass(){
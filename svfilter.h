@@ -23,6 +23,15 @@
 #define __dspsvfh__
 
 #include "iir.h"
+#include "halfband.h"
+#include "noise.h"
+#include "newton.h"
+#include "fastmath.h"
+#include "adaa.h"
+#include "taps.h"
+
+// steepness of downsample filter response, the decimators are sized for it
+#define SVF_IIR_DOWNSAMPLE_ORDER 16
 
 // filter modes
 enum SVFFilterMode {
@@ -39,6 +48,21 @@ enum SVFIntegrationMethod {
    SVF_INV_TRAPEZOIDAL
 };
 
+// kernel constants derived from the filter parameters
+struct SVFCoefficients {
+  // feedback amount and loss factor
+  float fb;
+  float beta;
+
+  // integration rate clamped for the integration method
+  float dt;
+
+  // trapezoidal half step, implicit bandpass weight and previous state weight
+  float alpha;
+  float alpha2;
+  float gamma;
+};
+
 class SVFilter{
 public:
   // constructor/destructor
@@ -54,6 +78,14 @@ public:
   void SetFilterMode(SVFFilterMode newFilterMode);
   void SetFilterSampleRate(float newSampleRate);
   void SetFilterIntegrationMethod(SVFIntegrationMethod method);
+  void SetFilterResampler(ResamplerType newResampler);
+  void SetFilterApproximation(FastmathApproximation newApproximation);
+  void SetFilterNewtonStep(NewtonStep newStep);
+  void SetFilterAntialiasing(bool enable);
+  void SetFilterMorph(float newMorph);
+  void SetFilterNoiseSeed(uint32_t newSeed);
+  void SetFilterTaps(int mask);
+  void SetFilterNewtonStatistics(bool enable);
   
   // get filter parameters
   float GetFilterCutoff();
@@ -62,10 +94,34 @@ public:
   SVFFilterMode GetFilterMode();  
   float GetFilterSampleRate();
   SVFIntegrationMethod GetFilterIntegrationMethod();
+  ResamplerType GetFilterResampler();
+  FastmathApproximation GetFilterApproximation();
+  NewtonStep GetFilterNewtonStep();
+  bool GetFilterAntialiasing();
+  float GetFilterMorph();
+
+  // get newton solver statistics, NULL unless enabled
+  NewtonStatistics* GetFilterNewtonStatistics();
   
   // tick filter state
   void filter(float input);
 
+  // filter a block of samples, in and out may be the same buffer
+  void ProcessBlock(const float* in, float* out, int n);
+
+  // filter a block with per sample cutoff and resonance, either buffer
+  // may be NULL to keep the set value. parameters end the block at their
+  // last modulated value
+  void ProcessBlock(const float* in, float* out, int n, const float* cutoff, const float* resonance);
+
+  // filter a block into several outputs from one integration pass.
+  // outputs holds a buffer per FilterTap, NULL for the taps that are not
+  // wanted, and every requested tap is decimated on its own. taps are
+  // enabled beforehand with SetFilterTaps(), the buffers of disabled taps
+  // are left untouched
+  void ProcessBlockTaps(const float* in, float* const* outputs, int n);
+  void ProcessBlockTaps(const float* in, float* const* outputs, int n, const float* cutoff, const float* resonance);
+
   // get filter responses
   float GetFilterLowpass();
   float GetFilterBandpass();
@@ -81,6 +137,23 @@ private:
   // set integration rate
   void SetFilterIntegrationRate();
 
+  // recompute the kernel constants, done at the start of a block after
+  // a setter has invalidated them
+  void UpdateFilterCoefficients();
+
+  // select block processing kernel for current settings
+  void SelectKernel();
+
+  // block processing kernel specialized for integration method,
+  // filter mode or all taps and oversampling factor, zero factor is
+  // generic. resampler, approximants and antialiasing are branches fixed
+  // over the block. modulation buffers are NULL for block rate parameters
+  template <SVFIntegrationMethod method, SVFFilterMode mode, bool multiOutput, int oversampling>
+  void ProcessBlockKernel(const float* in, float* const* outputs, int n, const float* cutoff, const float* resonance);
+
+  typedef void (SVFilter::*ProcessBlockKernelFn)(const float* in, float* const* outputs, int n,
+						 const float* cutoff, const float* resonance);
+
   // pade approximant functions for hyperbolic functions
   // filter parameters
   float cutoffFrequency;
@@ -90,18 +163,54 @@ private:
   float sampleRate;
   float dt;
   SVFIntegrationMethod integrationMethod;
+  ResamplerType resamplerType;
+  FastmathApproximation approximation;
+  NewtonStep newtonStep;
+  bool antialiasing;
+  float morph;
+
+  // derived kernel constants and their invalidation flag
+  SVFCoefficients coefficients;
+  bool coefficientsDirty;
   
   // filter state
   float lp;
   float bp;
   float hp;
   float u_t1;
+
+  // previous newton solutions for the warm start
+  float xk_t1;
+  float xk_t2;
+
+  // antiderivative antialiasing state of the sinh damping
+  ADAAState dampingState;
   
   // filter output
   float out;
 
+  // selected block processing kernels of the single output and the
+  // multi-output processing
+  ProcessBlockKernelFn kernel;
+  ProcessBlockKernelFn tapsKernel;
+
+  // half-band chain in use, the resampler type for a factor it handles
+  bool halfbandResampler;
+
   // IIR downsampling filter
-  IIRLowpass *iir;
+  FixedIIRLowpass<SVF_IIR_DOWNSAMPLE_ORDER> *iir;
+
+  // half-band resampler chain
+  HalfbandResampler *halfband;
+
+  // decimators of the multi-output taps
+  FilterTaps<SVF_IIR_DOWNSAMPLE_ORDER> *taps;
+
+  // anti-denormal dither generator
+  NoiseGenerator dither;
+
+  // newton solver statistics
+  NewtonStatistics *newtonStats;
 };
 
 #endif
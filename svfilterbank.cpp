@@ -0,0 +1,560 @@
+/*
+ *  (C) 2021 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of State Variable Filter OWL Patch.
+ *
+ *  State Variable Filter OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  State Variable Filter OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with State Variable Filter OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include "svfilterbank.h"
+#include "simdmath.h"
+#include "newton.h"
+
+// downsampling passthrough bandwidth
+#define IIR_DOWNSAMPLING_BANDWIDTH 0.9
+
+// trapezoidal bandpass equation x + alpha*sinh(x) + alpha2*x = D_t per lane
+template <FastmathApproximation approximation>
+struct SVFTrapezoidalLanesResidual {
+  SIMDFloat alpha, alpha2, D_t;
+
+  inline void Evaluate(SIMDFloat x, SIMDFloat& f, SIMDFloat& df, SIMDFloat& d2f) const {
+    SIMDFloat s = SIMDFastmath<approximation>::Sinh(x);
+
+    f = x + alpha*s + alpha2*x - D_t;
+    df = 1.f + alpha*SIMDFastmath<approximation>::Cosh(x) + alpha2;
+    d2f = alpha*s;
+  }
+};
+
+// lane masked newton-raphson solve of the trapezoidal equation from x, the
+// approximant branch is taken once per solve rather than once per
+// evaluation
+static inline NewtonLanesResult SVFTrapezoidalLanesSolve(FastmathApproximation approximation, NewtonStep step,
+							 SIMDFloat alpha, SIMDFloat alpha2, SIMDFloat D_t,
+							 SIMDFloat x, SIMDFloat tolerance, bool report){
+  if(approximation == FASTMATH_MINIMAX){
+    SVFTrapezoidalLanesResidual<FASTMATH_MINIMAX> residual = {alpha, alpha2, D_t};
+    return NewtonSolveLanes<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+  }
+
+  SVFTrapezoidalLanesResidual<FASTMATH_PADE> residual = {alpha, alpha2, D_t};
+  return NewtonSolveLanes<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+}
+
+// inverse trapezoidal equation alpha*y + (1 + alpha2)*asinh(y) = D_t per lane
+template <FastmathApproximation approximation>
+struct SVFInvTrapezoidalLanesResidual {
+  SIMDFloat alpha, alpha2, D_t;
+
+  inline void Evaluate(SIMDFloat y, SIMDFloat& f, SIMDFloat& df, SIMDFloat& d2f) const {
+    SIMDFloat d = SIMDFastmath<approximation>::dASinh(y);
+
+    f = alpha*y + SIMDFastmath<approximation>::ASinh(y)*(1.f + alpha2) - D_t;
+    df = alpha + (1.f + alpha2)*d;
+    d2f = -(1.f + alpha2)*y*d*d*d;
+  }
+};
+
+// lane masked newton-raphson solve of the inverse trapezoidal equation
+// from x, the approximant branch is taken once per solve rather than
+// once per evaluation
+static inline NewtonLanesResult SVFInvTrapezoidalLanesSolve(FastmathApproximation approximation, NewtonStep step,
+							    SIMDFloat alpha, SIMDFloat alpha2, SIMDFloat D_t,
+							    SIMDFloat x, SIMDFloat tolerance, bool report){
+  if(approximation == FASTMATH_MINIMAX){
+    SVFInvTrapezoidalLanesResidual<FASTMATH_MINIMAX> residual = {alpha, alpha2, D_t};
+    return NewtonSolveLanes<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+  }
+
+  SVFInvTrapezoidalLanesResidual<FASTMATH_PADE> residual = {alpha, alpha2, D_t};
+  return NewtonSolveLanes<NEWTON_MAX_ITERATIONS>(step, residual, x, tolerance, report);
+}
+
+// constructor
+SVFilterBank::SVFilterBank(int newVoices, float newCutoff, float newResonance, int newOversamplingFactor,
+			   SVFFilterMode newFilterMode, float newSampleRate, SVFIntegrationMethod newIntegrationMethod){
+  Initialize(newVoices, newCutoff, newResonance, newOversamplingFactor,
+	     newFilterMode, newSampleRate, newIntegrationMethod);
+}
+
+// default parameter constructor
+SVFilterBank::SVFilterBank(int newVoices){
+  Initialize(newVoices, 0.25, 0.5, 2, SVF_LOWPASS_MODE, 44100.0, SVF_TRAPEZOIDAL);
+}
+
+// destructor
+SVFilterBank::~SVFilterBank(){
+  delete[] cutoffFrequency;
+  delete[] Resonance;
+  delete[] dt;
+  delete[] lp;
+  delete[] bp;
+  delete[] hp;
+  delete[] u_t1;
+  delete[] xk_t1;
+  delete[] xk_t2;
+  delete[] dampingState;
+  delete iir;
+  delete newtonStats;
+}
+
+void SVFilterBank::Initialize(int newVoices, float newCutoff, float newResonance, int newOversamplingFactor,
+			      SVFFilterMode newFilterMode, float newSampleRate, SVFIntegrationMethod newIntegrationMethod){
+  voices = newVoices;
+  groups = SIMDGroups(voices);
+
+  // allocate per voice vectors padded to whole vector groups
+  int lanes = groups*SIMD_WIDTH;
+  cutoffFrequency = new float[lanes];
+  Resonance = new float[lanes];
+  dt = new float[lanes];
+  lp = new float[lanes];
+  bp = new float[lanes];
+  hp = new float[lanes];
+  u_t1 = new float[lanes];
+  xk_t1 = new float[lanes];
+  xk_t2 = new float[lanes];
+  dampingState = new ADAAState[lanes];
+
+  // initialize filter parameters
+  oversamplingFactor = newOversamplingFactor;
+  filterMode = newFilterMode;
+  sampleRate = newSampleRate;
+  integrationMethod = newIntegrationMethod;
+  approximation = FASTMATH_PADE;
+  newtonStep = NEWTON_PLAIN;
+  antialiasing = false;
+
+  for(int v=0; v<lanes; v++){
+    cutoffFrequency[v] = newCutoff;
+    Resonance[v] = newResonance;
+    SetFilterIntegrationRate(v);
+
+    // initialize filter state
+    hp[v] = bp[v] = lp[v] = u_t1[v] = 0.0;
+    xk_t1[v] = xk_t2[v] = 0.0;
+    ResetADAAState(dampingState[v]);
+  }
+
+  SelectKernel();
+
+  // instantiate downsampling filters
+  iir = new IIRLowpassBank(voices, sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0, SVF_IIR_DOWNSAMPLE_ORDER);
+
+  // solver statistics are off by default
+  newtonStats = NULL;
+}
+
+void SVFilterBank::ResetFilterState(){
+  for(int v=0; v<groups*SIMD_WIDTH; v++){
+    // initialize filter parameters
+    cutoffFrequency[v] = 0.25;
+    Resonance[v] = 0.5;
+    SetFilterIntegrationRate(v);
+
+    // initialize filter state
+    hp[v] = bp[v] = lp[v] = u_t1[v] = 0.0;
+    xk_t1[v] = xk_t2[v] = 0.0;
+    ResetADAAState(dampingState[v]);
+  }
+
+  // set oversampling
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+}
+
+void SVFilterBank::SetFilterCutoff(int voice, float newCutoff){
+  cutoffFrequency[voice] = newCutoff;
+
+  SetFilterIntegrationRate(voice);
+}
+
+void SVFilterBank::SetFilterResonance(int voice, float newResonance){
+  Resonance[voice] = newResonance;
+}
+
+void SVFilterBank::SetFilterOversamplingFactor(int newOversamplingFactor){
+  oversamplingFactor = newOversamplingFactor;
+  iir->SetFilterParameters(sampleRate * oversamplingFactor, IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+
+  for(int v=0; v<voices; v++){
+    SetFilterIntegrationRate(v);
+  }
+  SelectKernel();
+}
+
+void SVFilterBank::SetFilterMode(SVFFilterMode newFilterMode){
+  filterMode = newFilterMode;
+  SelectKernel();
+}
+
+void SVFilterBank::SetFilterSampleRate(float newSampleRate){
+  sampleRate = newSampleRate;
+  iir->SetFilterParameters(sampleRate * (float)(oversamplingFactor), IIR_DOWNSAMPLING_BANDWIDTH*sampleRate/2.0);
+
+  for(int v=0; v<voices; v++){
+    SetFilterIntegrationRate(v);
+  }
+}
+
+void SVFilterBank::SetFilterIntegrationMethod(SVFIntegrationMethod method){
+  integrationMethod = method;
+  ResetFilterState();
+  SelectKernel();
+}
+
+void SVFilterBank::SetFilterApproximation(FastmathApproximation newApproximation){
+  approximation = newApproximation;
+}
+
+void SVFilterBank::SetFilterNewtonStep(NewtonStep newStep){
+  newtonStep = newStep;
+}
+
+void SVFilterBank::SetFilterAntialiasing(bool enable){
+  antialiasing = enable;
+
+  // antialiased nonlinearities start from a fresh segment
+  for(int v=0; v<groups*SIMD_WIDTH; v++){
+    ResetADAAState(dampingState[v]);
+  }
+}
+
+void SVFilterBank::SetFilterNoiseSeed(uint32_t newSeed){
+  dither.SetNoiseSeed(newSeed);
+}
+
+void SVFilterBank::SetFilterNewtonStatistics(bool enable){
+  if(enable && newtonStats == NULL){
+    newtonStats = new NewtonStatistics();
+  }
+  else if(!enable){
+    delete newtonStats;
+    newtonStats = NULL;
+  }
+}
+
+void SVFilterBank::SetFilterIntegrationRate(int voice){
+  // normalize cutoff freq to samplerate
+  dt[voice] = 44100.0 / (sampleRate * (float)(oversamplingFactor)) * cutoffFrequency[voice];
+
+  // clamp integration rate
+  if(dt[voice] < 0.0){
+    dt[voice] = 0.0;
+  }
+}
+
+// kernel table entries for the specialized oversampling factors
+#define SVF_BANK_KERNEL_ROW(method, mode) \
+  {&SVFilterBank::ProcessBlockKernel<method, mode, 0>, \
+   &SVFilterBank::ProcessBlockKernel<method, mode, 1>, \
+   &SVFilterBank::ProcessBlockKernel<method, mode, 2>, \
+   &SVFilterBank::ProcessBlockKernel<method, mode, 4>, \
+   &SVFilterBank::ProcessBlockKernel<method, mode, 8>}
+
+#define SVF_BANK_KERNEL_MODES(method) \
+  {SVF_BANK_KERNEL_ROW(method, SVF_LOWPASS_MODE), \
+   SVF_BANK_KERNEL_ROW(method, SVF_BANDPASS_MODE), \
+   SVF_BANK_KERNEL_ROW(method, SVF_HIGHPASS_MODE)}
+
+void SVFilterBank::SelectKernel(){
+  static const ProcessBlockKernelFn kernels[4][3][5] = {
+    SVF_BANK_KERNEL_MODES(SVF_SEMI_IMPLICIT_EULER),
+    SVF_BANK_KERNEL_MODES(SVF_PREDICTOR_CORRECTOR),
+    SVF_BANK_KERNEL_MODES(SVF_TRAPEZOIDAL),
+    SVF_BANK_KERNEL_MODES(SVF_INV_TRAPEZOIDAL)
+  };
+
+  // specialized oversampling factors, other factors use the generic kernel
+  int os;
+  switch(oversamplingFactor){
+  case 1:
+    os = 1;
+    break;
+  case 2:
+    os = 2;
+    break;
+  case 4:
+    os = 3;
+    break;
+  case 8:
+    os = 4;
+    break;
+  default:
+    os = 0;
+  }
+
+  kernel = kernels[integrationMethod][filterMode][os];
+}
+
+int SVFilterBank::GetFilterVoices(){
+  return voices;
+}
+
+float SVFilterBank::GetFilterCutoff(int voice){
+  return cutoffFrequency[voice];
+}
+
+float SVFilterBank::GetFilterResonance(int voice){
+  return Resonance[voice];
+}
+
+int SVFilterBank::GetFilterOversamplingFactor(){
+  return oversamplingFactor;
+}
+
+SVFFilterMode SVFilterBank::GetFilterMode(){
+  return filterMode;
+}
+
+float SVFilterBank::GetFilterSampleRate(){
+  return sampleRate;
+}
+
+SVFIntegrationMethod SVFilterBank::GetFilterIntegrationMethod(){
+  return integrationMethod;
+}
+
+FastmathApproximation SVFilterBank::GetFilterApproximation(){
+  return approximation;
+}
+
+NewtonStep SVFilterBank::GetFilterNewtonStep(){
+  return newtonStep;
+}
+
+bool SVFilterBank::GetFilterAntialiasing(){
+  return antialiasing;
+}
+
+NewtonStatistics* SVFilterBank::GetFilterNewtonStatistics(){
+  return newtonStats;
+}
+
+void SVFilterBank::ProcessBlock(const float* const* in, float* const* out, int n){
+  (this->*kernel)(in, out, n, NULL, NULL);
+}
+
+void SVFilterBank::ProcessBlock(const float* const* in, float* const* out, int n,
+				const float* const* cutoff, const float* const* resonance){
+  (this->*kernel)(in, out, n, cutoff, resonance);
+
+  // keep the last modulated values for the following blocks
+  if(n > 0){
+    for(int v=0; v<voices; v++){
+      if(cutoff){
+	SetFilterCutoff(v, cutoff[v][n - 1]);
+      }
+      if(resonance){
+	SetFilterResonance(v, resonance[v][n - 1]);
+      }
+    }
+  }
+}
+
+template <SVFIntegrationMethod method, SVFFilterMode mode, int oversampling>
+void SVFilterBank::ProcessBlockKernel(const float* const* in, float* const* out, int n,
+				      const float* const* cutoff, const float* const* resonance){
+  // approximants and antialiasing are fixed over the block
+  const FastmathApproximation approximation = this->approximation;
+  const SIMDFastmathRuntime approximant = {approximation};
+  const SIMDFastmathADAARuntime antialiased = {approximation};
+  const bool antialiasing = this->antialiasing;
+
+  // oversampling factor is a compile time constant unless zero
+  const int factor = oversampling ? oversampling : oversamplingFactor;
+
+  // loss factor
+  const SIMDFloat beta = 1.f - (0.0025f/factor);
+
+  // integration rate limit
+  const float dtMax = method == SVF_TRAPEZOIDAL ? 0.8f :
+                      (method == SVF_INV_TRAPEZOIDAL ? 1.f : 0.25f);
+
+  // integration rate per unit cutoff for the modulation buffers
+  const float rate = 44100.f / (sampleRate * (float)(factor));
+
+  // per sample integration rates and resonances of a voice group
+  float rates[SIMD_WIDTH];
+  float resonances[SIMD_WIDTH];
+
+  // lane transpose buffer
+  float lanes[SIMD_WIDTH];
+
+  // dither of one sample of every lane
+  float noise[SIMD_WIDTH];
+
+  for(int g = 0; g < groups; g++){
+    int base = g*SIMD_WIDTH;
+    int active = voices - base < SIMD_WIDTH ? voices - base : SIMD_WIDTH;
+
+    // per voice block constants
+    SIMDFloat fb = 1.f - 3.5f*SIMDLoad(Resonance + base);
+    SIMDFloat dt2 = SIMDMin(SIMDLoad(dt + base), dtMax);
+    SIMDFloat alpha = 0.5f*dt2;
+    SIMDFloat alpha2 = 0.25f*dt2*dt2 + fb*alpha;
+    SIMDFloat gamma = 1.f - 0.25f*dt2*dt2;
+
+    // keep voice state in registers over the block
+    SIMDFloat lpv = SIMDLoad(lp + base);
+    SIMDFloat bpv = SIMDLoad(bp + base);
+    SIMDFloat hpv = SIMDLoad(hp + base);
+    SIMDFloat u_t1v = SIMDLoad(u_t1 + base);
+    SIMDFloat xk_t1v = SIMDLoad(xk_t1 + base);
+    SIMDFloat xk_t2v = SIMDLoad(xk_t2 + base);
+    SIMDFloat outv = 0.f;
+
+    // antialiasing state of the group lanes
+    ADAAState *damping = dampingState + base;
+
+    for(int i = 0; i < n; i++){
+      // derive the constants of this sample from the modulation buffers,
+      // padding lanes keep their set values
+      if(cutoff || resonance){
+	for(int l = 0; l < SIMD_WIDTH; l++){
+	  rates[l] = cutoff && l < active ? rate*cutoff[base + l][i] : dt[base + l];
+	  resonances[l] = resonance && l < active ? resonance[base + l][i] : Resonance[base + l];
+	}
+
+	fb = 1.f - 3.5f*SIMDLoad(resonances);
+	dt2 = SIMDMin(SIMDMax(SIMDLoad(rates), 0.f), dtMax);
+	alpha = 0.5f*dt2;
+	alpha2 = 0.25f*dt2*dt2 + fb*alpha;
+	gamma = 1.f - 0.25f*dt2*dt2;
+      }
+
+      // gather voice inputs with dither
+      dither.NoiseBlock(noise, SIMD_WIDTH, 1.0e-6f);
+      for(int l = 0; l < SIMD_WIDTH; l++){
+	lanes[l] = l < active ? in[base + l][i] + noise[l] : 0.f;
+      }
+      SIMDFloat input = SIMDLoad(lanes);
+
+      // integrate filter state
+      // with oversampling
+      for(int nn = 0; nn < factor; nn++){
+	// integration method and filter mode are compile time constants
+	switch(method){
+	case SVF_SEMI_IMPLICIT_EULER:
+	  {
+	    SIMDFloat damping_bp = antialiasing ? antialiased.Sinh(damping, bpv) :
+	      approximant.Sinh(bpv);
+
+	    hpv = input - lpv - fb*bpv - damping_bp;
+	    bpv += dt2*hpv;
+	    bpv *= beta;
+	    lpv += dt2*bpv;
+	  }
+	  break;
+	case SVF_TRAPEZOIDAL:
+	  // trapezoidal integration
+	  {
+	    SIMDFloat damping_bp = antialiasing ? antialiased.Sinh(damping, bpv) :
+	      approximant.Sinh(bpv);
+	    SIMDFloat D_t = gamma*bpv + alpha*(u_t1v + input - 2.f*lpv - fb*bpv - damping_bp);
+	    // lane masked newton-raphson from the extrapolated previous solutions
+	    NewtonLanesResult nr = SVFTrapezoidalLanesSolve(approximation, newtonStep, alpha, alpha2, D_t, NewtonExtrapolate(xk_t1v, xk_t2v),
+							    NEWTON_TOLERANCE*(1.f + SIMDAbs(D_t)), newtonStats != NULL);
+	    SIMDFloat x_k = nr.x;
+
+	    xk_t2v = xk_t1v;
+	    xk_t1v = x_k;
+
+	    if(newtonStats){
+	      newtonStats->AddLaneSolves(nr, active);
+	    }
+
+	    lpv += alpha*bpv;
+	    bpv = beta*x_k;
+	    lpv += alpha*bpv;
+	    hpv = input - lpv - fb*bpv;
+	  }
+	  break;
+	case SVF_INV_TRAPEZOIDAL:
+	  // inverse trapezoidal integration
+	  {
+	    // pade kernels map the state through the library functions
+	    SIMDFloat sinh_bp;
+	    if(antialiasing){
+	      sinh_bp = approximation == FASTMATH_MINIMAX ? ADAAEvaluateLanes<SinhMinimaxMean>(damping, bpv) :
+		ADAAEvaluateLanes<SinhLibraryMean>(damping, bpv);
+	    }
+	    else{
+	      sinh_bp = approximation == FASTMATH_MINIMAX ? SinhMinimax(bpv) : SIMDMap(sinhf, bpv);
+	    }
+	    SIMDFloat D_t = gamma*bpv + alpha*(u_t1v + input - 2.f*lpv - fb*bpv - sinh_bp);
+	    // lane masked newton-raphson from the extrapolated previous solutions
+	    NewtonLanesResult nr = SVFInvTrapezoidalLanesSolve(approximation, newtonStep, alpha, alpha2, D_t, NewtonExtrapolate(xk_t1v, xk_t2v),
+							       NEWTON_TOLERANCE*(1.f + SIMDAbs(D_t)), newtonStats != NULL);
+	    SIMDFloat y_k = nr.x;
+
+	    xk_t2v = xk_t1v;
+	    xk_t1v = y_k;
+
+	    if(newtonStats){
+	      newtonStats->AddLaneSolves(nr, active);
+	    }
+
+	    lpv += alpha*bpv;
+	    bpv = beta*(approximation == FASTMATH_MINIMAX ? ASinhMinimax(y_k) : SIMDMap(asinhf, y_k));
+	    lpv += alpha*bpv;
+	    hpv = input - lpv - fb*bpv;
+	  }
+	  break;
+	default:
+	  break;
+	}
+
+	switch(mode){
+	case SVF_LOWPASS_MODE:
+	  outv = lpv;
+	  break;
+	case SVF_BANDPASS_MODE:
+	  outv = bpv;
+	  break;
+	case SVF_HIGHPASS_MODE:
+	  outv = hpv;
+	  break;
+	default:
+	  outv = 0.f;
+	}
+
+	// downsampling filter
+	if(factor > 1){
+	  outv = iir->IIRfilter(g, outv);
+	}
+      }
+
+      // set input at t-1
+      u_t1v = input;
+
+      // scatter voice outputs
+      SIMDStore(lanes, outv);
+      for(int l = 0; l < active; l++){
+	out[base + l][i] = lanes[l];
+      }
+    }
+
+    // store voice state
+    SIMDStore(lp + base, lpv);
+    SIMDStore(bp + base, bpv);
+    SIMDStore(hp + base, hpv);
+    SIMDStore(u_t1 + base, u_t1v);
+    SIMDStore(xk_t1 + base, xk_t1v);
+    SIMDStore(xk_t2 + base, xk_t2v);
+  }
+}
@@ -0,0 +1,153 @@
+/*
+ *  (C) 2021 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of State Variable Filter OWL Patch.
+ *
+ *  State Variable Filter OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  State Variable Filter OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with State Variable Filter OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __dspsvfbankh__
+#define __dspsvfbankh__
+
+#include <stdint.h>
+#include "simd.h"
+#include "svfilter.h"
+#include "iirbank.h"
+#include "noise.h"
+#include "newton.h"
+
+// bank of independent state variable filters processed SIMD_WIDTH
+// voices at a time. voice state is kept in structure of arrays form
+// so that each vector lane carries one voice
+class SVFilterBank{
+public:
+  // constructor/destructor
+  SVFilterBank(int newVoices, float newCutoff, float newResonance, int newOversamplingFactor,
+	       SVFFilterMode newFilterMode, float newSampleRate, SVFIntegrationMethod newIntegrationMethod);
+  SVFilterBank(int newVoices);
+  ~SVFilterBank();
+
+  // set per voice filter parameters
+  void SetFilterCutoff(int voice, float newCutoff);
+  void SetFilterResonance(int voice, float newResonance);
+
+  // set filter parameters shared by all voices
+  void SetFilterOversamplingFactor(int newOversamplingFactor);
+  void SetFilterMode(SVFFilterMode newFilterMode);
+  void SetFilterSampleRate(float newSampleRate);
+  void SetFilterIntegrationMethod(SVFIntegrationMethod method);
+  void SetFilterApproximation(FastmathApproximation newApproximation);
+  void SetFilterNewtonStep(NewtonStep newStep);
+  void SetFilterAntialiasing(bool enable);
+  void SetFilterNoiseSeed(uint32_t newSeed);
+  void SetFilterNewtonStatistics(bool enable);
+
+  // get filter parameters
+  int GetFilterVoices();
+  float GetFilterCutoff(int voice);
+  float GetFilterResonance(int voice);
+  int GetFilterOversamplingFactor();
+  SVFFilterMode GetFilterMode();
+  float GetFilterSampleRate();
+  SVFIntegrationMethod GetFilterIntegrationMethod();
+  FastmathApproximation GetFilterApproximation();
+  NewtonStep GetFilterNewtonStep();
+  bool GetFilterAntialiasing();
+
+  // get newton solver statistics of all voices, NULL unless enabled
+  NewtonStatistics* GetFilterNewtonStatistics();
+
+  // filter a block of samples for every voice, in[voice] and out[voice]
+  // may point to the same buffer
+  void ProcessBlock(const float* const* in, float* const* out, int n);
+
+  // filter a block with per sample cutoff and resonance, either holds a
+  // buffer for every voice or is NULL to keep the set values. linked
+  // voices may share one buffer. parameters end the block at their last
+  // modulated value
+  void ProcessBlock(const float* const* in, float* const* out, int n,
+		    const float* const* cutoff, const float* const* resonance);
+
+  // reset state
+  void ResetFilterState();
+
+private:
+  // allocate voice state and initialize parameters
+  void Initialize(int newVoices, float newCutoff, float newResonance, int newOversamplingFactor,
+		  SVFFilterMode newFilterMode, float newSampleRate, SVFIntegrationMethod newIntegrationMethod);
+
+  // set integration rate of a voice
+  void SetFilterIntegrationRate(int voice);
+
+  // select block processing kernel for current settings
+  void SelectKernel();
+
+  // block processing kernel specialized for integration method,
+  // filter mode and oversampling factor, zero factor is generic.
+  // approximants and antialiasing are branches fixed over the block.
+  // modulation buffers are NULL for block rate parameters
+  template <SVFIntegrationMethod method, SVFFilterMode mode, int oversampling>
+  void ProcessBlockKernel(const float* const* in, float* const* out, int n,
+			  const float* const* cutoff, const float* const* resonance);
+
+  typedef void (SVFilterBank::*ProcessBlockKernelFn)(const float* const* in, float* const* out, int n,
+						     const float* const* cutoff, const float* const* resonance);
+
+  // voice count and vector groups
+  int voices;
+  int groups;
+
+  // per voice filter parameters
+  float *cutoffFrequency;
+  float *Resonance;
+  float *dt;
+
+  // shared filter parameters
+  int oversamplingFactor;
+  SVFFilterMode filterMode;
+  float sampleRate;
+  SVFIntegrationMethod integrationMethod;
+  FastmathApproximation approximation;
+  NewtonStep newtonStep;
+  bool antialiasing;
+
+  // per voice filter state
+  float *lp;
+  float *bp;
+  float *hp;
+  float *u_t1;
+
+  // previous newton solutions for the warm start
+  float *xk_t1;
+  float *xk_t2;
+
+  // per voice antiderivative antialiasing state of the sinh damping
+  ADAAState *dampingState;
+
+  // dither generator shared by the voices
+  NoiseGenerator dither;
+
+  // newton solver statistics
+  NewtonStatistics *newtonStats;
+
+  // selected block processing kernel
+  ProcessBlockKernelFn kernel;
+
+  // IIR downsampling filters
+  IIRLowpassBank *iir;
+};
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ *  (C) 2022 Janne Heikkarainen <janne808@radiofreerobotron.net>
+ *
+ *  All rights reserved.
+ *
+ *  This file is part of Kocmoc OWL Patch.
+ *
+ *  Kocmoc OWL Patch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Kocmoc OWL Patch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kocmoc OWL Patch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __kocmoctapsh__
+#define __kocmoctapsh__
+
+#include <cstddef>
+#include "iir.h"
+#include "halfband.h"
+
+// outputs of the multi-output block processing
+enum FilterTap {
+  FILTER_TAP_LOWPASS,
+  FILTER_TAP_BANDPASS,
+  FILTER_TAP_HIGHPASS,
+  FILTER_TAP_MORPH,
+  FILTER_TAPS
+};
+
+// bit of a tap in the tap masks of SetFilterTaps()
+#define FILTER_TAP_BIT(tap) (1 << (tap))
+#define FILTER_TAPS_ALL ((1 << FILTER_TAPS) - 1)
+
+// weights of the lowpass, bandpass and highpass responses in the morph
+// tap
+struct FilterMorph {
+  float lowpass;
+  float bandpass;
+  float highpass;
+};
+
+// morph runs from lowpass at 0 over bandpass at 0.5 to highpass at 1
+inline FilterMorph FilterMorphWeights(float morph){
+  FilterMorph weights = {0.f, 0.f, 0.f};
+
+  if(morph < 0.f){
+    morph = 0.f;
+  }
+  else if(morph > 1.f){
+    morph = 1.f;
+  }
+
+  if(morph < 0.5f){
+    weights.lowpass = 1.f - 2.f*morph;
+    weights.bandpass = 2.f*morph;
+  }
+  else{
+    weights.bandpass = 2.f - 2.f*morph;
+    weights.highpass = 2.f*morph - 1.f;
+  }
+
+  return weights;
+}
+
+// decimation state of one tap, same filters as the single output path
+template <int order>
+struct FilterTapDecimator {
+  FilterTapDecimator(float samplerate, float cutoff, int factor) :
+    iir(samplerate, cutoff, order), halfband(factor) {}
+
+  FixedIIRLowpass<order> iir;
+  HalfbandResampler halfband;
+
+  // substeps collected for the block decimation filter and the half-band
+  // chain, and the last decimated sample
+  float oversampled[IIR_BLOCK_SIZE];
+  float decimated[HALFBAND_MAX_FACTOR];
+  float out;
+};
+
+// per tap decimators of the multi-output block processing. decimators
+// are allocated when a tap is enabled outside the audio thread, taps that
+// are never enabled cost neither memory nor time
+template <int order>
+class FilterTaps{
+public:
+  // constructor/destructor, rate and cutoff of the decimation filter
+  FilterTaps(float newSamplerate, float newCutoff, int newFactor);
+  ~FilterTaps();
+
+  // follow sample rate and oversampling changes of the filter
+  void SetTapsParameters(float newSamplerate, float newCutoff, int newFactor);
+
+  // clear decimator state
+  void InitializeTaps();
+
+  // allocate decimators for the taps in the mask and free the others,
+  // not safe on the audio thread
+  void SetTaps(int mask);
+
+  // outputs of the enabled taps, NULL for the taps without a decimator
+  void EnabledTaps(float* const* outputs, float** enabled);
+
+  // hand one substep of the tap responses to the decimators of the
+  // requested taps, pending counts the base rate samples collected
+  void Substep(float* const* outputs, const float* response, int factor, int pending, int nn,
+	       bool halfbandResampler);
+
+  // decimate the substeps of base rate sample i of an n sample block
+  void Decimate(float* const* outputs, int factor, int& pending, int i, int n, bool halfbandResampler);
+
+private:
+  float samplerate;
+  float cutoff;
+  int resamplerFactor;
+
+  FilterTapDecimator<order> *decimators[FILTER_TAPS];
+};
+
+template <int order>
+FilterTaps<order>::FilterTaps(float newSamplerate, float newCutoff, int newFactor){
+  samplerate = newSamplerate;
+  cutoff = newCutoff;
+  resamplerFactor = newFactor;
+
+  for(int t=0; t<FILTER_TAPS; t++){
+    decimators[t] = NULL;
+  }
+}
+
+template <int order>
+FilterTaps<order>::~FilterTaps(){
+  for(int t=0; t<FILTER_TAPS; t++){
+    delete decimators[t];
+  }
+}
+
+template <int order>
+void FilterTaps<order>::SetTapsParameters(float newSamplerate, float newCutoff, int newFactor){
+  samplerate = newSamplerate;
+  cutoff = newCutoff;
+  resamplerFactor = newFactor;
+
+  for(int t=0; t<FILTER_TAPS; t++){
+    if(decimators[t]){
+      decimators[t]->iir.SetFilterParameters(samplerate, cutoff);
+      decimators[t]->halfband.SetResamplerFactor(resamplerFactor);
+    }
+  }
+}
+
+template <int order>
+void FilterTaps<order>::InitializeTaps(){
+  for(int t=0; t<FILTER_TAPS; t++){
+    if(decimators[t]){
+      decimators[t]->iir.InitializeBiquadCascade();
+      decimators[t]->halfband.InitializeResampler();
+    }
+  }
+}
+
+template <int order>
+void FilterTaps<order>::SetTaps(int mask){
+  for(int t=0; t<FILTER_TAPS; t++){
+    if((mask & FILTER_TAP_BIT(t)) && decimators[t] == NULL){
+      decimators[t] = new FilterTapDecimator<order>(samplerate, cutoff, resamplerFactor);
+    }
+    else if(!(mask & FILTER_TAP_BIT(t))){
+      delete decimators[t];
+      decimators[t] = NULL;
+    }
+  }
+}
+
+template <int order>
+inline void FilterTaps<order>::EnabledTaps(float* const* outputs, float** enabled){
+  for(int t=0; t<FILTER_TAPS; t++){
+    enabled[t] = decimators[t] ? outputs[t] : NULL;
+  }
+}
+
+template <int order>
+inline void FilterTaps<order>::Substep(float* const* outputs, const float* response, int factor, int pending, int nn,
+				       bool halfbandResampler){
+  for(int t=0; t<FILTER_TAPS; t++){
+    if(outputs[t]){
+      FilterTapDecimator<order> *d = decimators[t];
+
+      if(halfbandResampler){
+	d->decimated[nn] = response[t];
+      }
+      else if(factor > IIR_BLOCK_SIZE){
+	d->out = d->iir.IIRfilter(response[t]);
+      }
+      else if(factor > 1){
+	d->oversampled[pending*factor + nn] = response[t];
+      }
+      else{
+	d->out = response[t];
+      }
+    }
+  }
+}
+
+template <int order>
+inline void FilterTaps<order>::Decimate(float* const* outputs, int factor, int& pending, int i, int n,
+					bool halfbandResampler){
+  // decimate output to the base rate
+  if(halfbandResampler){
+    for(int t=0; t<FILTER_TAPS; t++){
+      if(outputs[t]){
+	decimators[t]->out = decimators[t]->halfband.Downsample(decimators[t]->decimated);
+      }
+    }
+  }
+
+  // decimate collected substeps when the buffer is full or the block ends
+  if(!halfbandResampler && factor > 1 && factor <= IIR_BLOCK_SIZE){
+    pending++;
+
+    if((pending + 1)*factor > IIR_BLOCK_SIZE || i == n - 1){
+      for(int t=0; t<FILTER_TAPS; t++){
+	if(outputs[t]){
+	  FilterTapDecimator<order> *d = decimators[t];
+
+	  d->iir.IIRfilterBlock(d->oversampled, pending*factor);
+
+	  for(int j = 0; j < pending; j++){
+	    outputs[t][i + 1 - pending + j] = d->oversampled[(j + 1)*factor - 1];
+	  }
+	}
+      }
+
+      pending = 0;
+    }
+  }
+  else{
+    for(int t=0; t<FILTER_TAPS; t++){
+      if(outputs[t]){
+	outputs[t][i] = decimators[t]->out;
+      }
+    }
+  }
+}
+
+#endif